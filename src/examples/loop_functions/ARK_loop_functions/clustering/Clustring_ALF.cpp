@@ -85,6 +85,9 @@ void CClusteringALF::SetupVirtualEnvironments(TConfigurationNode& t_tree){
     GetNodeAttribute(t_VirtualClusteringHubNode, "position", m_sClusteringHub.Center);
     GetNodeAttribute(t_VirtualClusteringHubNode, "radius", m_sClusteringHub.Radius);
     GetNodeAttribute(t_VirtualClusteringHubNode, "color", m_sClusteringHub.Color);
+    /* Index the hub, a kilobot is inside it within 90% of its radius */
+    GetAreaIndex().Clear();
+    GetAreaIndex().AddCircle(m_sClusteringHub.Center, m_sClusteringHub.Radius*0.9);
 }
 
 /****************************************/
@@ -109,9 +112,7 @@ void CClusteringALF::GetExperimentVariables(TConfigurationNode& t_tree){
 void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     /* Update the state of the kilobots (inside or outside the clustering hub)*/
     UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
-    CVector2 cKilobotPosition=GetKilobotPosition(c_kilobot_entity);
-    Real fDistance = Distance(cKilobotPosition, m_sClusteringHub.Center);
-    if(fDistance<(m_sClusteringHub.Radius*0.9)){
+    if(GetAreaIndex().GetRobotArea(GetKilobotIndex(c_kilobot_entity))>=0){
         m_vecKilobotStates[unKilobotID]=INSIDE_CLUSTERING_HUB;
     }
     else{
@@ -165,10 +166,10 @@ void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
         }
         /* Sending the message */
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
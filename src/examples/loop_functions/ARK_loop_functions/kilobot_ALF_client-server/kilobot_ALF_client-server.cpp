@@ -4,7 +4,6 @@ int freedomTh = 8;
 
 CALFClientServer::CALFClientServer() :
     m_unDataAcquisitionFrequency(10){
-    bytesReceived = -1;
 }
 
 
@@ -28,45 +27,13 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
     multiArea[4].Free=false;
     multiArea[5].Free=false;
 
-    /*Opening communication port*/
+    /*Opening communication port: the other ALF is connected without blocking, during the steps*/
+    target_received = false;
     if(MODE=="SERVER"){
-        int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-        int port = 54000;
-        memset(bufStore, 0, 30);
-        std::string ipAddress = "0.0.0.0";
-        sockaddr_in hint;
-        hint.sin_family = AF_INET;
-        hint.sin_port = htons(port);
-        inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-        bind(serverSocket, (sockaddr*)&hint, sizeof(hint));
-        listen(serverSocket, SOMAXCONN);
-        sockaddr_in client;
-        socklen_t clientSize = sizeof(client);
-        clientSocket = accept(serverSocket, (sockaddr*)&client, &clientSize);
-        char host[NI_MAXHOST];      // Client's remote name
-        char service[NI_MAXSERV];   // Service (i.e. port) the client is connect on
-        memset(host, 0, NI_MAXHOST); // same as memset(host, 0, NI_MAXHOST);
-        memset(service, 0, NI_MAXSERV);
-        if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0)
-        {
-            std::cout << host << " connected on port " << service << std::endl;
-        }
-        else
-        {
-            inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-            std::cout << host << " connected on port " << ntohs(client.sin_port) << std::endl;
-        }
-        close(serverSocket);
+        GetNetwork().Listen(54000);
     }
     if(MODE=="CLIENT"){
-        serverSocket = socket(AF_INET, SOCK_STREAM, 0); //socket for client-server communication
-        int port = 54000;
-        std::string ipAddress = "127.0.0.1";
-        sockaddr_in hint;
-        hint.sin_family = AF_INET;
-        hint.sin_port = htons(port);
-        inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-        connect(serverSocket, (sockaddr*)&hint, sizeof(hint));
+        GetNetwork().Connect("127.0.0.1", 54000);
     }
 }
 
@@ -79,12 +46,7 @@ void CALFClientServer::Reset() {
 
 void CALFClientServer::Destroy() {
     m_cOutput.close();
-    if(MODE=="SERVER"){
-        close(clientSocket);
-    }
-    if(MODE=="CLIENT"){
-        close(serverSocket);
-    }
+    GetNetwork().Close();
 }
 
 
@@ -118,6 +80,8 @@ void CALFClientServer::SetupVirtualEnvironments(TConfigurationNode& t_tree){
     }
     multiArea.resize(num_of_areas);
     contained = std::vector<int>(num_of_areas,0);
+    /* The occupied areas are drawn on the floor raster, and erased once free */
+    EnableFloorRaster(0.005);
     int i=0;
     for(itAct = itAct.begin(&tVirtualEnvironmentsNode); itAct != itAct.end(); ++itAct, i++) {
         std::string s = std::to_string(i);
@@ -129,6 +93,7 @@ void CALFClientServer::SetupVirtualEnvironments(TConfigurationNode& t_tree){
         multiArea[i].RGBcolor.append(std::to_string(multiArea[i].Color.GetRed()/85));
         multiArea[i].RGBcolor.append(std::to_string(multiArea[i].Color.GetGreen()/85));
         multiArea[i].RGBcolor.append(std::to_string(multiArea[i].Color.GetBlue()/85));
+        multiArea[i].FloorShape = GetFloorRaster().AddCircle(multiArea[i].Center, multiArea[i].Radius, multiArea[i].Color);
     }
 }
 
@@ -142,30 +107,39 @@ void CALFClientServer::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
-void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
-/*listen to the other ALF*/
-    memset(buf, 0, 30);
-    if(MODE=="SERVER"){
-        bytesReceived = recv(clientSocket, buf, 30, MSG_DONTWAIT);
-    }
-    if(MODE=="CLIENT"){
-        bytesReceived = recv(serverSocket, buf, 30, MSG_DONTWAIT);
-    }
-
-    if ((bytesReceived == -1)||(bytesReceived == 0)){
-        //std::cout << "not receiving" << std::endl;
-    }
-    else 
-    {
-        for (int i=0; i<30; i++){
-            bufStore[i]=buf[i];         //save buf in a permanent string every time a new message comes, to have data available until the next message
+void CALFClientServer::ReceiveNetworkMessages(){
+/*listen to the other ALF, once per step*/
+    CALFNetwork::SFrame sFrame;
+    CALFMessageReader cMessage;
+    while(GetNetwork().Receive(sFrame)){
+        if (!cMessage.Parse(sFrame.Data, sFrame.Size)){
+            std::cerr<<"Discarding a malformed message of "<<sFrame.Size<<" bytes"<<std::endl;
+            continue;
+        }
+        if (MODE=="CLIENT" && cMessage.GetType()==ALF_MSG_AREA_STATE){         //the server sends the areas it freed
+            for (int a=0; a<(int)multiArea.size(); a++){
+                if (cMessage.GetBit(a) && multiArea[a].Free == false){
+                    std::cout<<"Area freed by the server: "<<a<<std::endl;
+                    multiArea[a].Free = true;
+                    GetFloorRaster().SetVisible(multiArea[a].FloorShape, false);
+                }
+            }
         }
-        std::cout<<"String received: "<<bufStore<<std::endl;
-        if (MODE=="CLIENT"){
-            multiArea[bufStore[0]-48].Free = true;
+        if (MODE=="SERVER" && cMessage.GetType()==ALF_MSG_AREA_SELECTION){     //the client sends the area it selected
+            for (int a=0; a<(int)multiArea.size(); a++){
+                if (cMessage.GetBit(a)){
+                    std::cout<<"Area selected by the client: "<<a<<std::endl;
+                    target_index = a;
+                    target_received = true;
+                    break;
+                }
+            }
         }
     }
+}
+
 
+void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
 /*Update kilobot state*/
     UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
     if(unKilobotID==0){
@@ -191,9 +165,14 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                     int placed = std::accumulate(inPlace.begin(), inPlace.end(), 0); //how many KBs are in position
                     if (placed>=freedomTh){
                         multiArea[target_index].Free=true;
-                        std::string buf = std::to_string(target_index);
+                        GetFloorRaster().SetVisible(multiArea[target_index].FloorShape, false);
                         std::cout<<"Free area number "<<target_index<<std::endl;
-                        send(clientSocket, buf.c_str(), buf.size() + 1, 0);
+                        CALFMessageWriter cMessage;
+                        cMessage.Start(ALF_MSG_AREA_STATE, multiArea.size());
+                        for (int a=0; a<(int)multiArea.size(); a++){
+                            cMessage.SetBit(a, multiArea[a].Free);
+                        }
+                        GetNetwork().Send(cMessage.GetData(), cMessage.GetSize());
                     }
                 }
             }
@@ -206,7 +185,7 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     if(MODE=="CLIENT"){
         /*if (flag[0]==0){
             std::string buf1 = "333";       //turn on white LED: it means the client swarm started moving
-            send(serverSocket, buf1.c_str(), buf1.size() + 1, 0);
+            GetNetwork().Send(buf1.c_str(), buf1.size() + 1);
             std::cout<<"Sending initial signal "<<buf1<<std::endl;
             flag[0] = 1;
         }*/
@@ -240,11 +219,12 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                                 max_index=t+1;
                             }
                         }
-                        std::string maxs = std::to_string(max_index);
                         std::cout<<"Most populated area: "<<max_index<<std::endl;
-                        buf = maxs;                                            //use this to send the number of the target area
-                        std::cout<<"Sending index "<<buf<<std::endl;
-                        send(serverSocket, buf.c_str(), buf.size() + 1, 0);            //send the RGB color of the most populated area in client experiment
+                        CALFMessageWriter cMessage;                                 //use this to send the number of the target area
+                        cMessage.Start(ALF_MSG_AREA_SELECTION, num_of_areas);
+                        cMessage.SetBit(max_index);
+                        std::cout<<"Sending index "<<max_index<<std::endl;
+                        GetNetwork().Send(cMessage.GetData(), cMessage.GetSize());  //send the most populated area in client experiment
                         flag[1]=1;
                     }
                 }
@@ -267,8 +247,7 @@ void CALFClientServer::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
     }
     else{
         if(MODE=="SERVER"){
-            if (bufStore[0]!=0){
-                target_index = ((int)bufStore[0]-48);                   //ASCII conversion of char to int number
+            if (target_received){
                 std::string target_color = multiArea[target_index].RGBcolor;
                 m_vecKilobotData[unKilobotID].ALL=atoi(target_color.c_str());    //use this when receiving area index
                 if(m_vecKilobotStates[unKilobotID]==RANDOM_WALKING){
@@ -306,25 +285,11 @@ void CALFClientServer::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             m_tMessages[unKilobotID].data[1+i*3] = m_tMessages[unKilobotID].data[1+i*3] | (tMessage.m_sData >> 8);
             m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
         }
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
-    }
-}
-
-
-CColor CALFClientServer::GetFloorColor(const CVector2 &vec_position_on_plane) {
-    CColor cColor=CColor::WHITE;
-    for (int i=0; i<num_of_areas; i++){
-        if (multiArea[i].Free == false){
-            Real fDistance = Distance(vec_position_on_plane,multiArea[i].Center);
-                if(fDistance<multiArea[i].Radius){
-                    cColor=multiArea[i].Color;
-                }
-        }
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
-    return cColor;
 }
 
 
@@ -87,6 +87,9 @@ public:
     /** Virtual environment visualization updating */
 
 
+    /** Handle the messages received from the other ALF */
+    void ReceiveNetworkMessages();
+
     /** Get the message to send to a Kilobot according to its position */
     void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
 
@@ -94,9 +97,6 @@ public:
     /** Get the message to send to a Kilobot according to its position */
     void UpdateVirtualSensor(CKilobotEntity& c_kilobot_entity);
 
-    /** Used to plot the Virtual environment on the floor */
-    virtual CColor GetFloorColor(const CVector2& vec_position_on_plane);
-
 private:
     /************************************/
     /*  Virtual Environment variables   */
@@ -109,6 +109,7 @@ private:
         CColor Color;
         std::string RGBcolor;
         bool Free;
+        UInt32 FloorShape;
     };
     std::vector<SVirtualArea> multiArea;
 
@@ -129,11 +130,7 @@ private:
     std::vector<FloorColorData> m_vecKilobotData;
 
     std::string MODE;
-    char buf[30];                   //buffer containing socket message
-    char bufStore[30];              //array where to store buf to keep it available
-    int bytesReceived;              //length of received string
-    int serverSocket;
-    int clientSocket;
+    bool target_received;           //true once the client has selected the target area
     int target_index;
     int num_of_areas;               //number of clustering areas
     int num_of_kbs;                 //number of kilobots on the field
@@ -4,7 +4,6 @@ int freedomTh = 8;
 
 CALFClientServer::CALFClientServer() :
     m_unDataAcquisitionFrequency(10){
-    bytesReceived=-1;
 }
 
 
@@ -28,45 +27,13 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
     multiArea[4].Free=false;
     multiArea[5].Free=false;
 
-    /*Opening communication port*/
+    /*Opening communication port: the other ALF is connected without blocking, during the steps*/
+    memset(bufStore, 0, 30);
     if(MODE=="SERVER"){
-        int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-        int port = 54000;
-        memset(bufStore, 0, 30);
-        std::string ipAddress = "0.0.0.0";
-        sockaddr_in hint;
-        hint.sin_family = AF_INET;
-        hint.sin_port = htons(port);
-        inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-        bind(serverSocket, (sockaddr*)&hint, sizeof(hint));
-        listen(serverSocket, SOMAXCONN);
-        sockaddr_in client;
-        socklen_t clientSize = sizeof(client);
-        clientSocket = accept(serverSocket, (sockaddr*)&client, &clientSize);
-        char host[NI_MAXHOST];      // Client's remote name
-        char service[NI_MAXSERV];   // Service (i.e. port) the client is connect on
-        memset(host, 0, NI_MAXHOST); // same as memset(host, 0, NI_MAXHOST);
-        memset(service, 0, NI_MAXSERV);
-        if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0)
-        {
-            std::cout << host << " connected on port " << service << std::endl;
-        }
-        else
-        {
-            inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-            std::cout << host << " connected on port " << ntohs(client.sin_port) << std::endl;
-        }
-        close(serverSocket);
+        GetNetwork().Listen(54000);
     }
     if(MODE=="CLIENT"){
-        serverSocket = socket(AF_INET, SOCK_STREAM, 0); //socket for client-server communication
-        int port = 54000;
-        std::string ipAddress = "127.0.0.1";
-        sockaddr_in hint;
-        hint.sin_family = AF_INET;
-        hint.sin_port = htons(port);
-        inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-        connect(serverSocket, (sockaddr*)&hint, sizeof(hint));
+        GetNetwork().Connect("127.0.0.1", 54000);
     }
 }
 
@@ -79,12 +46,7 @@ void CALFClientServer::Reset() {
 
 void CALFClientServer::Destroy() {
     m_cOutput.close();
-    if(MODE=="SERVER"){
-        close(clientSocket);
-    }
-    if(MODE=="CLIENT"){
-        close(serverSocket);
-    }
+    GetNetwork().Close();
 }
 
 
@@ -142,30 +104,21 @@ void CALFClientServer::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
-void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
-/*listen to the other ALF*/
-    memset(buf, 0, 30);
-    if(MODE=="SERVER"){
-        bytesReceived = recv(clientSocket, buf, 30, MSG_DONTWAIT);
-    }
-    if(MODE=="CLIENT"){
-        bytesReceived = recv(serverSocket, buf, 30, MSG_DONTWAIT);
-    }
-
-    if ((bytesReceived == -1)||(bytesReceived == 0)){
-        //std::cout << "not receiving" << std::endl;
-    }
-    else 
-    {
-        for (int i=0; i<30; i++){
-            bufStore[i]=buf[i];         //save buf in a permanent string every time a new message comes, to have data available until the next message
-        }
+void CALFClientServer::ReceiveNetworkMessages(){
+/*listen to the other ALF, once per step*/
+    CALFNetwork::SFrame sFrame;
+    while(GetNetwork().Receive(sFrame)){
+        memset(bufStore, 0, 30);
+        memcpy(bufStore, sFrame.Data, Min<UInt32>(sFrame.Size, 29));  //save the message in a permanent string, to have data available until the next message
         std::cout<<"String received: "<<bufStore<<std::endl;
         if (MODE=="CLIENT"){
             multiArea[bufStore[0]-48].Free = true;
         }
     }
+}
 
+
+void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
 /*Update kilobot state*/
     UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
 
@@ -180,7 +133,7 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                     int placed = std::accumulate(inPlace.begin(), inPlace.end(), 0); //how many KBs are in position
                     std::string buf = std::to_string(placed);
                     std::cout<<"kilobots on target: "<<buf<<std::endl;
-                    send(clientSocket, buf.c_str(), buf.size() + 1, 0);
+                    GetNetwork().Send(buf.c_str(), buf.size() + 1);
                 }
             }
         }
@@ -188,7 +141,7 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     if(MODE=="CLIENT"){
         /*if (flag[0]==0){
             std::string buf1 = "333";       //turn on white LED: it means the client swarm started moving
-            send(serverSocket, buf1.c_str(), buf1.size() + 1, 0);
+            GetNetwork().Send(buf1.c_str(), buf1.size() + 1);
             std::cout<<"Sending initial signal "<<buf1<<std::endl;
             flag[0] = 1;
         }*/
@@ -226,7 +179,7 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                         std::cout<<"Most populated area: "<<max_index<<std::endl;
                         buf = maxs;                                            //use this to send the number of the target area
                         std::cout<<"Sending index "<<buf<<std::endl;
-                        send(serverSocket, buf.c_str(), buf.size() + 1, 0);            //send the RGB color of the most populated area in client experiment
+                        GetNetwork().Send(buf.c_str(), buf.size() + 1);            //send the RGB color of the most populated area in client experiment
                         flag[1]=1;
                     }
                 }
@@ -287,10 +240,10 @@ void CALFClientServer::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             m_tMessages[unKilobotID].data[1+i*3] = m_tMessages[unKilobotID].data[1+i*3] | (tMessage.m_sData >> 8);
             m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
         }
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
@@ -87,6 +87,9 @@ public:
     /** Virtual environment visualization updating */
 
 
+    /** Handle the messages received from the other ALF */
+    void ReceiveNetworkMessages();
+
     /** Get the message to send to a Kilobot according to its position */
     void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
 
@@ -129,11 +132,7 @@ private:
     std::vector<FloorColorData> m_vecKilobotData;
 
     std::string MODE;
-    char buf[30];                   //buffer containing socket message
-    char bufStore[30];              //array where to store buf to keep it available
-    int bytesReceived;              //length of received string
-    int serverSocket;
-    int clientSocket;
+    char bufStore[30];              //array where to store the last message received to keep it available
     int target_index;               //index of target area
     int num_of_areas;               //number of clustering areas
     int num_of_kbs;                 //number of kilobots on the field
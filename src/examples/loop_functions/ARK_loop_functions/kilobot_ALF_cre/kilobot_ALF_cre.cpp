@@ -74,44 +74,17 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
     }
 
     /* Initializations */
-    bytesReceived = -1;
     memset(storeBuffer, 0, 2000);
     arena_update_counter = 500;
     flag=0;
     outputBuffer = "";
 
-    /* Opening communication port */
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    int port = 54000;
-    std::string ipAddress = IP_ADDR;
-    sockaddr_in hint;
-    hint.sin_family = AF_INET;
-    hint.sin_port = htons(port);
-    inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-    
+    /* Opening communication port: the other ALF is connected without blocking, during the steps */
     if(MODE=="SERVER"){
-        bind(serverSocket, (sockaddr*)&hint, sizeof(hint));
-        listen(serverSocket, SOMAXCONN);
-        sockaddr_in client;
-        socklen_t clientSize = sizeof(client);
-        clientSocket = accept(serverSocket, (sockaddr*)&client, &clientSize);
-        char host[NI_MAXHOST];
-        char service[NI_MAXSERV];
-        memset(host, 0, NI_MAXHOST);
-        memset(service, 0, NI_MAXSERV);
-        if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0)
-        {
-            std::cout << host << " connected on port " << service << std::endl;
-        }
-        else
-        {
-            inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-            std::cout << host << " connected on port " << ntohs(client.sin_port) << std::endl;
-        }
-        close(serverSocket);
+        GetNetwork().Listen(54000, IP_ADDR);
     }
     if(MODE=="CLIENT"){
-        connect(serverSocket, (sockaddr*)&hint, sizeof(hint));
+        GetNetwork().Connect(IP_ADDR, 54000);
     }
 }
 
@@ -124,12 +97,7 @@ void CALFClientServer::Reset() {
 
 void CALFClientServer::Destroy() {
     m_cOutput.close();
-    if (MODE == "SERVER"){
-        close(clientSocket);
-    }
-    if (MODE == "CLIENT"){
-        close(serverSocket);
-    }
+    GetNetwork().Close();
 }
 
 
@@ -195,6 +163,12 @@ void CALFClientServer::SetupVirtualEnvironments(TConfigurationNode& t_tree){
         }
     }
 
+    /* Index the areas, their ids are the indices in multiArea */
+    GetAreaIndex().Clear();
+    for (int ai=0; ai<num_of_areas; ai++){
+        GetAreaIndex().AddCircle(multiArea[ai].Center, multiArea[ai].Radius);
+    }
+
     /* Initialization of areas variables */
     contained = std::vector<int>(num_of_areas, 0);
 }
@@ -209,44 +183,36 @@ void CALFClientServer::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
+void CALFClientServer::ReceiveNetworkMessages(){
+/* Listen for the other ALF communication, once per step */
+    CALFNetwork::SFrame sFrame;
+    CALFMessageReader cMessage;
+    while(GetNetwork().Receive(sFrame)){
+        /* --------- SERVER --------- */
+        if (MODE=="SERVER"){
+            /* Align to client arena, which sends the state of the areas */
+            if (cMessage.Parse(sFrame.Data, sFrame.Size) && (cMessage.GetType() == ALF_MSG_AREA_STATE)){
+                for (int a=0; a<num_of_areas; a++){
+                    multiArea[a].Completed = cMessage.GetBit(a);
+                }
+            }
+        }
+        /* --------- CLIENT --------- */
+        if (MODE=="CLIENT"){
+            /* Save the received string in a vector, for having data available until next message comes */
+            memset(storeBuffer, 0, 2000);
+            memcpy(storeBuffer, sFrame.Data, Min<UInt32>(sFrame.Size, 1999));
+            //std::cout<<storeBuffer<<std::endl;
+        }
+    }
+}
+
+
 void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     UInt16 unKilobotID = GetKilobotId(c_kilobot_entity);
     CVector2 cKilobotPosition = GetKilobotPosition(c_kilobot_entity);
     CRadians cKilobotOrientation = GetKilobotOrientation(c_kilobot_entity);
 
-/* Listen for the other ALF communication */
-    memset(inputBuffer, 0, 2000);
-    if (MODE == "SERVER"){
-        bytesReceived = recv(clientSocket, inputBuffer, 2000, MSG_DONTWAIT);
-    }
-    if (MODE == "CLIENT"){
-        bytesReceived = recv(serverSocket, inputBuffer, 2000, MSG_DONTWAIT);
-    }
-    if ((bytesReceived == -1) || (bytesReceived == 0)){
-        //std::cout << "not receiving" << std::endl;
-    }
-    else 
-    {
-        /* Save the received string in a vector, for having data available until next message comes */
-        for (int i=0; i<2000; i++){
-            storeBuffer[i] = inputBuffer[i];
-        }
-        //std::cout<<storeBuffer<<std::endl;
-    }
-
-    /* --------- SERVER --------- */
-    if (MODE=="SERVER"){
-        /* Align to server arena */
-        for (int a=0; a<num_of_areas; a++){
-            if (storeBuffer[a]-48 == 0) {
-                multiArea[a].Completed = false;
-            }
-            else{
-                multiArea[a].Completed = true;
-            }
-        }
-    }
-
     /* --------- CLIENT --------- */
     if (MODE=="CLIENT"){
 //************************************************************************************
@@ -295,28 +261,20 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     if (unKilobotID == 0){
         /* --------- CLIENT --------- */
         if (MODE=="CLIENT"){
-            /* Build the message for the other ALF */
-            outputBuffer = "";
+            /* Build and send the message for the other ALF */
+            area_message.Start(ALF_MSG_AREA_STATE, lenMultiArea);
             for (int k=0; k<lenMultiArea; k++){
-                if(multiArea[k].Completed==true){
-                    outputBuffer.append("1");
-                }
-                else{
-                    outputBuffer.append("0");
-                }
+                area_message.SetBit(k, multiArea[k].Completed);
             }
-            //std::cout<<"outbuffer "<<outputBuffer<<std::endl;
-        }
-
-        /* Send the message to the other ALF*/
-        if (MODE == "SERVER"){
-            send(clientSocket, outputBuffer.c_str(), outputBuffer.size() + 1, 0);
+            GetNetwork().Send(area_message.GetData(), area_message.GetSize());
         }
-        if (MODE == "CLIENT"){
-            send(serverSocket, outputBuffer.c_str(), outputBuffer.size() + 1, 0);
+        /* --------- SERVER --------- */
+        if (MODE=="SERVER"){
+            /* Send the message to the other ALF*/
+            GetNetwork().Send(outputBuffer.c_str(), outputBuffer.size() + 1);
+            //std::cout<<"pos and commit:\t"<< outputBuffer << std::endl;
+            outputBuffer = "";
         }
-        //std::cout<<"pos and commit:\t"<< outputBuffer << std::endl;
-        outputBuffer = "";
     }
         /* --------- SERVER --------- */
     if (MODE=="SERVER"){
@@ -341,35 +299,33 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
 
 /* Task check*/
     if(MODE=="CLIENT"){
-        for (int i=0;i<lenMultiArea;i++){ 
-            Real fDistance = Distance(cKilobotPosition, multiArea[i].Center);
-            if((fDistance < (multiArea[i].Radius*1)) && (multiArea[i].Completed == false)){
-                multiArea[i].Completed=true;
-                /* Reactivate tasks to keep their number constant */
-                std::default_random_engine re;
-                re.seed(random_seed);
-                if (multiArea[i].Color == argos::CColor::RED){
-                    std::uniform_int_distribution<int> distr(0, max_red_area_id);
-                    int random_number;
-                    do{
-                        random_number = distr(re);
-                    }while (std::find(activated_red_areas.begin(), activated_red_areas.end(), random_number) != activated_red_areas.end());
-                    activated_red_areas.push_back(random_number);
-                    multiArea[random_number].Completed = false;
-                    activated_red_areas.erase(std::find(activated_red_areas.begin(), activated_red_areas.end(), i));
-                    std::sort(activated_red_areas.begin(), activated_red_areas.end());
-                }
-                else if (multiArea[i].Color == argos::CColor::GREEN){
-                    std::uniform_int_distribution<int> distr(max_red_area_id+1, max_blue_area_id);
-                    int random_number;
-                    do{
-                        random_number = distr(re);
-                    }while (std::find(activated_blue_areas.begin(), activated_blue_areas.end(), random_number) != activated_blue_areas.end());
-                    activated_blue_areas.push_back(random_number);
-                    multiArea[random_number].Completed = false;
-                    activated_blue_areas.erase(std::find(activated_blue_areas.begin(), activated_blue_areas.end(), i));
-                    std::sort(activated_blue_areas.begin(), activated_blue_areas.end());
-                }
+        int i = GetAreaIndex().GetRobotArea(GetKilobotIndex(c_kilobot_entity));
+        if((i >= 0) && (multiArea[i].Completed == false)){
+            multiArea[i].Completed=true;
+            /* Reactivate tasks to keep their number constant */
+            std::default_random_engine re;
+            re.seed(random_seed);
+            if (multiArea[i].Color == argos::CColor::RED){
+                std::uniform_int_distribution<int> distr(0, max_red_area_id);
+                int random_number;
+                do{
+                    random_number = distr(re);
+                }while (std::find(activated_red_areas.begin(), activated_red_areas.end(), random_number) != activated_red_areas.end());
+                activated_red_areas.push_back(random_number);
+                multiArea[random_number].Completed = false;
+                activated_red_areas.erase(std::find(activated_red_areas.begin(), activated_red_areas.end(), i));
+                std::sort(activated_red_areas.begin(), activated_red_areas.end());
+            }
+            else if (multiArea[i].Color == argos::CColor::GREEN){
+                std::uniform_int_distribution<int> distr(max_red_area_id+1, max_blue_area_id);
+                int random_number;
+                do{
+                    random_number = distr(re);
+                }while (std::find(activated_blue_areas.begin(), activated_blue_areas.end(), random_number) != activated_blue_areas.end());
+                activated_blue_areas.push_back(random_number);
+                multiArea[random_number].Completed = false;
+                activated_blue_areas.erase(std::find(activated_blue_areas.begin(), activated_blue_areas.end(), i));
+                std::sort(activated_blue_areas.begin(), activated_blue_areas.end());
             }
         }
     }
@@ -502,10 +458,10 @@ void CALFClientServer::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
                 std::cout<<"red:"<< m_tMessages[unKilobotID].data[1+i*3]<<" - blue:"<< m_tMessages[unKilobotID].data[2+i*3]<<std::endl;
             }
         }
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
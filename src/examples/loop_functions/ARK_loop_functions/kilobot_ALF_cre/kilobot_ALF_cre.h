@@ -89,6 +89,9 @@ public:
     /** Virtual environment visualization updating */
 
 
+    /** Handle the messages received from the other ALF */
+    void ReceiveNetworkMessages();
+
     /** Get the message to send to a Kilobot according to its position */
     void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
 
@@ -151,12 +154,9 @@ private:
     int desired_blue_areas;
     float reactivation_rate;
     float communication_range;
-    char inputBuffer[2000];           //array containing the message received from the socket
-    std::string outputBuffer;          //array  containing the message to send
+    std::string outputBuffer;          //array  containing the message to send (server)
+    CALFMessageWriter area_message;    //message containing the state of the areas to send (client)
     char storeBuffer[2000];           //array where to store input message to keep it available
-    int bytesReceived;              //length of received string
-    int serverSocket;
-    int clientSocket;
     int num_of_areas;               //number of clustering areas
     int lenMultiArea;
     int num_of_kbs;                 //number of kilobots on the field
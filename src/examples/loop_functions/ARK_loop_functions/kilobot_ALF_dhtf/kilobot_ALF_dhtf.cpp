@@ -145,35 +145,24 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
         std::vector<int> client_task_type (activated_areas.size(), 0);
 
 
-        initialise_buffer = "I";
+        /* the entries of the initialise message are the active areas: id, server task type, client task type */
+        initialise_message.Start(ALF_MSG_INIT, activated_areas.size(), 3);
 
         for(int i=0; i<activated_areas.size(); i++)
         {  
-            int char_id = 97+activated_areas[i];    // 97 is a in ASCII table
-            char A = static_cast<char>(char_id);
-            std::string s(1, A);
-            initialise_buffer.append(s);
-
             if(std::find(hard_tasks_vec.begin(),hard_tasks_vec.end(), activated_areas[i]) != hard_tasks_vec.end())
                 server_task_type[i] = 1;
 
             if(std::find(hard_tasks_client_vec.begin(),hard_tasks_client_vec.end(), activated_areas[i]) != hard_tasks_client_vec.end())
                 client_task_type[i] = 1;
 
+            UInt8* punFields = initialise_message.GetFields(i);
+            punFields[0] = activated_areas[i];
+            punFields[1] = server_task_type[i];
+            punFields[2] = client_task_type[i];
         }
 
 
-        for(int s_task : server_task_type)
-        {
-            initialise_buffer.append(std::to_string(s_task));
-        }
-        for(int c_task : client_task_type)
-        {
-            initialise_buffer.append(std::to_string(c_task));
-        }
-
-        // std::cout << "initialise_buffer: " << initialise_buffer << std::endl; 
-
         //Remove the extra multiArea loaded from .argos file
         for(int i=0; i<multiArea.size(); i++)
         {
@@ -202,6 +191,7 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
             }   
 
         }
+        BuildAreaIndex();
 
         // Print active areas id and colour
         // std::cout<<"Area id \t colour\n";
@@ -219,42 +209,15 @@ void CALFClientServer::Init(TConfigurationNode& t_node) {
     }
 
     /* Initializations */
-    bytesReceived = -1;
-    memset(storeBuffer, 0, 30);     //set to 0 the 30 elements in storeBuffer
+    last_message_type = 0;
     initialised = false;
 
-    /* Socket initialization, opening communication port */
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    std::string ipAddress = IP_ADDR;
-    sockaddr_in hint;
-    hint.sin_family = AF_INET;
-	hint.sin_addr.s_addr = INADDR_ANY;
-    hint.sin_port = htons(port);
-    inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-
+    /* Opening communication port: the other ALF is connected without blocking, during the steps */
     if(MODE=="SERVER"){
-        bind(serverSocket, (sockaddr*)&hint, sizeof(hint));
-        listen(serverSocket, SOMAXCONN);
-        sockaddr_in client;
-        socklen_t clientSize = sizeof(client);
-        clientSocket = accept(serverSocket, (sockaddr*)&client, &clientSize);
-        char host[NI_MAXHOST];
-        char service[NI_MAXSERV];
-        memset(host, 0, NI_MAXHOST);
-        memset(service, 0, NI_MAXSERV);
-        if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0){
-            std::cout << host << " connected on port " << service << std::endl;
-            std::cout << "Somebody has connected on port " << service << std::endl;
-        }
-        else{
-            inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-            std::cout << host << " connected on port " << ntohs(client.sin_port) << std::endl;
-            std::cout << "Somebody has connected on port " << service << std::endl;
-        }
-        close(serverSocket);
+        GetNetwork().Listen(port, IP_ADDR);
     }
     if(MODE=="CLIENT"){
-        connect(serverSocket, (sockaddr*)&hint, sizeof(hint));
+        GetNetwork().Connect(IP_ADDR, port);
     }
 }
 
@@ -267,12 +230,7 @@ void CALFClientServer::Reset() {
 
 void CALFClientServer::Destroy() {
     m_cOutput.close();
-    if (MODE == "SERVER"){
-        close(clientSocket);
-    }
-    if (MODE == "CLIENT"){
-        close(serverSocket);
-    }
+    GetNetwork().Close();
 }
 
 
@@ -305,10 +263,15 @@ void CALFClientServer::SetupVirtualEnvironments(TConfigurationNode& t_tree){
     TConfigurationNodeIterator itAct;
     
     /* Compute number of areas on the field*/
-    num_of_areas=0;
+    size_t unNumAreas=0;
     for (itAct = itAct.begin(&tVirtualEnvironmentsNode); itAct != itAct.end(); ++itAct) {
-        num_of_areas += 1;
+        unNumAreas += 1;
     }
+    /* The area ids are sent to the other ALF in one byte */
+    if (unNumAreas > 255){
+        THROW_ARGOSEXCEPTION("At most 255 areas are supported, " << unNumAreas << " given");
+    }
+    num_of_areas=unNumAreas;
 
     /* Build the structure with areas data */
     multiArea.resize(num_of_areas);
@@ -333,6 +296,16 @@ void CALFClientServer::SetupVirtualEnvironments(TConfigurationNode& t_tree){
 
     /* Initialization of areas variables */
     contained = std::vector<UInt8>(num_of_areas, 0);
+    BuildAreaIndex();
+}
+
+
+void CALFClientServer::BuildAreaIndex(){
+    /* The area ids in the index are the indices in multiArea */
+    GetAreaIndex().Clear();
+    for (size_t i=0; i<multiArea.size(); i++){
+        GetAreaIndex().AddCircle(multiArea[i].Center, multiArea[i].Radius);
+    }
 }
 
 
@@ -345,62 +318,39 @@ void CALFClientServer::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
-void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
-    UInt16 unKilobotID = GetKilobotId(c_kilobot_entity);
-    CVector2 cKilobotPosition = GetKilobotPosition(c_kilobot_entity);
-
-
-/* Listen for the other ALF communication */
-    memset(inputBuffer, 0, 30);
-    
-    if (MODE == "SERVER"){
-        bytesReceived = recv(clientSocket, inputBuffer, 30, MSG_DONTWAIT);
-    }
-    else if (MODE == "CLIENT"){
-        bytesReceived = recv(serverSocket, inputBuffer, 30, MSG_DONTWAIT);
-    }
-
-    if ((bytesReceived != -1) || (bytesReceived != 0))
-    {
-        /* Save the received string in a vector, for having data available until next message comes */
-        for (int i=0; i<bytesReceived; i++){
-            storeBuffer[i] = inputBuffer[i];
-        }
-        // Print received message
-        // std::cout<<storeBuffer<<std::endl;
-        std::string my_string (inputBuffer);
-        /*if(!my_string.empty())
-            std::cout << "Received:" << my_string << std::endl;*/
-    }
-    else {
-        //std::cout << "not receiving" << std::endl;
-    }
+void CALFClientServer::ReceiveNetworkMessages(){
+/* Listen for the other ALF communication, once per step */
+    CALFNetwork::SFrame sFrame;
+    CALFMessageReader cMessage;
+    while(GetNetwork().Receive(sFrame)){
+        if(!cMessage.Parse(sFrame.Data, sFrame.Size)){
+            std::cerr<<"Discarding an invalid message from the other ALF"<<std::endl;
+            continue;
+        }
+        /* Save the received type and area bits, for having data available until next message comes */
+        last_message_type = cMessage.GetType();
+        received_bits.resize(cMessage.GetNumEntries());
+        for(UInt16 i=0; i<cMessage.GetNumEntries(); i++){
+            received_bits[i] = cMessage.GetBit(i);
+        }
 
-    // Print received message
-    // std::cerr<<"Recv_str "<<storeBuffer<<std::endl;
-    /* --------- CLIENT --------- */
-    if (MODE=="CLIENT"){
+        /* --------- CLIENT --------- */
         /* Initialize the tasks selected by the server */
-        if ((storeBuffer[0]==73)&&(initialised==false)){    //73 is the ASCII binary for "I"
+        if ((MODE=="CLIENT")&&(last_message_type==ALF_MSG_INIT)&&(initialised==false)&&(cMessage.GetFieldSize()>=3)){
             /*choice of areas*/
-            
-
-            std::string storebuffer(storeBuffer);
-            storebuffer.erase(storebuffer.begin());
-            num_of_areas = storebuffer.size()/3;
+            num_of_areas = cMessage.GetNumEntries();
             otherColor.resize(num_of_areas);
-            std::string server_task(storebuffer.begin() + num_of_areas, storebuffer.begin() + 2*num_of_areas);
-            std::string client_task(storebuffer.begin() + 2*num_of_areas, storebuffer.end());
-            std::cout << server_task << std::endl;
-            std::cout << client_task << std::endl;
-            std::cout<< "num of areas: "<< num_of_areas << std::endl;
-
             std::vector<int> active_areas;
+            std::vector<int> server_task;
+            std::vector<int> client_task;
             for(int i=0; i<num_of_areas;i++)
             {
-                active_areas.push_back(storebuffer[i]-97);
-                // std::cout << "storebuffer[i] "<< storebuffer[i] << std::endl;
+                const UInt8* punFields = cMessage.GetFields(i);
+                active_areas.push_back(punFields[0]);
+                server_task.push_back(punFields[1]);
+                client_task.push_back(punFields[2]);
             }
+            std::cout<< "num of areas: "<< num_of_areas << std::endl;
 
             std::cout<< "Active areas: \n";        
             for(int id : active_areas)
@@ -412,34 +362,67 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
             {
                 if( std::find(active_areas.begin(), active_areas.end(), multiArea[i].Id) == active_areas.end())
                 {
+                    /* The task types are indexed by active area: skip them for the erased one */
                     multiArea.erase(multiArea.begin()+i);
                     i-= 1;
+                    continue;
                 }
 
                 /*fill othercolor field*/
-                if(server_task[i] == '1')
+                if(server_task[i] == 1)
                     otherColor[i] = 1;
 
                 /*fill own color field */
-                if(client_task[i] == '1')
+                if(client_task[i] == 1)
                     multiArea[i].Color = argos::CColor::RED;
             }
-            
-            std::cout<< "Multi areas: \n";        
-            for(int id : active_areas)
-            {
-                std::cout << id << std::endl;
-            }
+            BuildAreaIndex();
 
-            // std::cout<<"Recv_str "<<storeBuffer<<std::endl;
             initialised=true;
         }
+    }
+}
+
+
+void CALFClientServer::UpdateKilobotStates(){
+    UpdateAreas();
+    /* Reset the area counts of the threads */
+    containedDelta.resize(GetThreads());
+    containedReset.resize(GetThreads());
+    for (UInt32 t=0; t<GetThreads(); t++){
+        containedDelta[t].assign(num_of_areas, 0);
+        containedReset[t].assign(num_of_areas, 0);
+    }
+    CALF::UpdateKilobotStates();
+}
+
+
+void CALFClientServer::ReduceKilobotStates(){
+    for (int i=0; i<num_of_areas; i++){
+        SInt32 nDelta = 0;
+        bool bReset = false;
+        for (UInt32 t=0; t<containedDelta.size(); t++){
+            nDelta += containedDelta[t][i];
+            bReset = bReset || containedReset[t][i];
+        }
+        /* A completed area is emptied: its robots only leave it in this step */
+        if (bReset){
+            contained[i] = 0;
+        }
+        else{
+            contained[i] += nDelta;
+        }
+    }
+}
+
 
+void CALFClientServer::UpdateAreas(){
+    /* --------- CLIENT --------- */
+    if (MODE=="CLIENT"){
         /* Align to server arena */
-        if ((storeBuffer[0]==65)&&(initialised==true)){ //65 is the ASCII binary for "A"
-            //std::cout<<storeBuffer<<std::endl;
+        if ((last_message_type==ALF_MSG_AREA_STATE)&&(initialised==true)){
             for (int a=0; a<num_of_areas; a++){
-                if (storeBuffer[a+1]-48 == 0) {
+                if ((a >= received_bits.size()) || (received_bits[a] == false)) {
                     multiArea[a].Completed = false;
                 }
                 else{
@@ -463,9 +446,9 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
             }
         }
         /* Task completeness check */
-        if (storeBuffer[0]==84){ //84 is the ASCII binary for "T"
+        if (last_message_type==ALF_MSG_TASK_STATE){
             for (int j=0; j<num_of_areas; j++){
-                if ((storeBuffer[j+1]-48 == 1) && multiArea[j].Completed == false){
+                if ((j < received_bits.size()) && received_bits[j] && multiArea[j].Completed == false){
                     if (otherColor[j]==kRED){
                         if ((multiArea[j].Color==argos::CColor::RED)&&(contained[j]>=6)){
                             multiArea[j].Completed = true;
@@ -533,90 +516,70 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
 
 
 /* Speak to the other ALF */
-    if (unKilobotID == 0){          // just to speak to the other ARK once for each cycle
-        /* --------- CLIENT --------- */
-        if (MODE=="CLIENT"){
-            /* Build the message for the other ALF */
-            outputBuffer = "T"; //"T" indicates that the message is related to task completeness
-            for (int k=0; k<num_of_areas; k++){
-                /* Write 1 or 2 if the requirements of the area are satisfied for the sender, else write 0 */
-                if (multiArea[k].Color==argos::CColor::RED){
-                    if (contained[k] >= 6) {
-                        outputBuffer.append("1");   //hard task completed
-                    }
-                    else {
-                        outputBuffer.append("0");
-                    }
-                }
-                else if (multiArea[k].Color==argos::CColor::BLUE){
-                    if (contained[k] >= 2) {
-                        outputBuffer.append("1");   //easy task completed
-                    }
-                    else {
-                        outputBuffer.append("0");
-                    }            
-                }
-            }
-            //std::cout<<outputBuffer<<std::endl;
-        }
-
-        /* --------- SERVER --------- */
-        if (MODE=="SERVER"){
-            /* Build the message for the other ALF */
-            if (initialised==true){
-                outputBuffer = "A";
-                for (int k=0; k<num_of_areas; k++){
-                    if(multiArea[k].Completed==true){
-                        outputBuffer.append("1");
-                    }
-                    else{
-                        outputBuffer.append("0");
-                    }
-                }
+    /* --------- CLIENT --------- */
+    if (MODE=="CLIENT"){
+        /* Build the message for the other ALF: the bit of an area is set if its requirements are satisfied for the sender */
+        output_message.Start(ALF_MSG_TASK_STATE, num_of_areas);
+        for (int k=0; k<num_of_areas; k++){
+            if (multiArea[k].Color==argos::CColor::RED){
+                output_message.SetBit(k, contained[k] >= 6);    //hard task completed
             }
-            else if (storeBuffer[0] == 82)
-            {
-                std::cout<<"ACK init by client*********\n";
-                initialised = true;
+            else if (multiArea[k].Color==argos::CColor::BLUE){
+                output_message.SetBit(k, contained[k] >= 2);    //easy task completed
             }
         }
+    }
 
-       // std::cout<<"Sending: ";
-        /* Send the message to the other ALF*/
-        if (MODE == "SERVER"){
-            if(initialised == false){
-                //std::cout<<initialise_buffer<<std::endl;
-                send(clientSocket, initialise_buffer.c_str(), initialise_buffer.size() + 1, 0);
-            }
-            else{
-                // std::cout<<"mando update\n";
-                //std::cout<<outputBuffer<<std::endl;
-                send(clientSocket, outputBuffer.c_str(), outputBuffer.size() + 1, 0);
+    /* --------- SERVER --------- */
+    if (MODE=="SERVER"){
+        /* Build the message for the other ALF */
+        if (initialised==true){
+            output_message.Start(ALF_MSG_AREA_STATE, num_of_areas);
+            for (int k=0; k<num_of_areas; k++){
+                output_message.SetBit(k, multiArea[k].Completed);
             }
         }
+        else if (last_message_type == ALF_MSG_INIT_ACK)
+        {
+            std::cout<<"ACK init by client*********\n";
+            initialised = true;
+        }
+    }
 
-        if (MODE == "CLIENT"){
-            std::string client_str;
+    /* Send the message to the other ALF*/
+    if (MODE == "SERVER"){
+        if(initialised == false){
+            GetNetwork().Send(initialise_message.GetData(), initialise_message.GetSize());
+        }
+        else{
+            GetNetwork().Send(output_message.GetData(), output_message.GetSize());
+        }
+    }
 
-            if(initialised == false){
-                client_str = "Missing parameters";
-                //std::cout<<client_str<<std::endl;
-                send(serverSocket, client_str.c_str(), client_str.size() + 1, 0);
-            }
-            else if(storeBuffer[0]== 73)        //73 is the ASCII binary for "I"
-            {
-                client_str = "Received parameters";
-                //std::cout<<client_str<<std::endl;                
-                send(serverSocket, client_str.c_str(), client_str.size() + 1, 0);
-            }
-            else
-            {
-                //std::cout<<outputBuffer<<std::endl;
-                send(serverSocket, outputBuffer.c_str(), outputBuffer.size() + 1, 0);
-            }
-            
-        }   
+    if (MODE == "CLIENT"){
+        if(initialised == false){
+            CALFMessageWriter cRequest;
+            cRequest.Start(ALF_MSG_INIT_REQUEST);
+            GetNetwork().Send(cRequest.GetData(), cRequest.GetSize());
+        }
+        else if(last_message_type == ALF_MSG_INIT)
+        {
+            CALFMessageWriter cAck;
+            cAck.Start(ALF_MSG_INIT_ACK);
+            GetNetwork().Send(cAck.GetData(), cAck.GetSize());
+        }
+        else
+        {
+            GetNetwork().Send(output_message.GetData(), output_message.GetSize());
+        }
+        
     }
+}
+
+
+void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
+    UInt16 unKilobotID = GetKilobotId(c_kilobot_entity);
+    CVector2 cKilobotPosition = GetKilobotPosition(c_kilobot_entity);
 
 
 /* State transition*/
@@ -624,50 +587,48 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
         switch (m_vecKilobotStates_ALF[unKilobotID]) {
             case OUTSIDE_AREAS : {
                 /* Check if the kilobot is entered in a task area */
-                for (int i=0;i<num_of_areas;i++){ 
-                    Real fDistance = Distance(cKilobotPosition, multiArea[i].Center);
-                    if((fDistance < (multiArea[i].Radius*1)) && (multiArea[i].Completed == false)){     //*1 is a threshold, to include the boarder increase it
-                        m_vecKilobotStates_ALF[unKilobotID] = INSIDE_AREA;
-                        /* Check LED color to understand if the robot is leaving or it is waiting for the task */
-                        if (GetKilobotLedColor(c_kilobot_entity) != CColor::BLUE){
-                            // std::cout<< "inside area = "<< multiArea[i].Id << std::endl;
-                            /* Check the area color to understand the requirements of the task */
-                            if (multiArea[i].Color==argos::CColor::RED){
-                                if(augmented_knowledge==true){
-                                    if (otherColor[i]==kRED){
-                                        request[unKilobotID] = kRR;
-                                        // std::cout<<"red-red task 50s\n";
-                                    }
-                                    if (otherColor[i]==kBLUE){
-                                        request[unKilobotID] = kRB;
-                                        // std::cout<<"red-blue task 30s\n";
-                                    }
+                SInt32 i = GetAreaIndex().GetRobotArea(GetKilobotIndex(c_kilobot_entity));
+                if((i >= 0) && (multiArea[i].Completed == false)){
+                    m_vecKilobotStates_ALF[unKilobotID] = INSIDE_AREA;
+                    /* Check LED color to understand if the robot is leaving or it is waiting for the task */
+                    if (GetKilobotLedColor(c_kilobot_entity) != CColor::BLUE){
+                        // std::cout<< "inside area = "<< multiArea[i].Id << std::endl;
+                        /* Check the area color to understand the requirements of the task */
+                        if (multiArea[i].Color==argos::CColor::RED){
+                            if(augmented_knowledge==true){
+                                if (otherColor[i]==kRED){
+                                    request[unKilobotID] = kRR;
+                                    // std::cout<<"red-red task 50s\n";
                                 }
-                                else{
+                                if (otherColor[i]==kBLUE){
                                     request[unKilobotID] = kRB;
-                                    // std::cout<<"unknown\n";
+                                    // std::cout<<"red-blue task 30s\n";
                                 }
                             }
-                            if (multiArea[i].Color==argos::CColor::BLUE){
-                                if(augmented_knowledge==true){
-                                    if (otherColor[i]==kRED){
-                                        request[unKilobotID] = kBR;
-                                        // std::cout<<"blue-red task 20s\n";
-                                    }
-                                    if (otherColor[i]==kBLUE){
-                                        request[unKilobotID] = kBB;
-                                        // std::cout<<"blue-blue task 10s\n";
-                                    }
+                            else{
+                                request[unKilobotID] = kRB;
+                                // std::cout<<"unknown\n";
+                            }
+                        }
+                        if (multiArea[i].Color==argos::CColor::BLUE){
+                            if(augmented_knowledge==true){
+                                if (otherColor[i]==kRED){
+                                    request[unKilobotID] = kBR;
+                                    // std::cout<<"blue-red task 20s\n";
                                 }
-                                else
-                                {
+                                if (otherColor[i]==kBLUE){
                                     request[unKilobotID] = kBB;
-                                    // std::cout<<"unknown\n";
+                                    // std::cout<<"blue-blue task 10s\n";
                                 }
                             }
-                            whereis[unKilobotID] = i;
-                            contained[i] += 1;
+                            else
+                            {
+                                request[unKilobotID] = kBB;
+                                // std::cout<<"unknown\n";
+                            }
                         }
+                        whereis[unKilobotID] = i;
+                        containedDelta[GetThreadIndex()][i] += 1;
                     }
                 }
             break;
@@ -676,21 +637,21 @@ void CALFClientServer::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                 /* Check if the kilobot timer for colaboratos is expired */
                 if (GetKilobotLedColor(c_kilobot_entity) == CColor::BLUE){
                     m_vecKilobotStates_ALF[unKilobotID] = LEAVING;
-                    contained[whereis[unKilobotID]] -= 1;
+                    if (whereis[unKilobotID] >= 0)
+                        containedDelta[GetThreadIndex()][whereis[unKilobotID]] -= 1;
                 }
                 /* Else check if the task has been completed */
                 if (multiArea[whereis[unKilobotID]].Completed == true){
                     m_vecKilobotStates_ALF[unKilobotID] = OUTSIDE_AREAS;
-                    contained[whereis[unKilobotID]] = 0;
+                    containedReset[GetThreadIndex()][whereis[unKilobotID]] = 1;
                     whereis[unKilobotID] = -1;
                 }
             break;
             }
             case LEAVING : {
                 /* Case in which the robot is inside an area but it is moving */
-                Real fDistance = Distance(cKilobotPosition, multiArea[whereis[unKilobotID]].Center);
                 /* Check when the robot is back outside  */
-                if (fDistance > (multiArea[whereis[unKilobotID]].Radius)){
+                if (!GetAreaIndex().Contains(whereis[unKilobotID], cKilobotPosition)){
                     m_vecKilobotStates_ALF[unKilobotID] = OUTSIDE_AREAS;
                     whereis[unKilobotID] = -1;
                 }
@@ -936,10 +897,10 @@ void CALFClientServer::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             //std::cout<<" robot "<<tMessage.m_sID<<" "<<tMessage.m_sType<<std::endl;
         }
         //std::cout<<"payload: "<<tKilobotMessage.m_sData<<std::endl;
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
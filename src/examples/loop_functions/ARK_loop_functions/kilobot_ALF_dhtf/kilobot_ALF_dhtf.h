@@ -90,9 +90,23 @@ public:
     /** Virtual environment visualization updating */
 
 
+    /** Handle the messages received from the other ALF */
+    void ReceiveNetworkMessages();
+
+    /** Update the areas and speak to the other ALF, then update the state of the kilobots */
+    virtual void UpdateKilobotStates();
+
     /** Get the message to send to a Kilobot according to its position */
     void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
 
+    /** Add the area counts of all the threads to contained */
+    virtual void ReduceKilobotStates();
+
+    /** The per-robot hooks write only the state of their kilobot and the counts of their thread */
+    virtual bool HasThreadSafeHooks() const {
+        return true;
+    }
+
 
     /** Get the message to send to a Kilobot according to its position */
     void UpdateVirtualSensor(CKilobotEntity& c_kilobot_entity);
@@ -106,6 +120,12 @@ public:
     /** Simulate proximity sensor*/
     std::vector<int> Proximity_sensor(CVector2 obstacle_direction, Real kOrientation, int num_sectors);
 
+    /** Fills the area index with the areas, in the order of multiArea */
+    void BuildAreaIndex();
+
+    /** Update the state of the areas and exchange it with the other ALF, once per step */
+    void UpdateAreas();
+
 private:
     /************************************/
     /*  Virtual Environment variables   */
@@ -162,14 +182,11 @@ private:
     std::vector<int> otherColor;    //Color of the areas on the other ARK
     //int otherColor[10];
     bool IsNotZero (int i) {return (i!=0); } //to count how non 0 emelent there are in sendind/receiving buffer
-    char inputBuffer[30];           //array containing the message received from the socket e.g. 
-    std::string initialise_buffer;  // buffer containing setup values (active areas and task type)
-    std::string outputBuffer;         //array  containing the message to send
-    char storeBuffer[30];           //array where to store input message to keep it available
-    int bytesReceived;              //length of received string
-    int serverSocket;               //socket variable
-    int clientSocket;               //socket variable
-    UInt8 num_of_areas;             //initial number of clustering areas i.e. 16, will be reduced to desired_num_of_areas
+    CALFMessageWriter initialise_message;  // message containing setup values (active areas and task type)
+    CALFMessageWriter output_message;      // message to send
+    UInt8 last_message_type;          // type of the last message received, 0 if none, to keep it available
+    std::vector<bool> received_bits;  // area bits of the last message received
+    UInt8 num_of_areas;             //initial number of clustering areas i.e. 16 (max 255), will be reduced to desired_num_of_areas
     double kRespawnTimer;           //when completed, timer starts and when it will expire the area is reactivated
     std::vector<double> vCompletedTime;  //vector with completition time
     bool initialised;               // true when client ACK the initial setup
@@ -181,6 +198,8 @@ private:
     
     /*vectors as long as the number of areas*/
     std::vector<UInt8> contained;     //how many KBs the area "i" contains
+    std::vector<std::vector<SInt32> > containedDelta;  //for each thread, change of contained in the current step
+    std::vector<std::vector<UInt8> > containedReset;   //for each thread, 1 for the areas emptied in the current step
     
     std::vector<SRobotState> m_vecKilobotStates_ALF;        //state of KB from ARK point of view
     std::vector<Real> m_vecLastTimeMessaged;
@@ -11,18 +11,15 @@
 #include "kilobot_v1.h"
 
 //CLIENT
-char buf[30];
 char bufStore[30];
 int num_of_areas=1;
 int num_of_kb=15;
-int bytesReceived=-1;
 std::vector<bool> filledArea(6,0);      //is area "i" empty or not
 std::vector<bool> inPlace(num_of_kb,0); //vector with 1 corresponding to KBs that stopped moving (they are inside an area)
 int placed = 0;                         //number of stopped KBs
 std::vector<int> contained(6,0);        //how many KBs the area "i" contains
 bool flag1 = 0;
 bool flag2 = 0;
-int serverSocket = socket(AF_INET, SOCK_STREAM, 0); //socket for client-server communication
 
 
 CClusteringALF::CClusteringALF() :
@@ -41,13 +38,7 @@ void CClusteringALF::Init(TConfigurationNode& t_node) {
     m_cOutput.open(m_strOutputFileName, std::ios_base::trunc | std::ios_base::out);
 
 //----------------------------------------------OPEN PORT-------------------------------------------------------------------------------------
-    int port = 54000;
-    std::string ipAddress = "127.0.0.1";
-    sockaddr_in hint;
-    hint.sin_family = AF_INET;
-    hint.sin_port = htons(port);
-    inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-    connect(serverSocket, (sockaddr*)&hint, sizeof(hint));
+    GetNetwork().Connect("127.0.0.1", 54000);               //connected without blocking, during the steps
 //--------------------------------------------------------------------------------------------------------------------------------------------
 }
 
@@ -63,7 +54,7 @@ void CClusteringALF::Reset() {
 void CClusteringALF::Destroy() {
     /* Close data file */
     m_cOutput.close();
-    close(serverSocket);
+    GetNetwork().Close();
 }
 
 
@@ -125,33 +116,26 @@ void CClusteringALF::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
+void CClusteringALF::ReceiveNetworkMessages(){
+    /* Listen to the server, once per step */
+    CALFNetwork::SFrame sFrame;
+    while(GetNetwork().Receive(sFrame)){
+        memcpy(bufStore, sFrame.Data, Min<UInt32>(sFrame.Size, 6));
+        std::cout<<"kilobots on target: "<<bufStore<<std::endl;
+    }
+}
+
+
 void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     /* Update the state of the kilobot (inside or outside the clustering hub)*/
 
     if (flag2==0){
         std::string buf1 = "333";       //turn on white LED: it means the client swarm started moving
-        send(serverSocket, buf1.c_str(), buf1.size() + 1, 0);
+        GetNetwork().Send(buf1.c_str(), buf1.size() + 1);
         std::cout<<"Sending initial signal "<<buf1<<std::endl;
         flag2 = 1;
     }
 
-    bytesReceived = recv(serverSocket, buf, 30, MSG_DONTWAIT);
-    if (bytesReceived == -1){
-        //std::cout << "received -1 char" << std::endl;
-    }
-    else if(bytesReceived == 0){
-        //std::cout << "received 0 char" << std::endl;
-    }
-    else 
-    {
-        bufStore[0]=buf[0];
-        bufStore[1]=buf[1];
-        bufStore[2]=buf[2];
-        bufStore[3]=buf[3];
-        bufStore[4]=buf[4];
-        bufStore[5]=buf[5];
-        std::cout<<"kilobots on target: "<<bufStore<<std::endl;
-    }
     for(int i=1;i<num_of_areas;i++){
         UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
         CVector2 cKilobotPosition=GetKilobotPosition(c_kilobot_entity);
@@ -169,7 +153,7 @@ void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                 buf.append(std::to_string(i));
                 buf.append(" discovered by kilobot number ");
                 buf.append(std::to_string(unKilobotID));
-                send(serverSocket, buf.c_str(), buf.size() + 1, 0);
+                GetNetwork().Send(buf.c_str(), buf.size() + 1);
                 filledArea[i-1]=1;
             }*/
             if (inPlace[unKilobotID]==0){                               //say in which area each kilobot stops
@@ -177,14 +161,14 @@ void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                 buf.append(std::to_string(unKilobotID));
                 buf.append(" placed in area number ");
                 buf.append(std::to_string(i));
-                send(serverSocket, buf.c_str(), buf.size() + 1, 0);*/
+                GetNetwork().Send(buf.c_str(), buf.size() + 1);*/
                 contained[i-1]+=1;
                 placed+=1;
                 /*std::string buf1 = std::to_string(placed);
                 buf1.append("/");
                 buf1.append(std::to_string(num_of_kb));*/
                 inPlace[unKilobotID]=1;
-                /*send(serverSocket, buf1.c_str(), buf1.size() + 1, 0);
+                /*GetNetwork().Send(buf1.c_str(), buf1.size() + 1);
                 std::cout<<buf1<<std::endl;*/
             }
 //-----------------------------------------------------------------------------------------------------------------------------------------------
@@ -218,7 +202,7 @@ void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
         //buf = multiArea[max_index].RGBcolor;                 //use this to send directly the RGB color
         buf = maxs;                                            //use this to send the number of the target area
         std::cout<<"Sending index "<<buf<<std::endl;
-        send(serverSocket, buf.c_str(), buf.size() + 1, 0);            //send the RGB color of the most populated area in client experiment
+        GetNetwork().Send(buf.c_str(), buf.size() + 1);            //send the RGB color of the most populated area in client experiment
         flag1=1;
     }
 }
@@ -268,10 +252,10 @@ void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
         }
         /* Sending the message */
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
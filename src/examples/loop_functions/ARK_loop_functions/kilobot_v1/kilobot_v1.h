@@ -101,6 +101,9 @@ public:
     /** Virtual environment visualization updating */
 
 
+    /** Handle the messages received from the other ALF */
+    void ReceiveNetworkMessages();
+
     /** Get the message to send to a Kilobot according to its position */
     void UpdateKilobotState(CKilobotEntity& c_kilobot_entity);
 
@@ -11,9 +11,7 @@
 #include "kilobot_v2.h"
 
 //SERVER
-char buf[30];
 char bufStore[30];
-int bytesReceived=-1;
 int num_of_areas=1;
 int num_of_kb=25;
 int placed = 0;
@@ -21,8 +19,6 @@ std::vector<bool> inPlace;
 std::vector<bool> filledArea;
 std::vector<int> contained;
 bool flag1 = 0;
-int clientSocket;
-int serverSocket; //socket for client-server communication
 int target_index;
 
 
@@ -42,40 +38,11 @@ void CClusteringALF::Init(TConfigurationNode& t_node) {
     m_cOutput.open(m_strOutputFileName, std::ios_base::trunc | std::ios_base::out);
 
 //----------------------------------------------OPEN PORT-------------------------------------------------------------------------------------
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket == -1)
-    {
-        std::cout << "Can't create a socket! Quitting" << std::endl;
-    }
-    int port = 54000;
     filledArea = std::vector<bool>(6,0);
     inPlace = std::vector<bool>(25,0); //vector with 1 corresponding to KBs that stopped moving (they are inside an area)
     contained = std::vector<int>(6,0);
     memset(bufStore, 0, 30);
-    std::string ipAddress = "0.0.0.0";
-    sockaddr_in hint;
-    hint.sin_family = AF_INET;
-    hint.sin_port = htons(port);
-    inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
-    bind(serverSocket, (sockaddr*)&hint, sizeof(hint));
-    listen(serverSocket, SOMAXCONN);
-    sockaddr_in client;
-    socklen_t clientSize = sizeof(client);
-    clientSocket = accept(serverSocket, (sockaddr*)&client, &clientSize);
-    char host[NI_MAXHOST];      // Client's remote name
-    char service[NI_MAXSERV];   // Service (i.e. port) the client is connect on
-    memset(host, 0, NI_MAXHOST); // same as memset(host, 0, NI_MAXHOST);
-    memset(service, 0, NI_MAXSERV);
-    if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0)
-    {
-        std::cout << host << " connected on port " << service << std::endl;
-    }
-    else
-    {
-        inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-        std::cout << host << " connected on port " << ntohs(client.sin_port) << std::endl;
-    }
-    close(serverSocket);
+    GetNetwork().Listen(54000);                            //the client is accepted without blocking, during the steps
 //--------------------------------------------------------------------------------------------------------------------------------------------
 }
 
@@ -91,7 +58,7 @@ void CClusteringALF::Reset() {
 void CClusteringALF::Destroy() {
     /* Close data file */
     m_cOutput.close();
-    close(clientSocket);
+    GetNetwork().Close();
 }
 
 
@@ -153,6 +120,17 @@ void CClusteringALF::GetExperimentVariables(TConfigurationNode& t_tree){
 }
 
 
+void CClusteringALF::ReceiveNetworkMessages(){
+    /* Listen to the client, once per step */
+    CALFNetwork::SFrame sFrame;
+    while(GetNetwork().Receive(sFrame)){
+        memcpy(bufStore, sFrame.Data, Min<UInt32>(sFrame.Size, 6));
+        std::cout<<"String received: "<<bufStore<<std::endl;
+        std::cout<<"First char received: "<<((int)bufStore[0]-48)<<std::endl;  //ASCII conversion
+    }
+}
+
+
 void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
     /* Update the state of the kilobot (inside or outside the clustering hub)*/
     UInt16 unKilobotID=GetKilobotId(c_kilobot_entity);
@@ -166,29 +144,10 @@ void CClusteringALF::UpdateKilobotState(CKilobotEntity &c_kilobot_entity){
                 inPlace[unKilobotID]=1;
                 std::string buf = std::to_string(placed);
                 std::cout<<"sending number of kilobots on target: "<<buf<<std::endl;
-                send(clientSocket, buf.c_str(), buf.size() + 1, 0);
+                GetNetwork().Send(buf.c_str(), buf.size() + 1);
             }
         }
     }
-    memset(buf, 0, 30);
-    bytesReceived = recv(clientSocket, buf, 30, MSG_DONTWAIT);
-    if (bytesReceived == -1){
-        //std::cout << "received -1 char" << std::endl;
-    }
-    else if(bytesReceived == 0){
-        //std::cout << "received 0 char" << std::endl;
-    }
-    else 
-    {
-        bufStore[0]=buf[0];
-        bufStore[1]=buf[1];
-        bufStore[2]=buf[2];
-        bufStore[3]=buf[3];
-        bufStore[4]=buf[4];
-        bufStore[5]=buf[5];
-        std::cout<<"String received: "<<bufStore<<std::endl;
-        std::cout<<"First char received: "<<((int)bufStore[0]-48)<<std::endl;  //ASCII conversion
-    }
 }
 
 
@@ -249,10 +208,10 @@ void CClusteringALF::UpdateVirtualSensor(CKilobotEntity &c_kilobot_entity){
             m_tMessages[unKilobotID].data[2+i*3] = tMessage.m_sData;
         }
         /* Sending the message */
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
+        SendOHCMessageTo(c_kilobot_entity,&m_tMessages[unKilobotID]);
     }
     else{
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,NULL);
+        SendOHCMessageTo(c_kilobot_entity,NULL);
     }
 }
 
@@ -69,6 +69,15 @@ void CNavigationALF::SetupInitialKilobotStates() {
     
     GreedyAssociation(m_vecKilobotsPositions, m_vecDesInitKilobotPosition);
 
+    /* Index the desired positions with the distance thresholds of GoToWithOrientation() */
+    GetAreaIndex().Clear();
+    m_vecArrivalAreas.resize(m_vecDesInitKilobotPosition.size());
+    m_vecPushedAreas.resize(m_vecDesInitKilobotPosition.size());
+    for(size_t i=0;i<m_vecDesInitKilobotPosition.size();i++){
+        m_vecArrivalAreas[i] = GetAreaIndex().AddCircle(m_vecDesInitKilobotPosition[i], sqrt(kDistThreshold));
+        m_vecPushedAreas[i] = GetAreaIndex().AddCircle(m_vecDesInitKilobotPosition[i], sqrt(kDistThreshold + kDistPushed));
+    }
+
 
     // message_t m_tArkBroadcastMessage;// = new message_t();
     // /* Prepare the inividual kilobot's message */
@@ -76,7 +85,7 @@ void CNavigationALF::SetupInitialKilobotStates() {
     // /* Fill up the ARK message */
     // m_tArkBroadcastMessage.data[0] = (UInt8)(crw_exponent*100); 
     // m_tArkBroadcastMessage.data[1] = (UInt8)(levy_exponent*100); 
-    // GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(m_tKilobotEntities,&m_tArkBroadcastMessage);
+    // GetKilobotMedium().SendOHCMessageTo(m_tKilobotEntities,&m_tArkBroadcastMessage);
 }
 
 /****************************************/
@@ -143,6 +152,7 @@ void CNavigationALF::SetupInitialKilobotState(CKilobotEntity &c_kilobot_entity){
     temp_area2.Radius = 0.05;
     temp_area2.Color = CColor::GREEN;
     m_TargetAreas.push_back(temp_area2);
+    GetFloorRaster().AddCircle(temp_area2.Center, temp_area2.Radius, temp_area2.Color);
 }
 
 /****************************************/
@@ -183,6 +193,9 @@ void CNavigationALF::SetupVirtualEnvironments(TConfigurationNode& t_tree){
     GetNodeAttribute(t_VirtualClusteringHubNode, "position", m_sClusteringHub.Center);
     GetNodeAttribute(t_VirtualClusteringHubNode, "radius", m_sClusteringHub.Radius);
     GetNodeAttribute(t_VirtualClusteringHubNode, "color", m_sClusteringHub.Color);
+    /* The hub is drawn over the target areas */
+    EnableFloorRaster(0.005);
+    GetFloorRaster().AddCircle(m_sClusteringHub.Center, m_sClusteringHub.Radius, m_sClusteringHub.Color, 1);
 
     
 }
@@ -367,7 +380,7 @@ void CNavigationALF::GoToWithOrientation(CKilobotEntity &c_kilobot_entity)
 
     if (!v_arrivedInPosition[unKilobotID])
     {
-        if(SquareDistance(init_d_position , kiloPos) <= kDistThreshold) 
+        if(GetAreaIndex().Contains(m_vecArrivalAreas[index_vector[unKilobotID].second], kiloPos))
         {            
             /*Following 2 lines if no initial orientation considered*/
             // cmd = STOP;
@@ -410,7 +423,7 @@ void CNavigationALF::GoToWithOrientation(CKilobotEntity &c_kilobot_entity)
     //if the kilobot for some reason is moved from goal position...
     else
     {
-        if(SquareDistance(init_d_position , kiloPos) > kDistThreshold + kDistPushed)
+        if(!GetAreaIndex().Contains(m_vecPushedAreas[index_vector[unKilobotID].second], kiloPos))
         {
             v_arrivedInPosition[unKilobotID] = false;
         }
@@ -453,31 +466,10 @@ void CNavigationALF::GoToWithOrientation(CKilobotEntity &c_kilobot_entity)
     {
         m_vecCommandLog[unKilobotID] = cmd;
         msg.data[0] = uint8_t (cmd);
-        GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm").SendOHCMessageTo(c_kilobot_entity,&msg);    
+        SendOHCMessageTo(c_kilobot_entity,&msg);    
     }
     
 }
 /****************************************/
 /****************************************/
-CColor CNavigationALF::GetFloorColor(const CVector2 &vec_position_on_plane) {
-    CColor cColor=CColor::WHITE;
-
-    for(auto m_target: m_TargetAreas)
-    {
-        if (SquareDistance(vec_position_on_plane, m_target.Center) < pow(m_target.Radius, 2))
-        {
-            cColor = m_target.Color;
-        }
-    }
-
-    if (SquareDistance(vec_position_on_plane, m_sClusteringHub.Center) < pow(m_sClusteringHub.Radius, 2))
-    {
-        cColor = m_sClusteringHub.Color;
-    }
-    
-    return cColor;
-}
-
-
-
 REGISTER_LOOP_FUNCTIONS(CNavigationALF, "ALF_navigation_loop_function")
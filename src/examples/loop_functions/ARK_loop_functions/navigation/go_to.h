@@ -102,9 +102,6 @@ public:
     /** Print Kilobot Pose */
     void PrintPose(UInt16& unKilobotID, command& cmd);
 
-    /** Used to plot the Virtual environment on the floor */
-    virtual CColor GetFloorColor(const CVector2& vec_position_on_plane);
-
     /** Flag to check if kilobot is arrived in its initial desired position */
     std::vector<bool>  v_arrivedInPosition;
     std::vector<bool>  v_arrivedInOrientation;
@@ -152,6 +149,9 @@ private:
     std::vector<CRadians> m_vecKilobotsOrientations;
     std::vector<CVector2> m_vecDesInitKilobotPosition;
     std::vector<CRadians> m_vecDesInitKilobotOrientation;
+    /* ids in the area index of the circles around each desired position: reached, and pushed away from */
+    std::vector<UInt32> m_vecArrivalAreas;
+    std::vector<UInt32> m_vecPushedAreas;
     std::vector<command> m_vecCommandLog;
     
     /** Structure to contain data to evaluate first passage time and
@@ -15,7 +15,9 @@ namespace argos {
    /****************************************/
    /****************************************/
 
-   CCI_KilobotCommunicationActuator::CCI_KilobotCommunicationActuator() {
+   CCI_KilobotCommunicationActuator::CCI_KilobotCommunicationActuator() :
+      m_ptMessage(NULL),
+      m_fTxPeriod(0.0) {
    }
 
    /****************************************/
@@ -28,6 +30,13 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   void CCI_KilobotCommunicationActuator::SetTxPeriod(Real f_period) {
+      m_fTxPeriod = f_period;
+   }
+
+   /****************************************/
+   /****************************************/
+
 #ifdef ARGOS_WITH_LUA
    void CCI_KilobotCommunicationActuator::CreateLuaState(lua_State* pt_lua_state) {
       // TODO
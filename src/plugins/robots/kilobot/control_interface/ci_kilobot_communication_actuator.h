@@ -31,6 +31,12 @@ namespace argos {
 
       virtual void SetMessage(message_t* pt_msg);
 
+      /**
+       * Sets the time between two transmissions of the message, in seconds.
+       * It matters only if the medium can send a message several times per step.
+       */
+      virtual void SetTxPeriod(Real f_period);
+
 #ifdef ARGOS_WITH_LUA
       virtual void CreateLuaState(lua_State* pt_lua_state);
 #endif
@@ -38,6 +44,7 @@ namespace argos {
    protected:
 
       message_t* m_ptMessage;
+      Real m_fTxPeriod;
 
    };
 
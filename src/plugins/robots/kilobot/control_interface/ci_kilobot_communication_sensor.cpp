@@ -16,7 +16,8 @@ namespace argos {
    /****************************************/
 
    CCI_KilobotCommunicationSensor::CCI_KilobotCommunicationSensor() :
-      m_bMessageSent(false) {
+      m_bMessageSent(false),
+      m_unMessagesSent(0) {
    }
 
    /****************************************/
@@ -36,6 +37,13 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   UInt32 CCI_KilobotCommunicationSensor::GetMessagesSent() const {
+      return m_unMessagesSent;
+   }
+
+   /****************************************/
+   /****************************************/
+
 #ifdef ARGOS_WITH_LUA
    void CCI_KilobotCommunicationSensor::CreateLuaState(lua_State* pt_lua_state) {
       // TODO
@@ -29,6 +29,8 @@ namespace argos {
       struct SPacket {
          const message_t* Message;
          distance_measurement_t Distance;
+         /** Time into the last step at which the message arrived, in seconds */
+         Real Time;
       };
 
       typedef std::vector<SPacket> TPackets;
@@ -42,6 +44,11 @@ namespace argos {
 
       bool MessageSent() const;
 
+      /**
+       * Returns how many times the message was sent in the last step.
+       */
+      UInt32 GetMessagesSent() const;
+
 #ifdef ARGOS_WITH_LUA
       virtual void CreateLuaState(lua_State* pt_lua_state);
 
@@ -52,6 +59,7 @@ namespace argos {
 
       TPackets m_tPackets;
       bool m_bMessageSent;
+      UInt32 m_unMessagesSent;
 
    };
 
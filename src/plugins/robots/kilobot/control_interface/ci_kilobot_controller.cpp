@@ -1,8 +1,19 @@
 #include "ci_kilobot_controller.h"
+#include "kilobot_arena.h"
+#include "kilobot_batch_scheduler.h"
 #include <argos3/core/utility/logging/argos_log.h>
 #include <argos3/core/simulator/physics_engine/physics_engine.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_measures.h>
 
+/* Debug builds use AddressSanitizer, whose globals a behavior restart would overwrite */
+#if defined(__SANITIZE_ADDRESS__)
+#define KILOBOT_ADDRESS_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define KILOBOT_ADDRESS_SANITIZER
+#endif
+#endif
+
 /****************************************/
 /****************************************/
 
@@ -14,9 +25,16 @@ CCI_KilobotController::CCI_KilobotController() :
     m_pcCommA(NULL),
     m_pcCommS(NULL),
     m_pcRNG(NULL),
-    m_nSharedMemFD(-1),
+    m_unArenaSlot(0),
     m_nDebugInfoFD(-1),
     m_tBehaviorPID(-1),
+    m_eExecutionMode(EXECUTION_FORK),
+    m_pBehaviorModule(NULL),
+    m_pfModuleInit(NULL),
+    m_pfModuleStep(NULL),
+    m_pfModuleDestroy(NULL),
+    m_bReuseBehavior(false),
+    m_unModuleStackSize(256 * 1024),
     m_fLinearVelocity(1),
     m_fAngularVelocity(45){}
 
@@ -47,31 +65,43 @@ void CCI_KilobotController::Init(TConfigurationNode& t_tree) {
         GetNodeAttribute(t_tree, "behavior", m_strBehaviorFName);
         GetNodeAttributeOrDefault(t_tree, "linearvelocity", m_fLinearVelocity,m_fLinearVelocity);
         GetNodeAttributeOrDefault(t_tree, "angularvelocity", m_fAngularVelocity,m_fAngularVelocity);
+        GetNodeAttributeOrDefault(t_tree, "reuse", m_bReuseBehavior, m_bReuseBehavior);
+        std::string strMode = "fork";
+        GetNodeAttributeOrDefault(t_tree, "mode", strMode, strMode);
+        if(strMode == "fork") {
+            m_eExecutionMode = EXECUTION_FORK;
+        }
+        else if(strMode == "batch") {
+            m_eExecutionMode = EXECUTION_BATCH;
+        }
+        else if(strMode == "inprocess") {
+            m_eExecutionMode = EXECUTION_INPROCESS;
+            GetNodeAttributeOrDefault(t_tree, "stacksize", m_unModuleStackSize, m_unModuleStackSize);
+        }
+        else {
+            THROW_ARGOSEXCEPTION("Unknown execution mode \"" << strMode << "\", allowed values are \"fork\", \"batch\" and \"inprocess\"");
+        }
+#ifdef KILOBOT_ADDRESS_SANITIZER
+        if(m_bReuseBehavior && m_eExecutionMode != EXECUTION_INPROCESS) {
+            THROW_ARGOSEXCEPTION("Reusing the behavior process is not supported in builds with AddressSanitizer, set reuse=\"false\"");
+        }
+#endif
         /* Make sure script file exists */
         int nBehaviorFD = open(m_strBehaviorFName.c_str(), O_RDONLY);
         if(nBehaviorFD < 0) {
             THROW_ARGOSEXCEPTION("Opening behavior file \"" << m_strBehaviorFName << "\": " << strerror(errno));
         }
         close(nBehaviorFD);
-        /* Create shared memory area for master-slave communication */
-        m_nSharedMemFD = ::shm_open(("/" + ToString<pid_t>(getpid()) + "_" + GetId()).c_str(),
-                                    O_RDWR | O_CREAT,
-                                    S_IRUSR | S_IWUSR);
-        if(m_nSharedMemFD < 0) {
-            THROW_ARGOSEXCEPTION("Creating a shared memory area for " << GetId() << ": " << ::strerror(errno));
-        }
-        /* Resize shared memory area to contain the robot state */
-        ::ftruncate(m_nSharedMemFD, sizeof(kilobot_state_t));
-        /* Get pointer to shared memory area */
-        m_ptRobotState = reinterpret_cast<kilobot_state_t*>(
-                    ::mmap(NULL,
-                           sizeof(kilobot_state_t),
-                           PROT_READ | PROT_WRITE,
-                           MAP_SHARED,
-                           m_nSharedMemFD,
-                           0));
-        if(m_ptRobotState == MAP_FAILED) {
-            THROW_ARGOSEXCEPTION("Mmapping the shared memory area of " << GetId() << ": " << ::strerror(errno));
+        /* Get a slot for the robot state in the shared arena */
+        m_unArenaSlot = CKilobotArena::GetInstance().AcquireSlot();
+        m_ptRobotState = CKilobotArena::GetInstance().GetSlot(m_unArenaSlot);
+        if(m_eExecutionMode == EXECUTION_INPROCESS) {
+            LoadBehaviorModule();
+            return;
+        }
+        /* Join the batch before the behavior looks for the step barrier */
+        if(m_eExecutionMode == EXECUTION_BATCH) {
+            CKilobotBatchScheduler::GetInstance().Register(*this);
         }
         /* Create behavior */
         CreateBehavior();
@@ -84,13 +114,45 @@ void CCI_KilobotController::Init(TConfigurationNode& t_tree) {
 /****************************************/
 /****************************************/
 
+int CCI_KilobotController::GetSharedMemFD() const {
+    return CKilobotArena::GetInstance().GetFD();
+}
+
+/****************************************/
+/****************************************/
+
 void CCI_KilobotController::ControlStep() {
+    WriteRobotState();
+    if(m_eExecutionMode == EXECUTION_BATCH) {
+        /* The scheduler sets the actuators when the whole batch is done */
+        CKilobotBatchScheduler::GetInstance().Step(*this);
+        return;
+    }
+    if(m_eExecutionMode == EXECUTION_INPROCESS) {
+        /* Execute one step of the behavior */
+        m_pfModuleStep();
+    }
+    else {
+        /* Resume process */
+        ::kill(m_tBehaviorPID, SIGCONT);
+        /* Wait for behavior to be done */
+        ::waitpid(m_tBehaviorPID, NULL, WUNTRACED);
+    }
+    ReadRobotState();
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::WriteRobotState() {
     /* Set light reading */
     if(m_pcLight)
         m_ptRobotState->ambientlight = m_pcLight->GetReading();
     /* Set received message */
     if(m_pcCommS) {
         if(!m_pcCommS->GetPackets().empty()) {
+            /* The medium keeps at most KILOBOT_MAX_RX messages; the message of the
+               overhead controller comes first and may push out the last one */
             m_ptRobotState->rx_state = Min<UInt8>(m_pcCommS->GetPackets().size(), KILOBOT_MAX_RX);
             for(size_t i = 0; i < m_ptRobotState->rx_state; ++i) {
                 ::memcpy(&m_ptRobotState->rx_message[i],
@@ -99,19 +161,23 @@ void CCI_KilobotController::ControlStep() {
                 ::memcpy(&m_ptRobotState->rx_distance[i],
                          &m_pcCommS->GetPackets()[i].Distance,
                          sizeof(distance_measurement_t));
+                m_ptRobotState->rx_time[i] = m_pcCommS->GetPackets()[i].Time * 1000.0 + 0.5;
             }
         }
         /* Was last message sent? */
         if(m_pcCommS->MessageSent()) {
             m_ptRobotState->tx_state = 2;
+            m_ptRobotState->tx_count = Min<UInt32>(m_pcCommS->GetMessagesSent(), 255);
         }
     }
     // TODO m_ptRobotState->voltage
     // TODO m_ptRobotState->temperature
-    /* Resume process */
-    ::kill(m_tBehaviorPID, SIGCONT);
-    /* Wait for behavior to be done */
-    ::waitpid(m_tBehaviorPID, NULL, WUNTRACED);
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::ReadRobotState() {
     /* Set actuator values */
     // TODO set proper conversion factors
     if((m_ptRobotState->right_motor!=0)&&(m_ptRobotState->left_motor!=0)){
@@ -138,6 +204,7 @@ void CCI_KilobotController::ControlStep() {
     }
     /* Set message to send */
     if(m_pcCommA && m_ptRobotState->tx_state == 1) {
+        m_pcCommA->SetTxPeriod(m_ptRobotState->tx_period / 1000.0);
         m_pcCommA->SetMessage(&m_ptRobotState->tx_message);
     }
 }
@@ -146,6 +213,28 @@ void CCI_KilobotController::ControlStep() {
 /****************************************/
 
 void CCI_KilobotController::Reset() {
+    if(m_eExecutionMode == EXECUTION_INPROCESS) {
+        /* Reload a fresh copy of the module */
+        UnloadBehaviorModule();
+        LoadBehaviorModule();
+        return;
+    }
+    if(m_bReuseBehavior) {
+        /*
+         * Ask the running process to restart: it restores its globals,
+         * re-seeds rand_hard() and executes setup() as soon as it is resumed
+         */
+        ::memset(m_ptRobotState, 0, sizeof(kilobot_state_t));
+        kilobot_control_t* ptControl = CKilobotArena::GetInstance().GetControl(m_unArenaSlot);
+        ptControl->seed = m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL));
+        ptControl->command = KILOBOT_COMMAND_RESET;
+        if(m_eExecutionMode == EXECUTION_FORK) {
+            ::kill(m_tBehaviorPID, SIGCONT);
+            ::waitpid(m_tBehaviorPID, NULL, WUNTRACED);
+        }
+        /* In batch mode, the restart is part of the next step, which still executes loop() */
+        return;
+    }
     /* Kill kilobot process */
     ::kill(m_tBehaviorPID, SIGTERM);
     int nStatus;
@@ -176,12 +265,19 @@ void CCI_KilobotController::CreateBehavior() {
     /* Execute the behavior */
     if(m_tBehaviorPID == 0) {
         /* Child process */
+        std::string strPID  = ToString(tParentPID);
+        std::string strTick = ToString(CPhysicsEngine::GetSimulationClockTick());
+        std::string strSeed = ToString(m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL)));
+        std::string strSlot = ToString(m_unArenaSlot);
+        std::string strStep = ToString(CKilobotBatchScheduler::GetInstance().GetStep());
         ::execl(m_strBehaviorFName.c_str(),
                 m_strBehaviorFName.c_str(),                                          // Script name
-                ToString(tParentPID).c_str(),                                        // The parent process' PID
+                strPID.c_str(),                                                      // The parent process' PID
                 GetId().c_str(),                                                     // Robot id
-                ToString(CPhysicsEngine::GetSimulationClockTick()).c_str(),          // Control step duration in sec
-                ToString(m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL))).c_str(), // Random seed for rand_hard()
+                strTick.c_str(),                                                     // Control step duration in sec
+                strSeed.c_str(),                                                     // Random seed for rand_hard()
+                strSlot.c_str(),                                                     // Slot of the robot state in the arena
+                m_eExecutionMode == EXECUTION_BATCH ? strStep.c_str() : NULL,        // Last step of the batch
                 NULL
                 );
         /* If the next line is executed, it's because execl did not succeed */
@@ -194,14 +290,100 @@ void CCI_KilobotController::CreateBehavior() {
 /****************************************/
 
 void CCI_KilobotController::DestroyBehavior() {
-    ::kill(m_tBehaviorPID, SIGTERM);
-    ::kill(m_tBehaviorPID, SIGCONT);
-    int nStatus;
-    ::waitpid(m_tBehaviorPID, &nStatus, WIFEXITED(nStatus));
-    munmap(m_ptRobotState, sizeof(kilobot_state_t));
-    close(m_nSharedMemFD);
-    pid_t tParentPID = getpid();
-    ::shm_unlink(("/" + ToString<pid_t>(tParentPID) + "_" + GetId()).c_str());
+    if(m_eExecutionMode == EXECUTION_INPROCESS) {
+        UnloadBehaviorModule();
+    }
+    else {
+        if(m_eExecutionMode == EXECUTION_BATCH) {
+            CKilobotBatchScheduler::GetInstance().Unregister(*this);
+        }
+        ::kill(m_tBehaviorPID, SIGTERM);
+        ::kill(m_tBehaviorPID, SIGCONT);
+        int nStatus;
+        ::waitpid(m_tBehaviorPID, &nStatus, WIFEXITED(nStatus));
+    }
+    CKilobotArena::GetInstance().ReleaseSlot(m_unArenaSlot);
+    m_ptRobotState = NULL;
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::LoadBehaviorModule() {
+    /*
+     * The dynamic loader shares a library among all the dlopen() calls
+     * of the same file, and with it its global variables. To give every
+     * robot its own globals, the module is copied into a temporary file
+     * that is loaded and unlinked right away.
+     */
+    std::string strCopy = "/tmp/argos_kilobot_" + ToString<pid_t>(getpid()) + "_" + GetId() + "_XXXXXX";
+    std::vector<char> vecCopy(strCopy.begin(), strCopy.end());
+    vecCopy.push_back(0);
+    int nCopyFD = ::mkstemp(&vecCopy[0]);
+    if(nCopyFD < 0) {
+        THROW_ARGOSEXCEPTION("Creating a copy of behavior module \"" << m_strBehaviorFName << "\" for " << GetId() << ": " << ::strerror(errno));
+    }
+    int nBehaviorFD = ::open(m_strBehaviorFName.c_str(), O_RDONLY);
+    if(nBehaviorFD < 0) {
+        ::close(nCopyFD);
+        ::unlink(&vecCopy[0]);
+        THROW_ARGOSEXCEPTION("Opening behavior file \"" << m_strBehaviorFName << "\": " << ::strerror(errno));
+    }
+    char pchBuffer[65536];
+    ssize_t nRead;
+    bool bCopied = true;
+    while((nRead = ::read(nBehaviorFD, pchBuffer, sizeof(pchBuffer))) > 0) {
+        if(::write(nCopyFD, pchBuffer, nRead) != nRead) {
+            bCopied = false;
+            break;
+        }
+    }
+    if(nRead < 0) bCopied = false;
+    ::close(nBehaviorFD);
+    ::close(nCopyFD);
+    if(!bCopied) {
+        ::unlink(&vecCopy[0]);
+        THROW_ARGOSEXCEPTION("Copying behavior module \"" << m_strBehaviorFName << "\" for " << GetId() << ": " << ::strerror(errno));
+    }
+    /* Load the copy; the mapping outlives the file */
+    m_pBehaviorModule = ::dlopen(&vecCopy[0], RTLD_NOW | RTLD_LOCAL);
+    ::unlink(&vecCopy[0]);
+    if(m_pBehaviorModule == NULL) {
+        THROW_ARGOSEXCEPTION("Loading behavior module \"" << m_strBehaviorFName << "\" for " << GetId() << ": " << ::dlerror());
+    }
+    m_pfModuleInit    = reinterpret_cast<TModuleInit   >(::dlsym(m_pBehaviorModule, "kilo_module_init"   ));
+    m_pfModuleStep    = reinterpret_cast<TModuleStep   >(::dlsym(m_pBehaviorModule, "kilo_module_step"   ));
+    m_pfModuleDestroy = reinterpret_cast<TModuleDestroy>(::dlsym(m_pBehaviorModule, "kilo_module_destroy"));
+    if(m_pfModuleInit == NULL || m_pfModuleStep == NULL || m_pfModuleDestroy == NULL) {
+        ::dlclose(m_pBehaviorModule);
+        m_pBehaviorModule = NULL;
+        THROW_ARGOSEXCEPTION("Behavior module \"" << m_strBehaviorFName << "\" was not linked against the in-process kilolib");
+    }
+    /* Zero the robot state and execute setup() */
+    ::memset(m_ptRobotState, 0, sizeof(kilobot_state_t));
+    if(m_pfModuleInit(m_ptRobotState,
+                      GetId().c_str(),
+                      CPhysicsEngine::GetSimulationClockTick(),
+                      m_pcRNG->Uniform(CRange<UInt32>(0, 0xFFFFFFFFUL)),
+                      m_unModuleStackSize) < 0) {
+        int nError = errno;
+        ::dlclose(m_pBehaviorModule);
+        m_pBehaviorModule = NULL;
+        THROW_ARGOSEXCEPTION("Allocating the behavior stack of " << GetId() << ": " << ::strerror(nError));
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CCI_KilobotController::UnloadBehaviorModule() {
+    if(m_pBehaviorModule == NULL) return;
+    m_pfModuleDestroy();
+    ::dlclose(m_pBehaviorModule);
+    m_pBehaviorModule = NULL;
+    m_pfModuleInit = NULL;
+    m_pfModuleStep = NULL;
+    m_pfModuleDestroy = NULL;
 }
 
 /****************************************/
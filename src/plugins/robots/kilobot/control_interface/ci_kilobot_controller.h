@@ -28,6 +28,7 @@
 #include <cerrno>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dlfcn.h>
 
 using namespace argos;
 
@@ -35,6 +36,22 @@ class CCI_KilobotController : public CCI_Controller {
 
 public:
 
+   /**
+    * How the behavior is executed.
+    * With EXECUTION_FORK, every robot runs its behavior executable in a
+    * separate process, resumed by a signal at every control step.
+    * With EXECUTION_BATCH, the behavior processes of all the robots are
+    * resumed together by CKilobotBatchScheduler and run in parallel.
+    * With EXECUTION_INPROCESS, the behavior is a shared object compiled
+    * against kilolib with KILOLIB_MODULE, and it is executed directly
+    * in the ARGoS process on a stack of its own.
+    */
+   enum EExecutionMode {
+      EXECUTION_FORK = 0,
+      EXECUTION_BATCH,
+      EXECUTION_INPROCESS
+   };
+
    CCI_KilobotController();
    virtual ~CCI_KilobotController() {}
 
@@ -46,8 +63,10 @@ public:
 
    virtual void Destroy();
 
-   int GetSharedMemFD() const {
-      return m_nSharedMemFD;
+   int GetSharedMemFD() const;
+
+   UInt32 GetArenaSlot() const {
+      return m_unArenaSlot;
    }
 
    pid_t GetBehaviorPID() const {
@@ -58,6 +77,10 @@ public:
       return m_ptRobotState;
    }
 
+   EExecutionMode GetExecutionMode() const {
+      return m_eExecutionMode;
+   }
+
    template<class S> S* DebugInfoCreate() {
       /* Open shared file */
       m_nDebugInfoFD =
@@ -102,7 +125,27 @@ protected:
 
 private:
 
-   /** Pointer to the shared memory area */
+   friend class CKilobotBatchScheduler;
+
+   /** Copies the sensor readings into the robot state */
+   void WriteRobotState();
+
+   /** Sets the actuators from the robot state */
+   void ReadRobotState();
+
+   /** Loads a private copy of the behavior module and calls its setup() */
+   void LoadBehaviorModule();
+
+   /** Unloads the behavior module */
+   void UnloadBehaviorModule();
+
+private:
+
+   typedef int  (*TModuleInit)(kilobot_state_t*, const char*, float, uint32_t, size_t);
+   typedef void (*TModuleStep)();
+   typedef void (*TModuleDestroy)();
+
+   /** Pointer to the robot state, in the shared arena */
    kilobot_state_t* m_ptRobotState;
 
    /** Pointer to the motor actuator */
@@ -123,8 +166,8 @@ private:
    /** The random number generator */
    CRandom::CRNG* m_pcRNG;
 
-   /** File descriptor for shared memory area */
-   int m_nSharedMemFD;
+   /** Slot of the robot state in the shared arena */
+   UInt32 m_unArenaSlot;
 
    /** File descriptor for debug info */
    int m_nDebugInfoFD;
@@ -132,6 +175,23 @@ private:
    /** PID of the process executing the behavior */
    pid_t m_tBehaviorPID;
 
+   /** How the behavior is executed */
+   EExecutionMode m_eExecutionMode;
+
+   /** Handle of the behavior module, in in-process mode */
+   void* m_pBehaviorModule;
+
+   /** Entry points of the behavior module, in in-process mode */
+   TModuleInit    m_pfModuleInit;
+   TModuleStep    m_pfModuleStep;
+   TModuleDestroy m_pfModuleDestroy;
+
+   /** Whether Reset() restarts the running behavior process instead of forking a new one */
+   bool m_bReuseBehavior;
+
+   /** Stack size of the behavior, in in-process mode */
+   UInt32 m_unModuleStackSize;
+
    /** File name of the behavior to load */
    std::string m_strBehaviorFName;
 
@@ -19,6 +19,13 @@ extern "C" {
 static int debug_info_fd;
 static debug_info_t* debug_info_shm;
 
+/* PID of the ARGoS process, which names the shared memory file */
+#ifdef KILOLIB_MODULE
+#define debug_info_argos_pid() ((long)getpid())
+#else
+#define debug_info_argos_pid() ((long)getppid())
+#endif
+
 void debug_info_destroy() {
    // Unmap the debug info
    munmap(debug_info_shm, sizeof(debug_info_t));
@@ -26,7 +33,7 @@ void debug_info_destroy() {
    close(debug_info_fd);
    // Make file name from robot uid and process id
    char* debug_info_fname;
-   asprintf(&debug_info_fname, "/ARGoS_DEBUG_%ld_%s", (long)getppid(), kilo_str_id);
+   asprintf(&debug_info_fname, "/ARGoS_DEBUG_%ld_%s", debug_info_argos_pid(), kilo_str_id);
    // Unlink shared memory file
    shm_unlink(debug_info_fname);
    // Get rid of file name
@@ -36,7 +43,7 @@ void debug_info_destroy() {
 void debug_info_create() {
    // Make file name from robot uid and process id
    char* debug_info_fname;
-   asprintf(&debug_info_fname, "/ARGoS_DEBUG_%ld_%s", (long)getppid(), kilo_str_id);
+   asprintf(&debug_info_fname, "/ARGoS_DEBUG_%ld_%s", debug_info_argos_pid(), kilo_str_id);
    // Open shared file
    debug_info_fd = shm_open(debug_info_fname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
    // Check for errors
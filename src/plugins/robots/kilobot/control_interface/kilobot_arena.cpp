@@ -0,0 +1,131 @@
+#include "kilobot_arena.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/string_utilities.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace argos;
+
+/****************************************/
+/****************************************/
+
+CKilobotArena& CKilobotArena::GetInstance() {
+   static CKilobotArena cInstance;
+   return cInstance;
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotArena::CKilobotArena() :
+   m_ptArena(NULL),
+   m_nArenaFD(-1),
+   m_unSlots(0),
+   m_unUsedSlots(0) {
+   pthread_mutex_init(&m_tMutex, NULL);
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotArena::~CKilobotArena() {
+   Destroy();
+   pthread_mutex_destroy(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+uint32_t CKilobotArena::AcquireSlot() {
+   pthread_mutex_lock(&m_tMutex);
+   try {
+      if(m_ptArena == NULL) Create();
+   }
+   catch(CARGoSException&) {
+      pthread_mutex_unlock(&m_tMutex);
+      throw;
+   }
+   uint32_t unSlot;
+   if(!m_vecFreeSlots.empty()) {
+      unSlot = m_vecFreeSlots.back();
+      m_vecFreeSlots.pop_back();
+   }
+   else if(m_unSlots < KILOBOT_ARENA_CAPACITY) {
+      unSlot = m_unSlots++;
+   }
+   else {
+      pthread_mutex_unlock(&m_tMutex);
+      THROW_ARGOSEXCEPTION("The kilobot shared arena is full, at most " << KILOBOT_ARENA_CAPACITY << " kilobots are supported");
+   }
+   ++m_unUsedSlots;
+   ::memset(GetSlot(unSlot), 0, KILOBOT_ARENA_SLOT_SIZE);
+   pthread_mutex_unlock(&m_tMutex);
+   return unSlot;
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotArena::ReleaseSlot(uint32_t un_slot) {
+   pthread_mutex_lock(&m_tMutex);
+   m_vecFreeSlots.push_back(un_slot);
+   if(--m_unUsedSlots == 0) Destroy();
+   pthread_mutex_unlock(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotArena::Create() {
+   m_strArenaFName = "/" + ToString<pid_t>(getpid()) + "_kilobots";
+   m_nArenaFD = ::shm_open(m_strArenaFName.c_str(),
+                           O_RDWR | O_CREAT,
+                           S_IRUSR | S_IWUSR);
+   if(m_nArenaFD < 0) {
+      THROW_ARGOSEXCEPTION("Creating the kilobot shared arena: " << ::strerror(errno));
+   }
+   /* The file is sparse: memory is used only by the touched slots */
+   if(::ftruncate(m_nArenaFD, KILOBOT_ARENA_SIZE) < 0) {
+      int nError = errno;
+      ::close(m_nArenaFD);
+      ::shm_unlink(m_strArenaFName.c_str());
+      m_nArenaFD = -1;
+      THROW_ARGOSEXCEPTION("Resizing the kilobot shared arena: " << ::strerror(nError));
+   }
+   void* pArena = ::mmap(NULL,
+                         KILOBOT_ARENA_SIZE,
+                         PROT_READ | PROT_WRITE,
+                         MAP_SHARED,
+                         m_nArenaFD,
+                         0);
+   if(pArena == MAP_FAILED) {
+      int nError = errno;
+      ::close(m_nArenaFD);
+      ::shm_unlink(m_strArenaFName.c_str());
+      m_nArenaFD = -1;
+      THROW_ARGOSEXCEPTION("Mmapping the kilobot shared arena: " << ::strerror(nError));
+   }
+   m_ptArena = reinterpret_cast<kilobot_arena_t*>(pArena);
+   ::memset(m_ptArena, 0, KILOBOT_ARENA_HEADER_SIZE);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotArena::Destroy() {
+   if(m_ptArena == NULL) return;
+   ::munmap(m_ptArena, KILOBOT_ARENA_SIZE);
+   ::close(m_nArenaFD);
+   ::shm_unlink(m_strArenaFName.c_str());
+   m_ptArena = NULL;
+   m_nArenaFD = -1;
+   m_vecFreeSlots.clear();
+   m_unSlots = 0;
+}
+
+/****************************************/
+/****************************************/
@@ -0,0 +1,88 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/control_interface/kilobot_arena.h>
+ *
+ * @brief This file provides the definition of the kilobot shared arena.
+ *
+ * The arena is a single shared memory area holding the state of every
+ * kilobot in contiguous, cache-line aligned slots, plus the step
+ * barrier used in batch mode. It is created when the first robot
+ * acquires a slot and destroyed when the last one releases it. Forked
+ * behaviors map it and find their state through the slot index.
+ */
+
+#ifndef KILOBOT_ARENA_H
+#define KILOBOT_ARENA_H
+
+#include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+class CKilobotArena {
+
+public:
+
+   static CKilobotArena& GetInstance();
+
+   /**
+    * Returns a free slot, zeroed.
+    * The first call creates the arena.
+    */
+   uint32_t AcquireSlot();
+
+   /**
+    * Gives a slot back.
+    * The arena is destroyed when no slot is in use.
+    */
+   void ReleaseSlot(uint32_t un_slot);
+
+   kilobot_state_t* GetSlot(uint32_t un_slot) {
+      return KILOBOT_ARENA_SLOT(m_ptArena, un_slot);
+   }
+
+   kilobot_control_t* GetControl(uint32_t un_slot) {
+      return KILOBOT_ARENA_CONTROL(m_ptArena, un_slot);
+   }
+
+   kilobot_sync_t* GetSync() {
+      return m_ptArena ? &m_ptArena->sync : NULL;
+   }
+
+   int GetFD() const {
+      return m_nArenaFD;
+   }
+
+private:
+
+   CKilobotArena();
+   ~CKilobotArena();
+
+   void Create();
+   void Destroy();
+
+private:
+
+   /** The shared memory area */
+   kilobot_arena_t* m_ptArena;
+
+   /** File descriptor of the shared memory area */
+   int m_nArenaFD;
+
+   /** Name of the shared memory file */
+   std::string m_strArenaFName;
+
+   /** Slots given back, reused before new ones */
+   std::vector<uint32_t> m_vecFreeSlots;
+
+   /** Number of slots ever handed out */
+   uint32_t m_unSlots;
+
+   /** Number of slots in use */
+   uint32_t m_unUsedSlots;
+
+   /** Protects the arena when controllers are created by multiple threads */
+   pthread_mutex_t m_tMutex;
+
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "kilobot_batch_scheduler.h"
+#include "ci_kilobot_controller.h"
+#include "kilobot_arena.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/****************************************/
+/****************************************/
+
+CKilobotBatchScheduler& CKilobotBatchScheduler::GetInstance() {
+   static CKilobotBatchScheduler cInstance;
+   return cInstance;
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotBatchScheduler::CKilobotBatchScheduler() :
+   m_unArrived(0) {
+   pthread_mutex_init(&m_tMutex, NULL);
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotBatchScheduler::~CKilobotBatchScheduler() {
+   pthread_mutex_destroy(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotBatchScheduler::Register(CCI_KilobotController& c_controller) {
+   pthread_mutex_lock(&m_tMutex);
+   m_vecControllers.push_back(&c_controller);
+   pthread_mutex_unlock(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotBatchScheduler::Unregister(CCI_KilobotController& c_controller) {
+   pthread_mutex_lock(&m_tMutex);
+   std::vector<CCI_KilobotController*>::iterator it =
+      std::find(m_vecControllers.begin(), m_vecControllers.end(), &c_controller);
+   if(it != m_vecControllers.end()) {
+      m_vecControllers.erase(it);
+      if(m_vecControllers.empty()) m_unArrived = 0;
+   }
+   pthread_mutex_unlock(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+uint32_t CKilobotBatchScheduler::GetStep() const {
+   kilobot_sync_t* ptSync = CKilobotArena::GetInstance().GetSync();
+   return ptSync ? __atomic_load_n(&ptSync->step, __ATOMIC_ACQUIRE) : 0;
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotBatchScheduler::Step(CCI_KilobotController& c_controller) {
+   pthread_mutex_lock(&m_tMutex);
+   /* Wait for all the controllers to check in */
+   if(++m_unArrived < m_vecControllers.size()) {
+      pthread_mutex_unlock(&m_tMutex);
+      return;
+   }
+   m_unArrived = 0;
+   try {
+      ExecuteStep();
+   }
+   catch(CARGoSException&) {
+      pthread_mutex_unlock(&m_tMutex);
+      throw;
+   }
+   /* Set the actuators of every robot */
+   for(size_t i = 0; i < m_vecControllers.size(); ++i) {
+      m_vecControllers[i]->ReadRobotState();
+   }
+   pthread_mutex_unlock(&m_tMutex);
+}
+
+/****************************************/
+/****************************************/
+
+void CKilobotBatchScheduler::ExecuteStep() {
+   kilobot_sync_t* ptSync = CKilobotArena::GetInstance().GetSync();
+   /* Start the step for all the behaviors */
+   __atomic_store_n(&ptSync->pending, m_vecControllers.size(), __ATOMIC_RELEASE);
+   __atomic_add_fetch(&ptSync->step, 1, __ATOMIC_ACQ_REL);
+   ::syscall(SYS_futex, &ptSync->step, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+   /* Wait for all the behaviors to be done */
+   timespec tTimeout = { 1, 0 };
+   uint32_t unPending;
+   while((unPending = __atomic_load_n(&ptSync->pending, __ATOMIC_ACQUIRE)) > 0) {
+      if(::syscall(SYS_futex, &ptSync->pending, FUTEX_WAIT, unPending, &tTimeout, NULL, 0) < 0 &&
+         errno == ETIMEDOUT) {
+         /* Taking long: make sure no behavior died in the meantime. The dead
+            are left unreaped, for their controller to collect */
+         for(size_t i = 0; i < m_vecControllers.size(); ++i) {
+            siginfo_t tInfo;
+            tInfo.si_pid = 0;
+            if(::waitid(P_PID, m_vecControllers[i]->GetBehaviorPID(), &tInfo,
+                        WEXITED | WNOHANG | WNOWAIT) < 0) {
+               if(errno == EINTR) continue;
+               THROW_ARGOSEXCEPTION("Checking the behavior process of " << m_vecControllers[i]->GetId() << ": " << ::strerror(errno));
+            }
+            if(tInfo.si_pid != 0) {
+               THROW_ARGOSEXCEPTION("The behavior process of " << m_vecControllers[i]->GetId() << " terminated");
+            }
+         }
+      }
+   }
+}
+
+/****************************************/
+/****************************************/
@@ -0,0 +1,72 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/control_interface/kilobot_batch_scheduler.h>
+ *
+ * @brief This file provides the definition of the kilobot batch scheduler.
+ *
+ * The batch scheduler steps all the kilobot controllers in batch mode
+ * together. Every controller writes the sensor readings of its robot
+ * and checks in; when the last one checks in, the scheduler resumes all
+ * the behavior processes at once through the futex barrier in the
+ * kilobot shared arena, waits for all of them to finish, and sets the actuators of
+ * every robot. Behaviors thus run in parallel across cores.
+ */
+
+#ifndef KILOBOT_BATCH_SCHEDULER_H
+#define KILOBOT_BATCH_SCHEDULER_H
+
+class CCI_KilobotController;
+
+#include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
+#include <pthread.h>
+#include <vector>
+
+class CKilobotBatchScheduler {
+
+public:
+
+   static CKilobotBatchScheduler& GetInstance();
+
+   /**
+    * Adds a controller to the batch.
+    */
+   void Register(CCI_KilobotController& c_controller);
+
+   /**
+    * Removes a controller from the batch.
+    */
+   void Unregister(CCI_KilobotController& c_controller);
+
+   /**
+    * Returns the last control step started by the scheduler.
+    * A new behavior must be given this value to wait for the next step.
+    */
+   uint32_t GetStep() const;
+
+   /**
+    * Checks in a controller whose robot state is ready.
+    * The last controller to check in executes the step for the whole batch.
+    */
+   void Step(CCI_KilobotController& c_controller);
+
+private:
+
+   CKilobotBatchScheduler();
+   ~CKilobotBatchScheduler();
+
+   /** Resumes all the behaviors and waits for them to finish */
+   void ExecuteStep();
+
+private:
+
+   /** The controllers in the batch */
+   std::vector<CCI_KilobotController*> m_vecControllers;
+
+   /** Number of controllers that checked in for the current step */
+   size_t m_unArrived;
+
+   /** Protects the scheduler when controllers are stepped by multiple threads */
+   pthread_mutex_t m_tMutex;
+
+};
+
+#endif
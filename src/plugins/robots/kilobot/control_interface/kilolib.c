@@ -8,7 +8,17 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <setjmp.h>
 #include <ctype.h>
+#ifdef KILOLIB_MODULE
+#include <ucontext.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#else
+#include <sched.h>
+#endif
 
 /*
  * Mersenne-Twister-related constants
@@ -87,11 +97,96 @@ static float     kilo_tx_clock     = 0.0f; // message transmission clock in ms
 static float     kilo_delay        = 0.0f; // delay clock in ms
 static uint8_t   kilo_seed         = 0xAA; // default random seed
 static uint8_t   kilo_accumulator  = 0;    // rng accumulator
-static int       kilo_state_fd     = -1;   // shared memory file
+#ifndef KILOLIB_MODULE
+static kilobot_arena_t* kilo_arena = NULL; // shared arena of the swarm
+static kilobot_sync_t* kilo_sync   = NULL; // step barrier, in batch mode
+static uint32_t  kilo_sync_step    = 0;    // last step executed, in batch mode
+static uint8_t   kilo_sync_running = 0;    // whether a step is being executed, in batch mode
+static kilobot_control_t* kilo_control = NULL; // commands from ARGoS
+static char*     kilo_snapshot     = NULL; // global variables when kilo_start() was called
+static jmp_buf*  kilo_restart_point = NULL; // where kilo_start() executes setup()
+/* Global variables of the behavior executable, set by the linker */
+extern char      __data_start[];
+extern char      _end[];
+#else
+static ucontext_t kilo_caller_ctx;         // context of the ARGoS controller
+static ucontext_t kilo_behavior_ctx;       // context of the behavior
+static void*     kilo_stack        = NULL; // stack of the behavior
+static size_t    kilo_stack_size   = 0;    // size of the stack, including guard page
+#endif
 kilobot_state_t* kilo_state        = NULL; // shared robot state
 char*            kilo_str_id       = NULL; // kilobot id as string
 
+#ifndef KILOLIB_MODULE
+/*
+ * Batch mode: signals the end of the current step, if any, and sleeps
+ * until ARGoS starts the next one
+ */
+static void kilo_sync_wait() {
+   if(kilo_sync_running) {
+      kilo_sync_running = 0;
+      if(__sync_sub_and_fetch(&kilo_sync->pending, 1) == 0) {
+#ifdef __linux__
+         syscall(SYS_futex, &kilo_sync->pending, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+      }
+   }
+   while(__atomic_load_n(&kilo_sync->step, __ATOMIC_ACQUIRE) == kilo_sync_step) {
+#ifdef __linux__
+      syscall(SYS_futex, &kilo_sync->step, FUTEX_WAIT, kilo_sync_step, NULL, NULL, 0);
+#else
+      sched_yield();
+#endif
+   }
+   kilo_sync_step = kilo_sync->step;
+   kilo_sync_running = 1;
+}
+#endif
+
+#ifndef KILOLIB_MODULE
+/*
+ * Restarts the behavior as if it had just been forked, restoring all
+ * the global variables of the executable and executing setup() again
+ */
+static void kilo_restart() {
+   /* Keep what must survive the restart */
+   uint32_t seed = kilo_control->seed;
+   uint32_t sync_step = kilo_sync_step;
+   uint8_t sync_running = kilo_sync_running;
+   kilo_control->command = KILOBOT_COMMAND_NONE;
+   /* Restore the globals, including these of kilolib */
+   memcpy(__data_start, kilo_snapshot, _end - __data_start);
+   kilo_sync_step = sync_step;
+   kilo_sync_running = sync_running;
+   mt_setseed(seed);
+   /* Back to kilo_start() */
+   longjmp(*kilo_restart_point, 1);
+}
+#endif
+
+/*
+ * Gives control back to the ARGoS controller until the next control step.
+ * A forked behavior stops its own process with the given signal, or
+ * waits on the step barrier in batch mode, while an in-process behavior
+ * switches back to the stack of the controller.
+ */
+static void kilo_wait(int sig) {
+#ifndef KILOLIB_MODULE
+   if(kilo_sync) kilo_sync_wait();
+   else raise(sig);
+   /* Restart if requested by ARGoS while we were waiting */
+   if(kilo_control->command == KILOBOT_COMMAND_RESET) kilo_restart();
+#else
+   /* swapcontext() also saves and restores the signal mask, which costs
+      an rt_sigprocmask() call on each switch, two per step */
+   swapcontext(&kilo_behavior_ctx, &kilo_caller_ctx);
+#endif
+}
+
 void preloop() {
+   /* Tick count at the start of the step, to timestamp received messages */
+   uint32_t ticks_start = kilo_ticks;
+   float ticks_frac_start = kilo_ticks_frac;
    /* Update tick count */
    kilo_ticks_frac += kilo_ticks_delta;
    kilo_ticks += (uint32_t)kilo_ticks_frac;
@@ -100,17 +195,40 @@ void preloop() {
       /* No message sent */
       kilo_tx_clock += kilo_ms_delta;
    } else {
-      /* Message sent */
+      /* Message sent, possibly more than once during the step */
+      uint8_t n = kilo_state->tx_count > 0 ? kilo_state->tx_count : 1;
       kilo_state->tx_state = 0;
+      kilo_state->tx_count = 0;
       kilo_tx_clock = 0.0f;
-      kilo_message_tx_success();
+      while(n-- > 0) kilo_message_tx_success();
    }
    /* Message received? */
    if(kilo_state->rx_state > 0) {
-      uint8_t i;
+      uint32_t ticks_end = kilo_ticks;
+      uint8_t order[KILOBOT_MAX_RX];
+      uint8_t i, j;
+      /* Replay the messages in arrival order, with kilo_ticks set to the
+         time of arrival */
       for(i = 0; i < kilo_state->rx_state; ++i) {
-         kilo_message_rx(&kilo_state->rx_message[i], &kilo_state->rx_distance[i]);
+         for(j = i; j > 0 && kilo_state->rx_time[order[j-1]] > kilo_state->rx_time[i]; --j) {
+            order[j] = order[j-1];
+         }
+         order[j] = i;
       }
+      for(i = 0; i < kilo_state->rx_state; ++i) {
+         /* Messages stamped with the end of the step see the updated count */
+         if(kilo_state->rx_time[order[i]] >= (uint16_t)kilo_ms_delta) {
+            kilo_ticks = ticks_end;
+         }
+         else {
+            kilo_ticks = ticks_start +
+               (uint32_t)(ticks_frac_start +
+                          kilo_state->rx_time[order[i]] * kilo_ticks_delta / kilo_ms_delta);
+            if(kilo_ticks > ticks_end) kilo_ticks = ticks_end;
+         }
+         kilo_message_rx(&kilo_state->rx_message[order[i]], &kilo_state->rx_distance[order[i]]);
+      }
+      kilo_ticks = ticks_end;
       kilo_state->rx_state = 0;
    }
    kilo_ticks_frac -= (uint32_t)kilo_ticks_frac;
@@ -124,6 +242,7 @@ void postloop() {
       if(msg) {
          /* Attempt to send message */
          kilo_state->tx_state = 1;
+         kilo_state->tx_period = kilo_tx_period;
          memcpy(&kilo_state->tx_message, msg, sizeof(message_t));
       }
    }
@@ -140,8 +259,8 @@ void delay(uint16_t ms) {
    kilo_delay = ms;
    postloop();
    while(kilo_delay > 0.0f) {
-      /* Suspend process, waiting for ARGoS controller's resume signal */
-      raise(SIGTSTP);
+      /* Suspend, waiting for ARGoS controller to resume us */
+      kilo_wait(SIGTSTP);
       /* Update state */
       preloop();
       /* Are we done waiting? */
@@ -200,10 +319,11 @@ void set_color(uint8_t color) {
 void kilo_init() {
 }
 
+#ifndef KILOLIB_MODULE
+
 void cleanup() {
-   munmap(kilo_state, sizeof(kilobot_state_t));
-   close(kilo_state_fd);
-   shm_unlink(kilo_str_id);
+   /* The arena belongs to ARGoS, which unlinks it */
+   munmap(kilo_arena, KILOBOT_ARENA_SIZE);
 }
 
 void sigterm_handler(int s) {
@@ -211,15 +331,48 @@ void sigterm_handler(int s) {
    exit(0);
 }
 
+#endif
+
 void kilo_start(void (*setup)(void), void (*loop)(void)) {
+   /* Whether setup() was executed inside a step, which must then execute
+      loop() too */
+   volatile uint8_t in_step = 0;
+#ifndef KILOLIB_MODULE
    /* Install handler for SIGTERM */
    signal(SIGTERM, sigterm_handler);
+   /* A restart requested before we got here is already satisfied */
+   if(kilo_control->command == KILOBOT_COMMAND_RESET) {
+      kilo_control->command = KILOBOT_COMMAND_NONE;
+      mt_setseed(kilo_control->seed);
+   }
+   /*
+    * Take a snapshot of the globals, to restore them on restart.
+    * Only the globals are restored: memory that setup() allocated on the
+    * heap is not freed, and leaks at each restart. The snapshot also
+    * covers the globals of the AddressSanitizer runtime, which is linked
+    * into the executable, so restarts are refused when ARGoS is built
+    * with it (see CCI_KilobotController::Init()).
+    */
+   kilo_restart_point = (jmp_buf*)malloc(sizeof(jmp_buf));
+   kilo_snapshot = (char*)malloc(_end - __data_start);
+   memcpy(kilo_snapshot, __data_start, _end - __data_start);
+   if(setjmp(*kilo_restart_point)) {
+      /* In batch mode, the restart is executed at the start of a step,
+         while a forked behavior restarts when ARGoS resets it */
+      in_step = kilo_sync_running;
+   }
+#endif
    /* Execute setup() */
    setup();
    /* Continue working until killed by ARGoS controller */
    while(1) {
-      /* Suspend yourself, waiting for ARGoS controller's resume signal */
-      raise(SIGSTOP);
+      if(in_step) {
+         in_step = 0;
+      }
+      else {
+         /* Suspend yourself, waiting for ARGoS controller's resume signal */
+         kilo_wait(SIGSTOP);
+      }
       /* Resumed */
       /* Execute loop */
       preloop();
@@ -241,61 +394,151 @@ static uint16_t argos_id_to_kilo_uid(const char* argos_id) {
    return strtoul(argos_id + pos, NULL, 10);
 }
 
+/* Sets the variables that depend on the robot id, tick length and random seed */
+static void kilo_setup_runtime(const char* robot_id, float tick_length, uint32_t seed) {
+   kilo_str_id = strdup(robot_id);
+   /* Set uid */
+   kilo_uid = argos_id_to_kilo_uid(kilo_str_id);
+   /* Set kilo_ticks delta */
+   kilo_ticks_delta = tick_length * TICKS_PER_SEC;
+   kilo_ms_delta = kilo_ticks_delta / TICKS_PER_SEC * 1000.0;
+   /* Initialize random number generator */
+   mt_rngstate = (int32_t*)malloc(MT_N * sizeof(int32_t));
+   mt_rngidx = MT_N + 1;
+   mt_setseed(seed);
+}
+
+/* The robot state must fit in a slot of the shared arena */
+typedef char kilo_check_slot_size[sizeof(kilobot_slot_t) <= KILOBOT_ARENA_SLOT_SIZE ? 1 : -1];
+typedef char kilo_check_header_size[sizeof(kilobot_arena_t) <= KILOBOT_ARENA_HEADER_SIZE ? 1 : -1];
+
 /* main() wrapper */
 int __kilobot_main(int argc, char* argv[]);
 #undef main
+
+#ifndef KILOLIB_MODULE
+
 int main(int argc, char* argv[]) {
    /* Parse arguments */
-   if(argc != 5) {
+   if(argc != 6 && argc != 7) {
       int i;
       fprintf(stderr, "Error: %s was given %d arguments\n", argv[0], argc);
       for(i = 0; i < argc; ++i) {
          fprintf(stderr, "\tARG %d: %s\n", i, argv[i]);
       }
-      fprintf(stderr, "Usage: <script> <pid> <robot_id> <tick_length> <random_seed>\n");
+      fprintf(stderr, "Usage: <script> <pid> <robot_id> <tick_length> <random_seed> <arena_slot> [<batch_step>]\n");
       exit(1);
    }
-   kilo_str_id = strdup(argv[2]);
-   /* Open shared memory */
-   char* shm_fname = malloc(strlen(argv[1]) + strlen(argv[2]) + 3);
-   shm_fname[0] = '/';
-   shm_fname[1] = 0;
-   strcat(shm_fname, argv[1]);
-   strcat(shm_fname, "_");
-   strcat(shm_fname, argv[2]);
-   kilo_state_fd = shm_open(shm_fname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+   /* Open the shared arena */
+   char* shm_fname = malloc(strlen(argv[1]) + 11);
+   sprintf(shm_fname, "/%s_kilobots", argv[1]);
+   int arena_fd = shm_open(shm_fname, O_RDWR, S_IRUSR | S_IWUSR);
    free(shm_fname);
-   if(kilo_state_fd < 0) {
-      fprintf(stderr, "Opening the shared memory file of %s: %s\n", kilo_str_id, strerror(errno));
+   if(arena_fd < 0) {
+      fprintf(stderr, "Opening the shared memory file of %s: %s\n", argv[2], strerror(errno));
       exit(1);
    }
-   /* Resize shared memory area to contain the robot state, filling it with zeros */
-   ftruncate(kilo_state_fd, sizeof(kilobot_state_t));
    /* Get pointer to shared memory area */
-   kilo_state =
-      (kilobot_state_t*)mmap(NULL,
-                             sizeof(kilobot_state_t),
+   kilo_arena =
+      (kilobot_arena_t*)mmap(NULL,
+                             KILOBOT_ARENA_SIZE,
                              PROT_READ | PROT_WRITE,
                              MAP_SHARED,
-                             kilo_state_fd,
+                             arena_fd,
                              0);
-   if(kilo_state == MAP_FAILED) {
-      fprintf(stderr, "Mmapping the shared memory area of %s: %s\n", kilo_str_id, strerror(errno));
-      close(kilo_state_fd);
-      shm_unlink(kilo_str_id);
+   close(arena_fd);
+   if(kilo_arena == MAP_FAILED) {
+      fprintf(stderr, "Mmapping the shared memory area of %s: %s\n", argv[2], strerror(errno));
       exit(1);
    }
+   kilo_state = KILOBOT_ARENA_SLOT(kilo_arena, strtoul(argv[5], NULL, 10));
+   kilo_control = KILOBOT_ARENA_CONTROL(kilo_arena, strtoul(argv[5], NULL, 10));
+   /* In batch mode, wait on the step barrier shared by all the behaviors */
+   if(argc == 7) {
+      kilo_sync = &kilo_arena->sync;
+      kilo_sync_step = strtoul(argv[6], NULL, 10);
+   }
+   /* Set up kilolib */
+   kilo_setup_runtime(argv[2], strtof(argv[3], NULL), strtoul(argv[4], NULL, 10));
    /* Install cleanup function */
    atexit(cleanup);
-   /* Set uid */
-   kilo_uid = argos_id_to_kilo_uid(kilo_str_id);
-   /* Set kilo_ticks delta */
-   kilo_ticks_delta = (strtof(argv[3], NULL) * TICKS_PER_SEC);
-   kilo_ms_delta = kilo_ticks_delta / TICKS_PER_SEC * 1000.0;
-   /* Initialize random number generator */
-   mt_rngstate = (int32_t*)malloc(MT_N * sizeof(int32_t));
-   mt_rngidx = MT_N + 1;
-   mt_setseed(strtoul(argv[4], NULL, 10));
    /* Call main of behavior */
    return __kilobot_main(argc, argv);
 }
+
+#else
+
+/*
+ * Entry point of the behavior stack
+ */
+static void kilo_module_main() {
+   char* argv[2];
+   argv[0] = kilo_str_id;
+   argv[1] = NULL;
+   __kilobot_main(1, argv);
+   /* The behavior returned without calling kilo_start(): nothing left to do */
+   while(1) kilo_wait(SIGSTOP);
+}
+
+/*
+ * In-process entry points, looked up by CCI_KilobotController with dlsym()
+ */
+int kilo_module_init(kilobot_state_t* state,
+                     const char* robot_id,
+                     float tick_length,
+                     uint32_t seed,
+                     size_t stack_size) {
+   size_t page = sysconf(_SC_PAGESIZE);
+   kilo_state = state;
+   kilo_setup_runtime(robot_id, tick_length, seed);
+   /*
+    * Allocate the behavior stack, with a guard page at the bottom to
+    * turn a stack overflow into a crash rather than memory corruption.
+    * Pages are only backed by memory when touched.
+    */
+   kilo_stack_size = ((stack_size + page - 1) / page + 1) * page;
+   kilo_stack = mmap(NULL,
+                     kilo_stack_size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1,
+                     0);
+   if(kilo_stack == MAP_FAILED) {
+      int error = errno;
+      kilo_stack = NULL;
+      kilo_module_destroy();
+      errno = error;
+      return -1;
+   }
+   if(mprotect(kilo_stack, page, PROT_NONE) != 0) {
+      int error = errno;
+      kilo_module_destroy();
+      errno = error;
+      return -1;
+   }
+   /* Create the behavior context */
+   getcontext(&kilo_behavior_ctx);
+   kilo_behavior_ctx.uc_stack.ss_sp   = kilo_stack;
+   kilo_behavior_ctx.uc_stack.ss_size = kilo_stack_size;
+   kilo_behavior_ctx.uc_link          = NULL;
+   makecontext(&kilo_behavior_ctx, kilo_module_main, 0);
+   /* Run main() and setup(), until the behavior waits for the first step */
+   swapcontext(&kilo_caller_ctx, &kilo_behavior_ctx);
+   return 0;
+}
+
+void kilo_module_step() {
+   /* Resume the behavior where it stopped, in loop() or in delay() */
+   swapcontext(&kilo_caller_ctx, &kilo_behavior_ctx);
+}
+
+void kilo_module_destroy() {
+   if(kilo_stack) munmap(kilo_stack, kilo_stack_size);
+   free(mt_rngstate);
+   free(kilo_str_id);
+   kilo_stack = NULL;
+   mt_rngstate = NULL;
+   kilo_str_id = NULL;
+}
+
+#endif
@@ -32,6 +32,7 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
 #include "message.h"
 #include "message_crc.h"
 
@@ -557,8 +558,11 @@ void kilo_start(void (*setup)(void), void (*loop)(void));
 typedef struct {
    message_t              tx_message;     // the message to send
    uint8_t                tx_state;       // 0 = none, 1 = sending, 2 = sent
+   uint8_t                tx_count;       // # of times the message was sent in the last step
+   uint16_t               tx_period;      // kilo_tx_period when the message was queued
    message_t              rx_message[KILOBOT_MAX_RX];  // the received messages
    distance_measurement_t rx_distance[KILOBOT_MAX_RX]; // distance of message sources
+   uint16_t               rx_time[KILOBOT_MAX_RX];     // ms into the last step at which each message arrived
    uint8_t                rx_state;       // 0 = none, >0 # of received messages
    int16_t                ambientlight;   // used by get_ambientlight()
    int16_t                voltage;        // used by get_voltage()
@@ -568,6 +572,108 @@ typedef struct {
    uint8_t                color;          // used by set_color()
 } kilobot_state_t;
 
+/**
+ * @brief Swarm-wide step barrier, used for communication with ARGoS.
+ *
+ * When the kilobot controllers run in batch mode, all the forked
+ * behaviors share this structure. ARGoS sets @c pending to the number
+ * of behaviors and increments @c step to resume them all at once; each
+ * behavior decrements @c pending when it is done with the step. Both
+ * fields are futex words.
+ *
+ * Do not use this in your own programs.
+ */
+typedef struct {
+   uint32_t step;    // current control step
+   uint32_t pending; // behaviors still executing the current step
+} kilobot_sync_t;
+
+/**
+ * @brief Commands sent by ARGoS to a forked behavior.
+ *
+ * The command is executed as soon as the behavior is resumed.
+ * KILOBOT_COMMAND_RESET restores the global variables of the behavior
+ * to their value when kilo_start() was first called, seeds rand_hard()
+ * with @c seed and executes setup() again, as if the process had just
+ * been started.
+ *
+ * Do not use this in your own programs.
+ */
+#define KILOBOT_COMMAND_NONE  0
+#define KILOBOT_COMMAND_RESET 1
+
+typedef struct {
+   uint32_t command; // one of KILOBOT_COMMAND_*
+   uint32_t seed;    // random seed for rand_hard(), for KILOBOT_COMMAND_RESET
+} kilobot_control_t;
+
+/**
+ * @brief Content of a robot slot in the shared arena.
+ *
+ * Do not use this in your own programs.
+ */
+typedef struct {
+   kilobot_state_t   state;   // sensors and actuators
+   kilobot_control_t control; // command from ARGoS
+} kilobot_slot_t;
+
+/**
+ * Size of the header and of a robot slot in the shared arena.
+ * Slots are cache-line aligned, so two robots never share a line.
+ */
+#define KILOBOT_ARENA_HEADER_SIZE 64
+#define KILOBOT_ARENA_SLOT_SIZE   128
+
+/**
+ * Maximum number of robots in the shared arena. The arena is mapped
+ * once at its full size, but memory is only used by the touched slots.
+ */
+#define KILOBOT_ARENA_CAPACITY    65536
+
+/**
+ * Total size of the shared arena, in bytes.
+ */
+#define KILOBOT_ARENA_SIZE (KILOBOT_ARENA_HEADER_SIZE + KILOBOT_ARENA_CAPACITY * KILOBOT_ARENA_SLOT_SIZE)
+
+/**
+ * @brief Shared arena with the state of every robot.
+ *
+ * ARGoS creates a single shared memory file for the whole swarm,
+ * named /<pid>_kilobots. It starts with this header, followed by
+ * KILOBOT_ARENA_CAPACITY slots of KILOBOT_ARENA_SLOT_SIZE bytes, each
+ * holding the kilobot_slot_t of a robot.
+ *
+ * Do not use this in your own programs.
+ */
+typedef struct {
+   kilobot_sync_t sync; // step barrier, used in batch mode
+} kilobot_arena_t;
+
+/**
+ * Returns the state and the control command of the robot in the given slot of the arena.
+ */
+#define KILOBOT_ARENA_SLOT(ARENA, SLOT) \
+   (&((kilobot_slot_t*)((char*)(ARENA) + KILOBOT_ARENA_HEADER_SIZE + (size_t)(SLOT) * KILOBOT_ARENA_SLOT_SIZE))->state)
+#define KILOBOT_ARENA_CONTROL(ARENA, SLOT) \
+   (&((kilobot_slot_t*)((char*)(ARENA) + KILOBOT_ARENA_HEADER_SIZE + (size_t)(SLOT) * KILOBOT_ARENA_SLOT_SIZE))->control)
+
+/**
+ * @brief Entry points of a behavior compiled as an in-process module.
+ *
+ * When kilolib is compiled with KILOLIB_MODULE defined, the behavior is
+ * built as a shared object that ARGoS loads in its own process, instead
+ * of an executable forked for every robot. Each robot gets its own copy
+ * of the module, so the behavior global variables are not shared.
+ * The behavior runs on its own stack of @p stack_size bytes, switching
+ * back to ARGoS wherever the forked behavior would stop its process,
+ * so delay() blocks the behavior only.
+ *
+ * Do not use these in your own programs.
+ */
+int  kilo_module_init(kilobot_state_t* state, const char* robot_id, float tick_length, uint32_t seed, size_t stack_size);
+void kilo_module_step();
+void kilo_module_destroy();
+
 #ifdef __cplusplus /* If this is a C++ compiler, use C linkage */
 }
 #endif
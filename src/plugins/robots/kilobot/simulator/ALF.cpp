@@ -11,12 +11,46 @@
  */
 
 #include "ALF.h"
+#include <cerrno>
+#include <cstring>
 
 
 
 CALF::CALF():
+    m_pcKilobotMedium(NULL),
     m_fTimeForAMessage(0.05),
-    m_unEnvironmentPlotUpdateFrequency(10){
+    m_unEnvironmentPlotUpdateFrequency(10),
+    m_unThreads(1),
+    m_unChunkSize(32),
+    m_unPhaseCounter(0),
+    m_ePhase(PHASE_KILOBOT_STATES),
+    m_unBusyWorkers(0),
+    m_unStartedWorkers(0),
+    m_unNextChunk(0),
+    m_bQuitWorkers(false),
+    m_bInParallelPhase(false){
+    pthread_key_create(&m_tThreadIndexKey, NULL);
+    pthread_mutex_init(&m_tWorkerMutex, NULL);
+    pthread_cond_init(&m_tWorkerStartCond, NULL);
+    pthread_cond_init(&m_tWorkerDoneCond, NULL);
+}
+
+/****************************************/
+/****************************************/
+
+CALF::~CALF(){
+    /* Stop the worker threads */
+    pthread_mutex_lock(&m_tWorkerMutex);
+    m_bQuitWorkers=true;
+    pthread_cond_broadcast(&m_tWorkerStartCond);
+    pthread_mutex_unlock(&m_tWorkerMutex);
+    for(size_t i=0;i<m_vecWorkers.size();i++){
+        pthread_join(m_vecWorkers[i], NULL);
+    }
+    pthread_cond_destroy(&m_tWorkerDoneCond);
+    pthread_cond_destroy(&m_tWorkerStartCond);
+    pthread_mutex_destroy(&m_tWorkerMutex);
+    pthread_key_delete(m_tThreadIndexKey);
 }
 
 /****************************************/
@@ -25,6 +59,27 @@ CALF::CALF():
 void CALF::Init(TConfigurationNode& t_node) {
     /* Set the tracking type from the .argos file*/
     SetTrackingType(t_node);
+    /* Cover the arena with the grid of the virtual area index */
+    Real fAreaCellSize=0.1;
+    GetNodeAttributeOrDefault(t_node, "area_cell_size", fAreaCellSize, fAreaCellSize);
+    const CVector3& cArenaCenter=GetSpace().GetArenaCenter();
+    const CVector3& cArenaSize=GetSpace().GetArenaSize();
+    m_cAreaIndex.Init(CVector2(cArenaCenter.GetX()-0.5*cArenaSize.GetX(), cArenaCenter.GetY()-0.5*cArenaSize.GetY()),
+                      CVector2(cArenaCenter.GetX()+0.5*cArenaSize.GetX(), cArenaCenter.GetY()+0.5*cArenaSize.GetY()),
+                      fAreaCellSize);
+    /* Set the lockstep mode of the network before the ALF opens it */
+    if(NodeExists(t_node, "lockstep")){
+        TConfigurationNode& tLockstepNode=GetNode(t_node, "lockstep");
+        UInt32 unPeriod=1;
+        UInt32 unPeers=1;
+        UInt32 unRank=0;
+        Real fTimeout=0;
+        GetNodeAttributeOrDefault(tLockstepNode, "period", unPeriod, unPeriod);
+        GetNodeAttributeOrDefault(tLockstepNode, "peers", unPeers, unPeers);
+        GetNodeAttributeOrDefault(tLockstepNode, "rank", unRank, unRank);
+        GetNodeAttributeOrDefault(tLockstepNode, "timeout", fTimeout, fTimeout);
+        m_cNetwork.SetLockstep(unPeriod, unPeers, unRank, fTimeout);
+    }
     /* Get experiment variables from the .argos file*/
     GetExperimentVariables(t_node);
     /* Get the virtual environment from the .argos file */
@@ -33,6 +88,24 @@ void CALF::Init(TConfigurationNode& t_node) {
     GetKilobotsEntities();
     /* Get the initial kilobots' states */
     SetupInitialKilobotStates();
+    /* Start the worker threads for the per-robot hooks */
+    GetNodeAttributeOrDefault(t_node, "threads", m_unThreads, m_unThreads);
+    GetNodeAttributeOrDefault(t_node, "chunk_size", m_unChunkSize, m_unChunkSize);
+    if(m_unThreads==0) m_unThreads=1;
+    if(m_unThreads>1 && !HasThreadSafeHooks()){
+        THROW_ARGOSEXCEPTION("These loop functions run their per-robot hooks serially, threads must be 1");
+    }
+    if(m_unChunkSize==0) m_unChunkSize=1;
+    m_vecPendingOHCMessages.resize(m_tKilobotEntities.size());
+    m_vecPendingOHCStates.resize(m_tKilobotEntities.size(), 0);
+    m_vecWorkers.resize(m_unThreads-1);
+    for(size_t i=0;i<m_vecWorkers.size();i++){
+        int nError=pthread_create(&m_vecWorkers[i], NULL, &StartWorkerThread, this);
+        if(nError!=0){
+            m_vecWorkers.resize(i);
+            THROW_ARGOSEXCEPTION("Can't create ALF worker thread: " << ::strerror(nError));
+        }
+    }
 }
 
 /****************************************/
@@ -41,6 +114,15 @@ void CALF::Init(TConfigurationNode& t_node) {
 void CALF::PreStep(){
     /* Update the time variable required for the experiment (in sec)*/
     m_fTimeInSeconds=GetSpace().GetSimulationClock()/CPhysicsEngine::GetInverseSimulationClockTick();
+    /* Exchange the messages with the other ALFs once for the whole tick */
+    if(m_cNetwork.IsOpen() && m_cNetwork.BeginStep()){
+        ReceiveNetworkMessages();
+    }
+    /* Gather the state of the swarm and let the ALF process it at once */
+    UpdateSwarmSnapshot();
+    if(m_cAreaIndex.GetNumAreas()>0)
+        m_cAreaIndex.Update(m_sSwarm.X, m_sSwarm.Y);
+    UpdateSwarm(m_sSwarm);
     /* Update the state of the kilobots in the space*/
     UpdateKilobotStates();
     /* Update the virtual sensor of the kilobots*/
@@ -49,6 +131,8 @@ void CALF::PreStep(){
     UpdateVirtualEnvironments();
     /* Update the virtual environment plot*/
     PlotEnvironment();
+    /* Send what the hooks queued without waiting for the next tick */
+    m_cNetwork.EndStep();
 }
 
 /****************************************/
@@ -69,6 +153,56 @@ void CALF::GetKilobotsEntities(){
     }
     /* Create Kilobots individual messages */
     m_tMessages=TKilobotsMessagesVector(m_tKilobotEntities.size());
+    /* Cache what does not change during the experiment, so that the per-tick
+       loops need no string parsing or lookup */
+    m_vecKilobots.resize(m_tKilobotEntities.size());
+    for(UInt32 i=0;i<m_tKilobotEntities.size();i++){
+        SKilobot& sKilobot=m_vecKilobots[i];
+        sKilobot.Entity=m_tKilobotEntities[i];
+        sKilobot.Id=FromString<UInt16>(sKilobot.Entity->GetControllableEntity().GetController().GetId().substr(2));
+        sKilobot.OrientationSource=CQuaternion(0,0,0,0);
+        if(sKilobot.Entity->GetIndex()>=static_cast<ssize_t>(m_vecKilobotIndices.size()))
+            m_vecKilobotIndices.resize(sKilobot.Entity->GetIndex()+1);
+        m_vecKilobotIndices[sKilobot.Entity->GetIndex()]=i;
+    }
+    m_sSwarm.X.resize(m_tKilobotEntities.size());
+    m_sSwarm.Y.resize(m_tKilobotEntities.size());
+    m_sSwarm.Yaw.resize(m_tKilobotEntities.size());
+    m_sSwarm.Led.resize(m_tKilobotEntities.size());
+    m_sSwarm.Id.resize(m_tKilobotEntities.size());
+    for(UInt32 i=0;i<m_vecKilobots.size();i++){
+        m_sSwarm.Id[i]=m_vecKilobots[i].Id;
+    }
+    try {
+        m_pcKilobotMedium=&GetSimulator().GetMedium<CKilobotCommunicationMedium>("kilocomm");
+    }
+    catch(CARGoSException&) {
+        /* No medium: GetKilobotMedium() reports it when called */
+        m_pcKilobotMedium=NULL;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::UpdateSwarmSnapshot(){
+    /* Reading the poses through the cache also fills it for the per-robot hooks */
+    for(UInt32 i=0;i<m_vecKilobots.size();i++){
+        const CVector2& cPosition=GetKilobotPosition(i);
+        m_sSwarm.X[i]=cPosition.GetX();
+        m_sSwarm.Y[i]=cPosition.GetY();
+    }
+    /* The parallel hooks only read the cache, so it must be complete */
+    if(m_bOrientationTracking || !m_vecWorkers.empty()){
+        for(UInt32 i=0;i<m_vecKilobots.size();i++){
+            m_sSwarm.Yaw[i]=GetKilobotOrientation(i).GetValue();
+        }
+    }
+    if(m_bColorTracking){
+        for(UInt32 i=0;i<m_vecKilobots.size();i++){
+            m_sSwarm.Led[i]=m_vecKilobots[i].Entity->GetLEDEquippedEntity().GetLED(0).GetColor();
+        }
+    }
 }
 
 /****************************************/
@@ -85,20 +219,32 @@ void CALF::SetTrackingType(TConfigurationNode& t_tree){
 /****************************************/
 
 void CALF::UpdateKilobotStates(){
-    for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
-        /* Update the virtual states and actuators of the kilobot*/
-        UpdateKilobotState(*m_tKilobotEntities[it]);
+    if(!m_vecWorkers.empty()){
+        RunParallelPhase(PHASE_KILOBOT_STATES);
+    }
+    else{
+        for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+            /* Update the virtual states and actuators of the kilobot*/
+            UpdateKilobotState(*m_tKilobotEntities[it]);
+        }
     }
+    ReduceKilobotStates();
 }
 
 /****************************************/
 /****************************************/
 
 void CALF::UpdateVirtualSensors(){
-    for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
-        /* Update the virtual sensor of a kilobot based on its current state */
-        UpdateVirtualSensor(*m_tKilobotEntities[it]);
+    if(!m_vecWorkers.empty()){
+        RunParallelPhase(PHASE_VIRTUAL_SENSORS);
+    }
+    else{
+        for(UInt16 it=0;it< m_tKilobotEntities.size();it++){
+            /* Update the virtual sensor of a kilobot based on its current state */
+            UpdateVirtualSensor(*m_tKilobotEntities[it]);
+        }
     }
+    ReduceVirtualSensors();
 }
 
 /****************************************/
@@ -115,28 +261,187 @@ void CALF::UpdateVirtualEnvironments(){
 /****************************************/
 /****************************************/
 
-CVector2 CALF::GetKilobotPosition(CKilobotEntity& c_kilobot_entity) {
-    return CVector2(
-                c_kilobot_entity.GetEmbodiedEntity().GetOriginAnchor().Position.GetX(),
-                c_kilobot_entity.GetEmbodiedEntity().GetOriginAnchor().Position.GetY());
+const CVector2& CALF::GetKilobotPosition(UInt32 un_index) {
+    SKilobot& sKilobot=m_vecKilobots[un_index];
+    /* Always read the anchor, which also follows resets and moved robots */
+    const CVector3& cPosition=sKilobot.Entity->GetEmbodiedEntity().GetOriginAnchor().Position;
+    sKilobot.Position.Set(cPosition.GetX(), cPosition.GetY());
+    return sKilobot.Position;
+}
+
+
+/****************************************/
+/****************************************/
+
+const CRadians& CALF::GetKilobotOrientation(UInt32 un_index) {
+    SKilobot& sKilobot=m_vecKilobots[un_index];
+    /* Keyed on the rotation rather than on the tick, which starts again from 0 after a reset */
+    const CQuaternion& cOrientation=sKilobot.Entity->GetEmbodiedEntity().GetOriginAnchor().Orientation;
+    if(cOrientation.GetW()!=sKilobot.OrientationSource.GetW() ||
+       cOrientation.GetX()!=sKilobot.OrientationSource.GetX() ||
+       cOrientation.GetY()!=sKilobot.OrientationSource.GetY() ||
+       cOrientation.GetZ()!=sKilobot.OrientationSource.GetZ()){
+        CRadians cYAngle, cXAngle;
+        //Calculate the orientations of the kilobot
+        cOrientation.ToEulerAngles(sKilobot.Orientation, cYAngle, cXAngle);
+        sKilobot.OrientationSource=cOrientation;
+    }
+    return sKilobot.Orientation;
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::RunParallelPhase(EParallelPhase e_phase){
+    pthread_mutex_lock(&m_tWorkerMutex);
+    m_ePhase=e_phase;
+    m_unNextChunk=0;
+    m_unBusyWorkers=m_vecWorkers.size();
+    m_bInParallelPhase=true;
+    ++m_unPhaseCounter;
+    pthread_cond_broadcast(&m_tWorkerStartCond);
+    pthread_mutex_unlock(&m_tWorkerMutex);
+    RunChunksCatching();
+    pthread_mutex_lock(&m_tWorkerMutex);
+    while(m_unBusyWorkers>0){
+        pthread_cond_wait(&m_tWorkerDoneCond, &m_tWorkerMutex);
+    }
+    m_bInParallelPhase=false;
+    pthread_mutex_unlock(&m_tWorkerMutex);
+    /* Report the first error raised by a hook */
+    if(!m_strWorkerError.empty()){
+        std::string strError;
+        strError.swap(m_strWorkerError);
+        THROW_ARGOSEXCEPTION(strError);
+    }
+    FlushOHCMessages();
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::RunChunks(){
+    while(1){
+        /* Take the next chunk */
+        pthread_mutex_lock(&m_tWorkerMutex);
+        UInt32 unFrom=m_unNextChunk;
+        m_unNextChunk+=m_unChunkSize;
+        pthread_mutex_unlock(&m_tWorkerMutex);
+        if(unFrom>=m_tKilobotEntities.size()) return;
+        UInt32 unTo=Min<UInt32>(unFrom+m_unChunkSize, m_tKilobotEntities.size());
+        for(UInt32 i=unFrom;i<unTo;i++){
+            if(m_ePhase==PHASE_KILOBOT_STATES)
+                UpdateKilobotState(*m_tKilobotEntities[i]);
+            else
+                UpdateVirtualSensor(*m_tKilobotEntities[i]);
+        }
+    }
 }
 
+/****************************************/
+/****************************************/
+
+void CALF::RunChunksCatching(){
+    /* An exception must not leave a worker thread, it is rethrown by the simulation thread */
+    std::string strError;
+    try{
+        RunChunks();
+        return;
+    }
+    catch(std::exception& ex){
+        strError=ex.what();
+    }
+    catch(...){
+        strError="Unknown exception in a per-robot hook";
+    }
+    pthread_mutex_lock(&m_tWorkerMutex);
+    if(m_strWorkerError.empty()) m_strWorkerError=strError;
+    /* Let the other threads run out of chunks */
+    m_unNextChunk=m_tKilobotEntities.size();
+    pthread_mutex_unlock(&m_tWorkerMutex);
+}
 
 /****************************************/
 /****************************************/
 
-CRadians CALF::GetKilobotOrientation(CKilobotEntity& c_kilobot_entity) {
-    CRadians cZAngle, cYAngle, cXAngle;
-    //Calculate the orientations of the kilobot
-    c_kilobot_entity.GetEmbodiedEntity().GetOriginAnchor().Orientation.ToEulerAngles(cZAngle, cYAngle, cXAngle);
-    return cZAngle;
+void CALF::WorkerThread(UInt32 un_index){
+    pthread_setspecific(m_tThreadIndexKey, reinterpret_cast<void*>(static_cast<size_t>(un_index)));
+    UInt32 unLastPhase=0;
+    pthread_mutex_lock(&m_tWorkerMutex);
+    while(1){
+        /* Wait for a phase to start */
+        while(!m_bQuitWorkers && m_unPhaseCounter==unLastPhase){
+            pthread_cond_wait(&m_tWorkerStartCond, &m_tWorkerMutex);
+        }
+        if(m_bQuitWorkers) break;
+        unLastPhase=m_unPhaseCounter;
+        pthread_mutex_unlock(&m_tWorkerMutex);
+        RunChunksCatching();
+        pthread_mutex_lock(&m_tWorkerMutex);
+        if(--m_unBusyWorkers==0){
+            pthread_cond_signal(&m_tWorkerDoneCond);
+        }
+    }
+    pthread_mutex_unlock(&m_tWorkerMutex);
+}
+
+void* CALF::StartWorkerThread(void* pt_alf){
+    CALF* pcALF=reinterpret_cast<CALF*>(pt_alf);
+    /* The workers are numbered from 1, the simulation thread is 0 */
+    pthread_mutex_lock(&pcALF->m_tWorkerMutex);
+    UInt32 unIndex=++pcALF->m_unStartedWorkers;
+    pthread_mutex_unlock(&pcALF->m_tWorkerMutex);
+    pcALF->WorkerThread(unIndex);
+    return NULL;
 }
 
 /****************************************/
 /****************************************/
 
-UInt16 CALF::GetKilobotId(CKilobotEntity& c_kilobot_entity) {
-    return FromString<UInt16>(c_kilobot_entity.GetControllableEntity().GetController().GetId().substr(2));
+UInt32 CALF::GetThreadIndex() const{
+    return static_cast<UInt32>(reinterpret_cast<size_t>(pthread_getspecific(m_tThreadIndexKey)));
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::SendOHCMessageTo(CKilobotEntity& c_kilobot_entity, message_t* pt_message){
+    if(!m_bInParallelPhase){
+        GetKilobotMedium().SendOHCMessageTo(c_kilobot_entity, pt_message);
+        return;
+    }
+    /* Each robot is processed by one thread, so its slot needs no lock */
+    UInt32 unIndex=GetKilobotIndex(c_kilobot_entity);
+    if(pt_message!=NULL){
+        m_vecPendingOHCMessages[unIndex]=*pt_message;
+        m_vecPendingOHCStates[unIndex]=1;
+    }
+    else{
+        m_vecPendingOHCStates[unIndex]=2;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALF::FlushOHCMessages(){
+    for(UInt32 i=0;i<m_vecPendingOHCStates.size();i++){
+        if(m_vecPendingOHCStates[i]!=0){
+            GetKilobotMedium().SendOHCMessageTo(*m_tKilobotEntities[i],
+                                                m_vecPendingOHCStates[i]==1 ? &m_vecPendingOHCMessages[i] : NULL);
+            m_vecPendingOHCStates[i]=0;
+        }
+    }
+}
+
+/****************************************/
+/****************************************/
+
+CKilobotCommunicationMedium& CALF::GetKilobotMedium() {
+    if(m_pcKilobotMedium==NULL){
+        THROW_ARGOSEXCEPTION("The ALF needs a Kilobot communication medium with id \"kilocomm\"");
+    }
+    return *m_pcKilobotMedium;
 }
 
 /****************************************/
@@ -149,8 +454,26 @@ CColor CALF::GetKilobotLedColor(CKilobotEntity& c_kilobot_entity) {
 /****************************************/
 /****************************************/
 
+void CALF::EnableFloorRaster(Real f_texel_size, const CColor& c_background){
+    const CVector3& cArenaCenter=GetSpace().GetArenaCenter();
+    const CVector3& cArenaSize=GetSpace().GetArenaSize();
+    m_cFloorRaster.Init(CVector2(cArenaCenter.GetX()-0.5*cArenaSize.GetX(), cArenaCenter.GetY()-0.5*cArenaSize.GetY()),
+                        CVector2(cArenaCenter.GetX()+0.5*cArenaSize.GetX(), cArenaCenter.GetY()+0.5*cArenaSize.GetY()),
+                        f_texel_size,
+                        c_background);
+}
+
+/****************************************/
+/****************************************/
+
 void CALF::PlotEnvironment(){
     /* Update the Floor visualization of the virtual environment every m_unEnvironmentPlotUpdateFrequency ticks*/
-    if(GetSpace().GetSimulationClock()%m_unEnvironmentPlotUpdateFrequency==0)
+    if(GetSpace().GetSimulationClock()%m_unEnvironmentPlotUpdateFrequency==0){
+        /* With the floor raster, a floor with no changed texel needs no refresh */
+        if(m_cFloorRaster.IsEnabled()){
+            if(!m_cFloorRaster.IsChanged()) return;
+            m_cFloorRaster.ClearChanged();
+        }
         GetSpace().GetFloorEntity().SetChanged();
+    }
 }
@@ -45,6 +45,10 @@ class CSimulator;
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_entity.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_medium.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_default_actuator.h>
+#include <argos3/plugins/robots/kilobot/simulator/ALF_floor_raster.h>
+#include <argos3/plugins/robots/kilobot/simulator/ALF_area_index.h>
+#include <argos3/plugins/robots/kilobot/simulator/ALF_network.h>
+#include <argos3/plugins/robots/kilobot/simulator/ALF_protocol.h>
 
 //kilobot messaging
 #include <argos3/plugins/robots/kilobot/control_interface/kilolib.h>
@@ -52,6 +56,7 @@ class CSimulator;
 #include <argos3/plugins/robots/kilobot/control_interface/message.h>
 
 #include <array>
+#include <pthread.h>
 
 
 using namespace argos;
@@ -72,8 +77,9 @@ public:
 
     /**
      * Class destructor.
+     * It stops the worker threads, if any.
      */
-    virtual ~CALF(){}
+    virtual ~CALF();
 
     /**
      * Executes user-defined initialization logic.
@@ -161,13 +167,66 @@ public:
      */
     virtual void GetExperimentVariables(TConfigurationNode& t_tree){}
 
+    /** Snapshot of the swarm, one array per quantity, in the same order as m_tKilobotEntities */
+    struct SSwarmSnapshot {
+        /** Position on the floor */
+        std::vector<Real> X;
+        std::vector<Real> Y;
+        /** Orientation around Z in radians, filled only if orientation tracking is on */
+        std::vector<Real> Yaw;
+        /** LED color as returned by CColor::operator UInt32(), filled only if color tracking is on */
+        std::vector<UInt32> Led;
+        /** Numeric ID */
+        std::vector<UInt16> Id;
+
+        size_t Size() const {
+            return Id.size();
+        }
+    };
+
+    /**
+     * Gathers the state of all the Kilobots into the swarm snapshot
+     * It is called once per tick by PreStep(), before UpdateSwarm().
+     * @see GetSwarmSnapshot
+     */
+    void UpdateSwarmSnapshot();
+
+    /**
+     * Returns the swarm snapshot of the current tick
+     * @see UpdateSwarmSnapshot
+     */
+    const SSwarmSnapshot& GetSwarmSnapshot() const {
+        return m_sSwarm;
+    }
+
+    /**
+     * Processes the whole swarm at once, before the per-robot hooks are called
+     * The arrays of the snapshot allow area tests, wall checks and message composition
+     * to be written as plain loops over contiguous data.
+     * The default implementation of this method does nothing.
+     * @param s_swarm The swarm snapshot of the current tick
+     * @see UpdateKilobotStates
+     */
+    virtual void UpdateSwarm(const SSwarmSnapshot& s_swarm){}
+
     /**
      * Gets the current state of the Kilobots
      * The default implementation of this function go through the Kilobots and updates the state of each of them.
+     * With <tt>threads</tt> greater than one, the robots are split into chunks processed in parallel.
+     * Then ReduceKilobotStates() is called by the simulation thread, whatever the number of threads.
      * @see UpdateKilobotState
+     * @see GetThreadIndex
      */
     virtual void UpdateKilobotStates();
 
+    /**
+     * Merges the per-thread results of UpdateKilobotState() into the shared virtual environment state
+     * It is called by the simulation thread after all the robots were processed.
+     * The default implementation of this method does nothing.
+     * @see UpdateKilobotStates
+     */
+    virtual void ReduceKilobotStates(){}
+
     /**
      * Gets the current state of a selected kilobot entity
      * @param c_kilobot_entity A reference to the selected kilobot entity
@@ -178,9 +237,20 @@ public:
     /**
      * Updates the virtual sensors of the Kilobots
      * The default implementation of this function goes through the Kilobots and updates the virtual sensors of each of them.
+     * With <tt>threads</tt> greater than one, the robots are split into chunks processed in parallel.
+     * Then ReduceVirtualSensors() is called by the simulation thread, whatever the number of threads.
+     * @see GetThreadIndex
      */
     virtual void UpdateVirtualSensors();
 
+    /**
+     * Merges the per-thread results of UpdateVirtualSensor() into the shared virtual environment state
+     * It is called by the simulation thread after all the robots were processed.
+     * The default implementation of this method does nothing.
+     * @see UpdateVirtualSensors
+     */
+    virtual void ReduceVirtualSensors(){}
+
     /**
      * Updates the virtual sensor of a selected Kilobot entity according to its current state
      * @param c_kilobot_entity A reference to the selected kilobot entity
@@ -207,19 +277,99 @@ public:
      * Get the position of a selected Kilobot entity
      * @param c_kilobot_entity A reference to the selected kilobot entity
      */
-    CVector2 GetKilobotPosition(CKilobotEntity& c_kilobot_entity);
+    CVector2 GetKilobotPosition(CKilobotEntity& c_kilobot_entity) {
+        return GetKilobotPosition(GetKilobotIndex(c_kilobot_entity));
+    }
+
+    /**
+     * Get the position of the Kilobot with the given index in m_tKilobotEntities
+     * @param un_index The index of the kilobot
+     */
+    const CVector2& GetKilobotPosition(UInt32 un_index);
 
     /**
      * Get the orientation of a selected Kilobot entity
+     * The orientation is computed again only when the robot rotated.
      * @param c_kilobot_entity A reference to the selected kilobot entity
      */
-    CRadians GetKilobotOrientation(CKilobotEntity& c_kilobot_entity);
+    CRadians GetKilobotOrientation(CKilobotEntity& c_kilobot_entity) {
+        return GetKilobotOrientation(GetKilobotIndex(c_kilobot_entity));
+    }
+
+    /**
+     * Get the orientation of the Kilobot with the given index in m_tKilobotEntities
+     * The orientation is computed again only when the robot rotated.
+     * @param un_index The index of the kilobot
+     */
+    const CRadians& GetKilobotOrientation(UInt32 un_index);
 
     /**
      * Get the ID of a selected Kilobot entity
+     * The ID is parsed from the controller ID once, in GetKilobotsEntities().
      * @param c_kilobot_entity A reference to the selected kilobot entity
      */
-    UInt16 GetKilobotId(CKilobotEntity& c_kilobot_entity);
+    UInt16 GetKilobotId(CKilobotEntity& c_kilobot_entity) {
+        return m_vecKilobots[GetKilobotIndex(c_kilobot_entity)].Id;
+    }
+
+    /**
+     * Get the ID of the Kilobot with the given index in m_tKilobotEntities
+     * @param un_index The index of the kilobot
+     */
+    UInt16 GetKilobotId(UInt32 un_index) const {
+        return m_vecKilobots[un_index].Id;
+    }
+
+    /**
+     * Get the index in m_tKilobotEntities of a selected Kilobot entity
+     * @param c_kilobot_entity A reference to the selected kilobot entity
+     */
+    UInt32 GetKilobotIndex(CKilobotEntity& c_kilobot_entity) const {
+        return m_vecKilobotIndices[c_kilobot_entity.GetIndex()];
+    }
+
+    /**
+     * Returns the number of threads running the per-robot hooks, including the simulation thread.
+     * It is set with the <tt>threads</tt> attribute of <tt>&lt;loop_functions&gt;</tt> and defaults to 1.
+     * When greater than one, UpdateKilobotState() and UpdateVirtualSensor() run concurrently for
+     * different robots. They may then only write the state of their own robot, or per-thread
+     * accumulators indexed by GetThreadIndex(), which ReduceKilobotStates() and
+     * ReduceVirtualSensors() merge into the shared state (e.g. the robot count of an area).
+     * Overhead controller messages must be sent through SendOHCMessageTo().
+     */
+    UInt32 GetThreads() const {
+        return m_unThreads;
+    }
+
+    /**
+     * Returns whether the per-robot hooks follow the rules of GetThreads() and may run in parallel.
+     * Loop functions must override this method to return true to accept <tt>threads</tt> greater than one.
+     * The default implementation returns false.
+     */
+    virtual bool HasThreadSafeHooks() const {
+        return false;
+    }
+
+    /**
+     * Returns the index of the calling thread, between 0 and GetThreads()-1.
+     * The simulation thread has index 0.
+     */
+    UInt32 GetThreadIndex() const;
+
+    /**
+     * Sends a message to the given robot through the overhead controller.
+     * In the parallel hooks, the message is copied and handed to the medium after all the robots are processed.
+     * To erase a message, set it to NULL.
+     * @param c_kilobot_entity A reference to the selected kilobot entity
+     * @param pt_message The message payload
+     */
+    void SendOHCMessageTo(CKilobotEntity& c_kilobot_entity, message_t* pt_message);
+
+    /**
+     * Get the Kilobot communication medium, looked up once in GetKilobotsEntities().
+     * @throws CARGoSException If the arena has no Kilobot communication medium.
+     */
+    CKilobotCommunicationMedium& GetKilobotMedium();
 
     /**
      * Get the LedColor of a selected Kilobot entity
@@ -233,14 +383,74 @@ public:
      * as source. The floor color is used by the ground sensors to calculate their readings,
      * and by the graphical visualization to create a texture to display on the arena floor.
      * @param c_pos_on_floor The position on the floor.
+     * The default implementation returns the color of the floor raster, if enabled, or white.
      * @return The color of the floor in the specified point.
      * @see CFloorEntity
      * @see PlotEnvironment
+     * @see EnableFloorRaster
      */
     virtual CColor GetFloorColor(const CVector2& c_pos_on_floor) {
+        if(m_cFloorRaster.IsEnabled())
+            return m_cFloorRaster.GetColor(c_pos_on_floor);
         return CColor::WHITE;
     }
 
+    /**
+     * Makes GetFloorColor() serve the floor raster, covering the whole arena.
+     * The subclass draws the virtual environment into GetFloorRaster() as shapes,
+     * and updates them when it changes; only the changed texels are rasterized again,
+     * and the floor is refreshed only when some texel changed.
+     * @param f_texel_size The side of a texel of the raster.
+     * @param c_background The color where no shape is drawn.
+     */
+    void EnableFloorRaster(Real f_texel_size,
+                           const CColor& c_background = CColor::WHITE);
+
+    /**
+     * Returns the floor raster.
+     * @see EnableFloorRaster
+     */
+    CALFFloorRaster& GetFloorRaster() {
+        return m_cFloorRaster;
+    }
+
+    /**
+     * Returns the index of the virtual areas.
+     * The subclass adds its areas in SetupVirtualEnvironments(); if there is any,
+     * PreStep() finds the area of each robot from the swarm snapshot before UpdateSwarm(),
+     * so the hooks can query the index instead of testing every area.
+     * The cell size of its grid is set with the <tt>area_cell_size</tt> attribute of
+     * <tt>&lt;loop_functions&gt;</tt> and defaults to 0.1.
+     */
+    CALFAreaIndex& GetAreaIndex() {
+        return m_cAreaIndex;
+    }
+
+    /**
+     * Returns the connection to the other ALFs.
+     * Once the subclass opened it with Listen() or Connect(), PreStep() does one
+     * non-blocking exchange per tick and calls ReceiveNetworkMessages(); the messages
+     * sent during the tick are flushed at the end of PreStep().
+     * A <tt>&lt;lockstep period="..." peers="..." rank="..." timeout="..." /&gt;</tt> node in
+     * <tt>&lt;loop_functions&gt;</tt> enables the lockstep mode of the network: then
+     * ReceiveNetworkMessages() is only called every <tt>period</tt> ticks (default 1), with the
+     * messages the peers sent up to their previous boundary. A listening ALF waits for
+     * <tt>peers</tt> ALFs (default 1), and returns their messages by <tt>rank</tt>.
+     * @see CALFNetwork::SetLockstep
+     */
+    CALFNetwork& GetNetwork() {
+        return m_cNetwork;
+    }
+
+    /**
+     * Processes the messages received from the other ALFs, with GetNetwork().Receive().
+     * It is called once per tick by PreStep(), before UpdateSwarm(), if the network is open,
+     * or once per boundary in lockstep mode.
+     * The default implementation of this method does nothing.
+     * @see GetNetwork
+     */
+    virtual void ReceiveNetworkMessages(){}
+
     /**
      * Plots the virtual environments on the arena surface
      */
@@ -253,6 +463,41 @@ protected:
     typedef std::vector<CKilobotEntity*> TKilobotEntitiesVector;
     TKilobotEntitiesVector m_tKilobotEntities;
 
+    /** Cached data of a Kilobot */
+    struct SKilobot {
+        /** The Kilobot entity */
+        CKilobotEntity* Entity;
+        /** Numeric ID, parsed from the controller ID */
+        UInt16 Id;
+        /** Position on the floor */
+        CVector2 Position;
+        /** Orientation around Z */
+        CRadians Orientation;
+        /** Rotation Orientation was computed from; the zero quaternion before the first computation */
+        CQuaternion OrientationSource;
+    };
+
+    /** The cached data of the Kilobots, in the same order as m_tKilobotEntities */
+    std::vector<SKilobot> m_vecKilobots;
+
+    /** Index of each Kilobot in m_tKilobotEntities, addressed by entity index */
+    std::vector<UInt32> m_vecKilobotIndices;
+
+    /** The virtual areas, and the robots in each of them */
+    CALFAreaIndex m_cAreaIndex;
+
+    /** The virtual environment drawn on the floor */
+    CALFFloorRaster m_cFloorRaster;
+
+    /** The connection to the other ALFs */
+    CALFNetwork m_cNetwork;
+
+    /** The swarm snapshot of the current tick */
+    SSwarmSnapshot m_sSwarm;
+
+    /** The Kilobot communication medium, or NULL if there is none */
+    CKilobotCommunicationMedium* m_pcKilobotMedium;
+
     /** List of the messages sent by communication entities */
     typedef std::vector<message_t> TKilobotsMessagesVector;
     TKilobotsMessagesVector m_tMessages;
@@ -277,6 +522,92 @@ protected:
 
     /** Virtual environment update frequency in ticks*/
     UInt16 m_unEnvironmentPlotUpdateFrequency;
+
+private:
+
+    /** The per-robot hooks that can run in parallel */
+    enum EParallelPhase {
+        PHASE_KILOBOT_STATES,
+        PHASE_VIRTUAL_SENSORS
+    };
+
+    /**
+     * Runs the given phase for all the robots, using the worker threads
+     */
+    void RunParallelPhase(EParallelPhase e_phase);
+
+    /**
+     * Processes chunks of robots until none is left
+     */
+    void RunChunks();
+
+    /**
+     * Runs RunChunks(), storing the first error raised by a hook and stopping the other threads
+     */
+    void RunChunksCatching();
+
+    /**
+     * Hands the messages sent during a parallel phase to the medium
+     */
+    void FlushOHCMessages();
+
+    /**
+     * Main loop of a worker thread
+     */
+    void WorkerThread(UInt32 un_index);
+
+    static void* StartWorkerThread(void* pt_alf);
+
+    /** Number of threads running the per-robot hooks, including the simulation thread */
+    UInt32 m_unThreads;
+
+    /** Number of robots in a chunk */
+    UInt32 m_unChunkSize;
+
+    /** The worker threads */
+    std::vector<pthread_t> m_vecWorkers;
+
+    /** Holds the index of each thread */
+    pthread_key_t m_tThreadIndexKey;
+
+    /** Protects the worker thread state */
+    pthread_mutex_t m_tWorkerMutex;
+
+    /** Signals the workers that a phase started */
+    pthread_cond_t m_tWorkerStartCond;
+
+    /** Signals the simulation thread that the workers are done */
+    pthread_cond_t m_tWorkerDoneCond;
+
+    /** Counts the phases, so that workers can tell a new phase started */
+    UInt32 m_unPhaseCounter;
+
+    /** The phase being run */
+    EParallelPhase m_ePhase;
+
+    /** Number of workers still working on the current phase */
+    UInt32 m_unBusyWorkers;
+
+    /** Number of workers started so far, used to number them */
+    UInt32 m_unStartedWorkers;
+
+    /** Index of the first robot of the next chunk */
+    UInt32 m_unNextChunk;
+
+    /** Whether the worker threads must quit */
+    bool m_bQuitWorkers;
+
+    /** Whether a parallel phase is running */
+    bool m_bInParallelPhase;
+
+    /** Error raised by a hook during a parallel phase, if any */
+    std::string m_strWorkerError;
+
+    /** The messages sent during a parallel phase, in the same order as m_tKilobotEntities */
+    std::vector<message_t> m_vecPendingOHCMessages;
+
+    /** For each robot: 0 if no message was sent, 1 if it was set, 2 if it was erased */
+    std::vector<UInt8> m_vecPendingOHCStates;
 };
 
 #endif
@@ -0,0 +1,217 @@
+/**
+ * @file <ALF_area_index.cpp>
+ *
+ * @brief This is the source file of the virtual area index of the ARK Loop Function (ALF).
+ *
+ */
+
+#include "ALF_area_index.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+
+/****************************************/
+/****************************************/
+
+CALFAreaIndex::CALFAreaIndex():
+    m_bGridDirty(true),
+    m_fInvCellSize(1.0),
+    m_nCellsX(1),
+    m_nCellsY(1){
+    m_vecAreaStart.assign(1, 0);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::Init(const CVector2& c_min,
+                         const CVector2& c_max,
+                         Real f_cell_size){
+    if(f_cell_size <= 0.0){
+        THROW_ARGOSEXCEPTION("The cell size of the area index must be positive, " << f_cell_size << " given");
+    }
+    m_cMin=c_min;
+    m_fInvCellSize=1.0/f_cell_size;
+    m_nCellsX=Max<SInt32>(1, Ceil((c_max.GetX()-c_min.GetX())*m_fInvCellSize));
+    m_nCellsY=Max<SInt32>(1, Ceil((c_max.GetY()-c_min.GetY())*m_fInvCellSize));
+    m_bGridDirty=true;
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFAreaIndex::AddCircle(const CVector2& c_center,
+                                Real f_radius){
+    m_vecAreas.push_back(SArea());
+    m_vecAreas.back().Circle=true;
+    m_vecAreas.back().Enabled=true;
+    SetCircle(m_vecAreas.size()-1, c_center, f_radius);
+    return m_vecAreas.size()-1;
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFAreaIndex::AddRectangle(const CVector2& c_min,
+                                   const CVector2& c_max){
+    m_vecAreas.push_back(SArea());
+    m_vecAreas.back().Circle=false;
+    m_vecAreas.back().Enabled=true;
+    SetRectangle(m_vecAreas.size()-1, c_min, c_max);
+    return m_vecAreas.size()-1;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::SetCircle(UInt32 un_area,
+                              const CVector2& c_center,
+                              Real f_radius){
+    SArea& sArea=m_vecAreas[un_area];
+    sArea.Center=c_center;
+    sArea.SqRadius=f_radius*f_radius;
+    sArea.Min=c_center-CVector2(f_radius, f_radius);
+    sArea.Max=c_center+CVector2(f_radius, f_radius);
+    m_bGridDirty=true;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::SetRectangle(UInt32 un_area,
+                                 const CVector2& c_min,
+                                 const CVector2& c_max){
+    SArea& sArea=m_vecAreas[un_area];
+    sArea.Min=c_min;
+    sArea.Max=c_max;
+    m_bGridDirty=true;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::SetEnabled(UInt32 un_area,
+                               bool b_enabled){
+    /* Disabled areas stay in the grid, and are skipped by the queries */
+    m_vecAreas[un_area].Enabled=b_enabled;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::Clear(){
+    m_vecAreas.clear();
+    m_vecRobotAreas.clear();
+    m_vecAreaStart.assign(1, 0);
+    m_vecAreaRobots.clear();
+    m_vecTransitions.clear();
+    m_bGridDirty=true;
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFAreaIndex::Contains(UInt32 un_area,
+                             const CVector2& c_point) const{
+    const SArea& sArea=m_vecAreas[un_area];
+    if(!sArea.Enabled) return false;
+    if(sArea.Circle)
+        return SquareDistance(c_point, sArea.Center)<sArea.SqRadius;
+    return c_point.GetX()>=sArea.Min.GetX() && c_point.GetX()<=sArea.Max.GetX() &&
+           c_point.GetY()>=sArea.Min.GetY() && c_point.GetY()<=sArea.Max.GetY();
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::GetCell(const CVector2& c_point,
+                            SInt32& n_i,
+                            SInt32& n_j) const{
+    n_i=Floor((c_point.GetX()-m_cMin.GetX())*m_fInvCellSize);
+    n_j=Floor((c_point.GetY()-m_cMin.GetY())*m_fInvCellSize);
+    n_i=Min<SInt32>(Max<SInt32>(n_i, 0), m_nCellsX-1);
+    n_j=Min<SInt32>(Max<SInt32>(n_j, 0), m_nCellsY-1);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::BuildGrid(){
+    /* Counting sort of the areas by the cells they overlap, in id order */
+    m_vecCellStart.assign(m_nCellsX*m_nCellsY+1, 0);
+    for(int nPass=0;nPass<2;nPass++){
+        for(UInt32 a=0;a<m_vecAreas.size();a++){
+            SInt32 nMinI, nMinJ, nMaxI, nMaxJ;
+            GetCell(m_vecAreas[a].Min, nMinI, nMinJ);
+            GetCell(m_vecAreas[a].Max, nMaxI, nMaxJ);
+            for(SInt32 j=nMinJ;j<=nMaxJ;j++){
+                for(SInt32 i=nMinI;i<=nMaxI;i++){
+                    if(nPass==0)
+                        ++m_vecCellStart[j*m_nCellsX+i+1];
+                    else
+                        m_vecCellAreas[m_vecCellStart[j*m_nCellsX+i]++]=a;
+                }
+            }
+        }
+        if(nPass==0){
+            for(size_t i=1;i<m_vecCellStart.size();i++){
+                m_vecCellStart[i]+=m_vecCellStart[i-1];
+            }
+            m_vecCellAreas.resize(m_vecCellStart.back());
+        }
+    }
+    /* The fill pass moved each start to the start of the next cell */
+    for(size_t i=m_vecCellStart.size()-1;i>0;i--){
+        m_vecCellStart[i]=m_vecCellStart[i-1];
+    }
+    m_vecCellStart[0]=0;
+    m_bGridDirty=false;
+}
+
+/****************************************/
+/****************************************/
+
+SInt32 CALFAreaIndex::GetAreaAt(const CVector2& c_point){
+    if(m_bGridDirty) BuildGrid();
+    SInt32 nI, nJ;
+    GetCell(c_point, nI, nJ);
+    UInt32 unCell=nJ*m_nCellsX+nI;
+    for(UInt32 k=m_vecCellStart[unCell];k<m_vecCellStart[unCell+1];k++){
+        if(Contains(m_vecCellAreas[k], c_point))
+            return m_vecCellAreas[k];
+    }
+    return -1;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFAreaIndex::Update(const std::vector<Real>& vec_x,
+                           const std::vector<Real>& vec_y){
+    m_vecTransitions.clear();
+    m_vecRobotAreas.resize(vec_x.size(), -1);
+    m_vecAreaStart.assign(m_vecAreas.size()+2, 0);
+    for(UInt32 r=0;r<vec_x.size();r++){
+        CVector2 cPoint(vec_x[r], vec_y[r]);
+        SInt32 nArea=m_vecRobotAreas[r];
+        /* Most robots are still in the area of the previous tick */
+        if(nArea<0 || nArea>=static_cast<SInt32>(m_vecAreas.size()) || !Contains(nArea, cPoint)){
+            SInt32 nNewArea=GetAreaAt(cPoint);
+            if(nNewArea!=nArea){
+                STransition sTransition={ r, nArea, nNewArea };
+                m_vecTransitions.push_back(sTransition);
+                nArea=nNewArea;
+                m_vecRobotAreas[r]=nArea;
+            }
+        }
+        if(nArea>=0) ++m_vecAreaStart[nArea+2];
+    }
+    /* Counting sort of the robots by area */
+    for(size_t i=2;i<m_vecAreaStart.size();i++){
+        m_vecAreaStart[i]+=m_vecAreaStart[i-1];
+    }
+    m_vecAreaRobots.resize(m_vecAreaStart.back());
+    for(UInt32 r=0;r<m_vecRobotAreas.size();r++){
+        if(m_vecRobotAreas[r]>=0)
+            m_vecAreaRobots[m_vecAreaStart[m_vecRobotAreas[r]+1]++]=r;
+    }
+    m_vecAreaStart.pop_back();
+}
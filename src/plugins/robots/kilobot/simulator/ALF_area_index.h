@@ -0,0 +1,208 @@
+/**
+ * @file <ALF_area_index.h>
+ *
+ * @brief This is the header file of the virtual area index of the ARK Loop Function (ALF).
+ * It finds the virtual areas containing a point through a uniform grid, and keeps
+ * track of the robots inside each area from one tick to the next.
+ *
+ */
+
+#ifndef ALF_AREA_INDEX_H
+#define ALF_AREA_INDEX_H
+
+#include <argos3/core/utility/math/vector2.h>
+
+#include <vector>
+
+
+using namespace argos;
+
+/**
+ * @brief The CALFAreaIndex class
+ */
+
+class CALFAreaIndex
+{
+
+public:
+
+    /** A robot that entered or left an area during the last Update() */
+    struct STransition {
+        /** Index of the robot, as in the arrays passed to Update() */
+        UInt32 Robot;
+        /** The previous area, or -1 */
+        SInt32 From;
+        /** The new area, or -1 */
+        SInt32 To;
+    };
+
+    /**
+     * Class constructor.
+     */
+    CALFAreaIndex();
+
+    /**
+     * Sets the region covered by the grid.
+     * Areas and points outside the region are still handled, in the border cells.
+     * @param c_min The corner of the region with the smallest coordinates.
+     * @param c_max The corner of the region with the largest coordinates.
+     * @param f_cell_size The side of a grid cell.
+     */
+    void Init(const CVector2& c_min,
+              const CVector2& c_max,
+              Real f_cell_size);
+
+    /**
+     * Adds a circular area.
+     * @return The id of the area.
+     */
+    UInt32 AddCircle(const CVector2& c_center,
+                     Real f_radius);
+
+    /**
+     * Adds a rectangular area, aligned with the axes.
+     * @return The id of the area.
+     */
+    UInt32 AddRectangle(const CVector2& c_min,
+                        const CVector2& c_max);
+
+    /**
+     * Moves or resizes a circular area.
+     */
+    void SetCircle(UInt32 un_area,
+                   const CVector2& c_center,
+                   Real f_radius);
+
+    /**
+     * Moves or resizes a rectangular area.
+     */
+    void SetRectangle(UInt32 un_area,
+                      const CVector2& c_min,
+                      const CVector2& c_max);
+
+    /**
+     * Enables or disables an area; a disabled area contains nothing.
+     */
+    void SetEnabled(UInt32 un_area,
+                    bool b_enabled);
+
+    /**
+     * Removes all the areas.
+     */
+    void Clear();
+
+    /**
+     * Returns the number of areas.
+     */
+    size_t GetNumAreas() const {
+        return m_vecAreas.size();
+    }
+
+    /**
+     * Returns whether the given area contains the given point.
+     */
+    bool Contains(UInt32 un_area,
+                  const CVector2& c_point) const;
+
+    /**
+     * Returns the enabled area with the lowest id containing the given point, or -1.
+     */
+    SInt32 GetAreaAt(const CVector2& c_point);
+
+    /**
+     * Finds the area of each robot.
+     * A robot stays in its area of the previous tick as long as it is inside it;
+     * otherwise, it is assigned the area returned by GetAreaAt().
+     * @param vec_x The X coordinates of the robots.
+     * @param vec_y The Y coordinates of the robots.
+     */
+    void Update(const std::vector<Real>& vec_x,
+                const std::vector<Real>& vec_y);
+
+    /**
+     * Returns the area of the given robot found by the last Update(), or -1.
+     * It is -1 for all the robots until the first Update() after the areas are added.
+     */
+    SInt32 GetRobotArea(UInt32 un_robot) const {
+        return un_robot < m_vecRobotAreas.size() ? m_vecRobotAreas[un_robot] : -1;
+    }
+
+    /**
+     * Returns the number of robots in the given area found by the last Update().
+     */
+    UInt32 GetNumRobotsInArea(UInt32 un_area) const {
+        return m_vecAreaStart[un_area + 1] - m_vecAreaStart[un_area];
+    }
+
+    /**
+     * Returns the robots in the given area found by the last Update(), in increasing index order.
+     * There are GetNumRobotsInArea() of them.
+     */
+    const UInt32* GetRobotsInArea(UInt32 un_area) const {
+        return m_vecAreaRobots.empty() ? NULL : &m_vecAreaRobots[m_vecAreaStart[un_area]];
+    }
+
+    /**
+     * Returns the robots that entered or left an area during the last Update().
+     */
+    const std::vector<STransition>& GetTransitions() const {
+        return m_vecTransitions;
+    }
+
+private:
+
+    struct SArea {
+        bool Circle;
+        bool Enabled;
+        CVector2 Center;
+        Real SqRadius;
+        /** Bounding box */
+        CVector2 Min;
+        CVector2 Max;
+    };
+
+    /**
+     * Returns the cell coordinates of a point, clamped to the grid.
+     */
+    void GetCell(const CVector2& c_point,
+                 SInt32& n_i,
+                 SInt32& n_j) const;
+
+    /**
+     * Sorts the areas into the cells they overlap.
+     */
+    void BuildGrid();
+
+    /** The areas, addressed by id */
+    std::vector<SArea> m_vecAreas;
+
+    /** Start of each cell in m_vecCellAreas; the last element is the total */
+    std::vector<UInt32> m_vecCellStart;
+
+    /** Ids of the areas overlapping each cell, in increasing order */
+    std::vector<UInt32> m_vecCellAreas;
+
+    /** Whether the areas changed since the grid was built */
+    bool m_bGridDirty;
+
+    /** Area of each robot, or -1 */
+    std::vector<SInt32> m_vecRobotAreas;
+
+    /** Start of each area in m_vecAreaRobots; the last element is the total */
+    std::vector<UInt32> m_vecAreaStart;
+
+    /** Indices of the robots sorted by area */
+    std::vector<UInt32> m_vecAreaRobots;
+
+    /** The robots that entered or left an area in the last Update() */
+    std::vector<STransition> m_vecTransitions;
+
+    /** Corner of the grid with the smallest coordinates */
+    CVector2 m_cMin;
+
+    Real m_fInvCellSize;
+    SInt32 m_nCellsX;
+    SInt32 m_nCellsY;
+};
+
+#endif
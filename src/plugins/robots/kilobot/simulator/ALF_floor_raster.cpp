@@ -0,0 +1,292 @@
+/**
+ * @file <ALF_floor_raster.cpp>
+ *
+ * @brief This is the source file of the floor raster of the ARK Loop Function (ALF).
+ *
+ */
+
+#include "ALF_floor_raster.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <algorithm>
+#include <cmath>
+
+/** Above this number of dirty rectangles, they are merged into one */
+static const size_t MAX_DIRTY_RECTS = 32;
+
+/****************************************/
+/****************************************/
+
+CALFFloorRaster::CALFFloorRaster():
+    m_cBackground(CColor::WHITE),
+    m_fTexelSize(0.0),
+    m_fInvTexelSize(0.0),
+    m_nTexelsX(0),
+    m_nTexelsY(0),
+    m_bChanged(false){
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::Init(const CVector2& c_min,
+                           const CVector2& c_max,
+                           Real f_texel_size,
+                           const CColor& c_background){
+    if(f_texel_size <= 0.0){
+        THROW_ARGOSEXCEPTION("The texel size of the floor raster must be positive, " << f_texel_size << " given");
+    }
+    m_cMin=c_min;
+    m_fTexelSize=f_texel_size;
+    m_fInvTexelSize=1.0/f_texel_size;
+    m_nTexelsX=Max<SInt32>(1, Ceil((c_max.GetX()-c_min.GetX())*m_fInvTexelSize));
+    m_nTexelsY=Max<SInt32>(1, Ceil((c_max.GetY()-c_min.GetY())*m_fInvTexelSize));
+    m_cBackground=c_background;
+    m_vecTexels.assign(m_nTexelsX*m_nTexelsY, c_background);
+    m_vecDirty.clear();
+    /* The shapes already added must be drawn on the new texels */
+    for(size_t i=0;i<m_vecShapes.size();i++){
+        UpdateBounds(m_vecShapes[i]);
+        MarkDirty(m_vecShapes[i].Bounds);
+    }
+    m_bChanged=true;
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFFloorRaster::AddCircle(const CVector2& c_center,
+                                  Real f_radius,
+                                  const CColor& c_color,
+                                  SInt32 n_layer){
+    SShape sShape;
+    sShape.Type=SHAPE_CIRCLE;
+    sShape.Layer=n_layer;
+    sShape.Color=c_color;
+    sShape.Center=c_center;
+    sShape.Radius=f_radius;
+    return AddShape(sShape);
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFFloorRaster::AddPolygon(const std::vector<CVector2>& vec_vertices,
+                                   const CColor& c_color,
+                                   SInt32 n_layer){
+    if(vec_vertices.size()<3){
+        THROW_ARGOSEXCEPTION("A polygon needs at least 3 vertices, " << vec_vertices.size() << " given");
+    }
+    SShape sShape;
+    sShape.Type=SHAPE_POLYGON;
+    sShape.Layer=n_layer;
+    sShape.Color=c_color;
+    sShape.Radius=0.0;
+    sShape.Vertices=vec_vertices;
+    return AddShape(sShape);
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFFloorRaster::AddRadialGradient(const CVector2& c_center,
+                                          Real f_radius,
+                                          const CColor& c_inner_color,
+                                          const CColor& c_outer_color,
+                                          SInt32 n_layer){
+    SShape sShape;
+    sShape.Type=SHAPE_RADIAL_GRADIENT;
+    sShape.Layer=n_layer;
+    sShape.Color=c_inner_color;
+    sShape.OuterColor=c_outer_color;
+    sShape.Center=c_center;
+    sShape.Radius=f_radius;
+    return AddShape(sShape);
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFFloorRaster::AddShape(const SShape& s_shape){
+    UInt32 unShape=m_vecShapes.size();
+    m_vecShapes.push_back(s_shape);
+    m_vecShapes.back().Visible=true;
+    UpdateBounds(m_vecShapes.back());
+    MarkDirty(m_vecShapes.back().Bounds);
+    /* Insert the shape after those of lower or equal layer */
+    std::vector<UInt32>::iterator it=m_vecOrder.begin();
+    while(it!=m_vecOrder.end() && m_vecShapes[*it].Layer<=s_shape.Layer) ++it;
+    m_vecOrder.insert(it, unShape);
+    return unShape;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::SetCircle(UInt32 un_shape,
+                                const CVector2& c_center,
+                                Real f_radius){
+    SShape& sShape=m_vecShapes[un_shape];
+    if(sShape.Center==c_center && sShape.Radius==f_radius) return;
+    /* Both the old and the new texels must be redrawn */
+    if(sShape.Visible) MarkDirty(sShape.Bounds);
+    sShape.Center=c_center;
+    sShape.Radius=f_radius;
+    UpdateBounds(sShape);
+    if(sShape.Visible) MarkDirty(sShape.Bounds);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::SetPolygon(UInt32 un_shape,
+                                 const std::vector<CVector2>& vec_vertices){
+    SShape& sShape=m_vecShapes[un_shape];
+    if(sShape.Visible) MarkDirty(sShape.Bounds);
+    sShape.Vertices=vec_vertices;
+    UpdateBounds(sShape);
+    if(sShape.Visible) MarkDirty(sShape.Bounds);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::SetColor(UInt32 un_shape,
+                               const CColor& c_color){
+    SShape& sShape=m_vecShapes[un_shape];
+    if(sShape.Color==c_color) return;
+    sShape.Color=c_color;
+    if(sShape.Visible) MarkDirty(sShape.Bounds);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::SetVisible(UInt32 un_shape,
+                                 bool b_visible){
+    SShape& sShape=m_vecShapes[un_shape];
+    if(sShape.Visible==b_visible) return;
+    sShape.Visible=b_visible;
+    MarkDirty(sShape.Bounds);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::UpdateBounds(SShape& s_shape){
+    CVector2 cMin, cMax;
+    if(s_shape.Type==SHAPE_POLYGON){
+        cMin=cMax=s_shape.Vertices[0];
+        for(size_t i=1;i<s_shape.Vertices.size();i++){
+            cMin.Set(Min(cMin.GetX(), s_shape.Vertices[i].GetX()),
+                     Min(cMin.GetY(), s_shape.Vertices[i].GetY()));
+            cMax.Set(Max(cMax.GetX(), s_shape.Vertices[i].GetX()),
+                     Max(cMax.GetY(), s_shape.Vertices[i].GetY()));
+        }
+    }
+    else{
+        cMin=s_shape.Center-CVector2(s_shape.Radius, s_shape.Radius);
+        cMax=s_shape.Center+CVector2(s_shape.Radius, s_shape.Radius);
+    }
+    s_shape.Bounds.MinI=Max<SInt32>(0, Floor((cMin.GetX()-m_cMin.GetX())*m_fInvTexelSize));
+    s_shape.Bounds.MinJ=Max<SInt32>(0, Floor((cMin.GetY()-m_cMin.GetY())*m_fInvTexelSize));
+    s_shape.Bounds.MaxI=Min<SInt32>(m_nTexelsX-1, Floor((cMax.GetX()-m_cMin.GetX())*m_fInvTexelSize));
+    s_shape.Bounds.MaxJ=Min<SInt32>(m_nTexelsY-1, Floor((cMax.GetY()-m_cMin.GetY())*m_fInvTexelSize));
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::MarkDirty(const SRect& s_rect){
+    /* Nothing to do before Init() or outside the raster */
+    if(m_vecTexels.empty() || s_rect.MinI>s_rect.MaxI || s_rect.MinJ>s_rect.MaxJ) return;
+    m_bChanged=true;
+    m_vecDirty.push_back(s_rect);
+    if(m_vecDirty.size()>MAX_DIRTY_RECTS){
+        SRect sUnion=m_vecDirty[0];
+        for(size_t i=1;i<m_vecDirty.size();i++){
+            sUnion.MinI=Min(sUnion.MinI, m_vecDirty[i].MinI);
+            sUnion.MinJ=Min(sUnion.MinJ, m_vecDirty[i].MinJ);
+            sUnion.MaxI=Max(sUnion.MaxI, m_vecDirty[i].MaxI);
+            sUnion.MaxJ=Max(sUnion.MaxJ, m_vecDirty[i].MaxJ);
+        }
+        m_vecDirty.assign(1, sUnion);
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALFFloorRaster::Rasterize(){
+    std::vector<UInt32> vecShapes;
+    for(size_t r=0;r<m_vecDirty.size();r++){
+        const SRect& sRect=m_vecDirty[r];
+        /* Only the visible shapes overlapping the rectangle matter */
+        vecShapes.clear();
+        for(size_t i=0;i<m_vecOrder.size();i++){
+            const SShape& sShape=m_vecShapes[m_vecOrder[i]];
+            if(sShape.Visible &&
+               sShape.Bounds.MinI<=sRect.MaxI && sShape.Bounds.MaxI>=sRect.MinI &&
+               sShape.Bounds.MinJ<=sRect.MaxJ && sShape.Bounds.MaxJ>=sRect.MinJ)
+                vecShapes.push_back(m_vecOrder[i]);
+        }
+        for(SInt32 j=sRect.MinJ;j<=sRect.MaxJ;j++){
+            CColor* pcRow=&m_vecTexels[j*m_nTexelsX];
+            for(SInt32 i=sRect.MinI;i<=sRect.MaxI;i++){
+                /* Sample at the texel center */
+                CVector2 cPosition(m_cMin.GetX()+(i+0.5)*m_fTexelSize,
+                                   m_cMin.GetY()+(j+0.5)*m_fTexelSize);
+                CColor cColor=m_cBackground;
+                for(size_t s=0;s<vecShapes.size();s++){
+                    Covers(m_vecShapes[vecShapes[s]], cPosition, cColor);
+                }
+                pcRow[i]=cColor;
+            }
+        }
+    }
+    m_vecDirty.clear();
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFFloorRaster::Covers(const SShape& s_shape,
+                             const CVector2& c_position,
+                             CColor& c_color) const{
+    switch(s_shape.Type){
+        case SHAPE_CIRCLE: {
+            if(SquareDistance(c_position, s_shape.Center)<Square(s_shape.Radius)){
+                c_color=s_shape.Color;
+                return true;
+            }
+            return false;
+        }
+        case SHAPE_RADIAL_GRADIENT: {
+            Real fSqDistance=SquareDistance(c_position, s_shape.Center);
+            if(fSqDistance<Square(s_shape.Radius)){
+                Real fT=::sqrt(fSqDistance)/s_shape.Radius;
+                c_color=CColor(
+                    static_cast<UInt8>(s_shape.Color.GetRed()*(1.0-fT)+s_shape.OuterColor.GetRed()*fT),
+                    static_cast<UInt8>(s_shape.Color.GetGreen()*(1.0-fT)+s_shape.OuterColor.GetGreen()*fT),
+                    static_cast<UInt8>(s_shape.Color.GetBlue()*(1.0-fT)+s_shape.OuterColor.GetBlue()*fT));
+                return true;
+            }
+            return false;
+        }
+        case SHAPE_POLYGON: {
+            /* Even-odd rule: count the edges crossed by a ray towards +X */
+            const std::vector<CVector2>& vecVertices=s_shape.Vertices;
+            bool bInside=false;
+            for(size_t i=0, j=vecVertices.size()-1;i<vecVertices.size();j=i++){
+                const CVector2& cA=vecVertices[i];
+                const CVector2& cB=vecVertices[j];
+                if((cA.GetY()>c_position.GetY())!=(cB.GetY()>c_position.GetY()) &&
+                   c_position.GetX()<cA.GetX()+(cB.GetX()-cA.GetX())*
+                   (c_position.GetY()-cA.GetY())/(cB.GetY()-cA.GetY()))
+                    bInside=!bInside;
+            }
+            if(bInside) c_color=s_shape.Color;
+            return bInside;
+        }
+    }
+    return false;
+}
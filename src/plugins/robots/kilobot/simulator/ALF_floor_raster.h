@@ -0,0 +1,214 @@
+/**
+ * @file <ALF_floor_raster.h>
+ *
+ * @brief This is the header file of the floor raster of the ARK Loop Function (ALF).
+ * The virtual environment is drawn as a list of shapes, rasterized into a texture
+ * that answers floor color queries with a lookup.
+ *
+ */
+
+#ifndef ALF_FLOOR_RASTER_H
+#define ALF_FLOOR_RASTER_H
+
+#include <argos3/core/utility/math/vector2.h>
+#include <argos3/core/utility/datatypes/color.h>
+
+#include <vector>
+
+
+using namespace argos;
+
+/**
+ * @brief The CALFFloorRaster class
+ */
+
+class CALFFloorRaster
+{
+
+public:
+
+    /**
+     * Class constructor.
+     */
+    CALFFloorRaster();
+
+    /**
+     * Sets the area covered by the raster and clears it.
+     * @param c_min The corner of the area with the smallest coordinates.
+     * @param c_max The corner of the area with the largest coordinates.
+     * @param f_texel_size The side of a texel.
+     * @param c_background The color where no shape is drawn.
+     */
+    void Init(const CVector2& c_min,
+              const CVector2& c_max,
+              Real f_texel_size,
+              const CColor& c_background = CColor::WHITE);
+
+    /**
+     * Returns whether Init() was called.
+     */
+    bool IsEnabled() const {
+        return !m_vecTexels.empty();
+    }
+
+    /**
+     * Adds a filled circle.
+     * Shapes with a higher layer are drawn on top; within a layer, the last added is on top.
+     * @return The id of the shape.
+     */
+    UInt32 AddCircle(const CVector2& c_center,
+                     Real f_radius,
+                     const CColor& c_color,
+                     SInt32 n_layer = 0);
+
+    /**
+     * Adds a filled polygon, whose inside follows the even-odd rule.
+     * @return The id of the shape.
+     */
+    UInt32 AddPolygon(const std::vector<CVector2>& vec_vertices,
+                      const CColor& c_color,
+                      SInt32 n_layer = 0);
+
+    /**
+     * Adds a disc whose color fades linearly from the center to the border.
+     * @return The id of the shape.
+     */
+    UInt32 AddRadialGradient(const CVector2& c_center,
+                             Real f_radius,
+                             const CColor& c_inner_color,
+                             const CColor& c_outer_color,
+                             SInt32 n_layer = 0);
+
+    /**
+     * Moves or resizes a circle or a radial gradient.
+     */
+    void SetCircle(UInt32 un_shape,
+                   const CVector2& c_center,
+                   Real f_radius);
+
+    /**
+     * Changes the vertices of a polygon.
+     */
+    void SetPolygon(UInt32 un_shape,
+                    const std::vector<CVector2>& vec_vertices);
+
+    /**
+     * Changes the color of a shape; for a gradient, the inner color.
+     */
+    void SetColor(UInt32 un_shape,
+                  const CColor& c_color);
+
+    /**
+     * Shows or hides a shape.
+     */
+    void SetVisible(UInt32 un_shape,
+                    bool b_visible);
+
+    /**
+     * Returns whether some texels changed since the last call to ClearChanged().
+     */
+    bool IsChanged() const {
+        return m_bChanged;
+    }
+
+    /**
+     * Forgets the changes, once the floor was refreshed.
+     */
+    void ClearChanged() {
+        m_bChanged = false;
+    }
+
+    /**
+     * Returns the color of the floor at the given position.
+     * The texels touched by the shapes changed since the last call are rasterized first.
+     */
+    const CColor& GetColor(const CVector2& c_position) {
+        if(!m_vecDirty.empty()) Rasterize();
+        SInt32 nI = static_cast<SInt32>((c_position.GetX() - m_cMin.GetX()) * m_fInvTexelSize);
+        SInt32 nJ = static_cast<SInt32>((c_position.GetY() - m_cMin.GetY()) * m_fInvTexelSize);
+        if(nI < 0 || nJ < 0 || nI >= m_nTexelsX || nJ >= m_nTexelsY) return m_cBackground;
+        return m_vecTexels[nJ * m_nTexelsX + nI];
+    }
+
+private:
+
+    enum EShapeType {
+        SHAPE_CIRCLE,
+        SHAPE_POLYGON,
+        SHAPE_RADIAL_GRADIENT
+    };
+
+    /** A rectangle of texels, bounds included */
+    struct SRect {
+        SInt32 MinI, MinJ, MaxI, MaxJ;
+    };
+
+    struct SShape {
+        EShapeType Type;
+        SInt32 Layer;
+        bool Visible;
+        CColor Color;
+        /** Outer color of a gradient */
+        CColor OuterColor;
+        CVector2 Center;
+        Real Radius;
+        std::vector<CVector2> Vertices;
+        /** The texels the shape may cover */
+        SRect Bounds;
+    };
+
+    /**
+     * Adds a shape, and marks its texels dirty.
+     */
+    UInt32 AddShape(const SShape& s_shape);
+
+    /**
+     * Computes the texels the shape may cover.
+     */
+    void UpdateBounds(SShape& s_shape);
+
+    /**
+     * Marks a rectangle of texels to rasterize again.
+     */
+    void MarkDirty(const SRect& s_rect);
+
+    /**
+     * Rasterizes the dirty texels.
+     */
+    void Rasterize();
+
+    /**
+     * Returns whether the shape covers the given position, and its color there.
+     */
+    bool Covers(const SShape& s_shape,
+                const CVector2& c_position,
+                CColor& c_color) const;
+
+    /** The shapes, addressed by id */
+    std::vector<SShape> m_vecShapes;
+
+    /** The shape ids in drawing order */
+    std::vector<UInt32> m_vecOrder;
+
+    /** The rectangles to rasterize again */
+    std::vector<SRect> m_vecDirty;
+
+    /** The texels, row by row */
+    std::vector<CColor> m_vecTexels;
+
+    /** The color where no shape is drawn */
+    CColor m_cBackground;
+
+    /** Corner of the area with the smallest coordinates */
+    CVector2 m_cMin;
+
+    Real m_fTexelSize;
+    Real m_fInvTexelSize;
+    SInt32 m_nTexelsX;
+    SInt32 m_nTexelsY;
+
+    /** Whether some texels changed since the floor was last refreshed */
+    bool m_bChanged;
+};
+
+#endif
@@ -0,0 +1,644 @@
+/**
+ * @file <ALF_network.cpp>
+ *
+ * @brief This is the source file of the networking layer of the ARK Loop Functions (ALF).
+ *
+ */
+
+#include "ALF_network.h"
+#include <argos3/core/utility/configuration/argos_exception.h>
+#include <argos3/core/utility/logging/argos_log.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+/** Size of the frame header, holding the payload size in network byte order */
+static const size_t FRAME_HEADER_SIZE = 4;
+
+/** Larger frames are considered a protocol error */
+static const UInt32 MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+/** Minimum free space in a receive buffer before reading */
+static const size_t MIN_RX_SPACE = 4096;
+
+/** Exchanges between two connection attempts */
+static const UInt32 CONNECT_RETRY_DELAY = 10;
+
+/** The epoll data of the listening socket */
+static const UInt32 LISTEN_EVENT = 0xFFFFFFFF;
+
+/** Maximum number of events handled per epoll_wait() call */
+static const int MAX_EVENTS = 16;
+
+/** The frame header bit of the control frames of the lockstep mode */
+static const UInt32 CONTROL_FLAG = 0x80000000;
+
+/** Control frames hold a type and a value */
+static const UInt32 CONTROL_SIZE = 5;
+static const char CONTROL_HELLO = 1;
+static const char CONTROL_MARKER = 2;
+
+/** Milliseconds between two polls while waiting for the peers */
+static const int SYNC_POLL_INTERVAL = 10;
+
+/****************************************/
+/****************************************/
+
+static UInt32 ReadUInt32(const char* pch_data){
+    UInt32 unValue;
+    ::memcpy(&unValue, pch_data, sizeof(unValue));
+    return ntohl(unValue);
+}
+
+static Real GetMonotonicTime(){
+    timespec tTime;
+    ::clock_gettime(CLOCK_MONOTONIC, &tTime);
+    return tTime.tv_sec+1e-9*tTime.tv_nsec;
+}
+
+/****************************************/
+/****************************************/
+
+CALFNetwork::CALFNetwork():
+    m_nEpoll(-1),
+    m_nListenSocket(-1),
+    m_bClient(false),
+    m_unPort(0),
+    m_unConnectDelay(0),
+    m_unRxPeer(0),
+    m_unLockstepPeriod(0),
+    m_unLockstepPeers(1),
+    m_unRank(0),
+    m_fTimeout(0),
+    m_unStep(0),
+    m_unBoundary(0),
+    m_bBoundary(false){
+}
+
+/****************************************/
+/****************************************/
+
+CALFNetwork::~CALFNetwork(){
+    Close();
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::SetLockstep(UInt32 un_period,
+                              UInt32 un_num_peers,
+                              UInt32 un_rank,
+                              Real f_timeout){
+    if(IsOpen()){
+        THROW_ARGOSEXCEPTION("The lockstep mode must be set before opening the ALF network");
+    }
+    m_unLockstepPeriod=un_period;
+    m_unLockstepPeers=Max<UInt32>(un_num_peers, 1);
+    m_unRank=un_rank;
+    m_fTimeout=f_timeout;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Listen(UInt16 un_port,
+                         const std::string& str_address){
+    if(IsOpen()){
+        THROW_ARGOSEXCEPTION("The ALF network is already open");
+    }
+    sockaddr_in tAddress;
+    ::memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family=AF_INET;
+    tAddress.sin_port=htons(un_port);
+    if(::inet_pton(AF_INET, str_address.c_str(), &tAddress.sin_addr)!=1){
+        THROW_ARGOSEXCEPTION("Invalid IPv4 address \"" << str_address << "\"");
+    }
+    m_nEpoll=::epoll_create1(EPOLL_CLOEXEC);
+    if(m_nEpoll<0){
+        THROW_ARGOSEXCEPTION("Can't create an epoll instance: " << ::strerror(errno));
+    }
+    m_nListenSocket=::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_nListenSocket<0){
+        Close();
+        THROW_ARGOSEXCEPTION("Can't create a socket: " << ::strerror(errno));
+    }
+    int nReuse=1;
+    ::setsockopt(m_nListenSocket, SOL_SOCKET, SO_REUSEADDR, &nReuse, sizeof(nReuse));
+    if(::bind(m_nListenSocket, reinterpret_cast<sockaddr*>(&tAddress), sizeof(tAddress))<0 ||
+       ::listen(m_nListenSocket, SOMAXCONN)<0){
+        int nError=errno;
+        Close();
+        THROW_ARGOSEXCEPTION("Can't listen on port " << un_port << ": " << ::strerror(nError));
+    }
+    epoll_event tEvent;
+    tEvent.events=EPOLLIN;
+    tEvent.data.u32=LISTEN_EVENT;
+    ::epoll_ctl(m_nEpoll, EPOLL_CTL_ADD, m_nListenSocket, &tEvent);
+    m_unPort=un_port;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Connect(const std::string& str_address,
+                          UInt16 un_port){
+    if(IsOpen()){
+        THROW_ARGOSEXCEPTION("The ALF network is already open");
+    }
+    in_addr tAddress;
+    if(::inet_pton(AF_INET, str_address.c_str(), &tAddress)!=1){
+        THROW_ARGOSEXCEPTION("Invalid IPv4 address \"" << str_address << "\"");
+    }
+    m_nEpoll=::epoll_create1(EPOLL_CLOEXEC);
+    if(m_nEpoll<0){
+        THROW_ARGOSEXCEPTION("Can't create an epoll instance: " << ::strerror(errno));
+    }
+    m_bClient=true;
+    m_strAddress=str_address;
+    m_unPort=un_port;
+    StartConnect();
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Close(){
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        if(m_vecPeers[i].Socket>=0) ::close(m_vecPeers[i].Socket);
+    }
+    m_vecPeers.clear();
+    if(m_nListenSocket>=0) ::close(m_nListenSocket);
+    if(m_nEpoll>=0) ::close(m_nEpoll);
+    m_nListenSocket=-1;
+    m_nEpoll=-1;
+    m_bClient=false;
+    m_unConnectDelay=0;
+    m_unRxPeer=0;
+    m_vecRxOrder.clear();
+    m_vecBacklog.clear();
+    m_unStep=0;
+    m_unBoundary=0;
+    m_bBoundary=false;
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFNetwork::GetNumPeers() const{
+    UInt32 unPeers=0;
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        if(IsPeerConnected(i)) ++unPeers;
+    }
+    return unPeers;
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFNetwork::IsPeerConnected(UInt32 un_peer) const{
+    return un_peer<m_vecPeers.size() && m_vecPeers[un_peer].Socket>=0 && !m_vecPeers[un_peer].Connecting && !m_vecPeers[un_peer].Eof;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::StartConnect(){
+    int nSocket=::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(nSocket<0){
+        THROW_ARGOSEXCEPTION("Can't create a socket: " << ::strerror(errno));
+    }
+    sockaddr_in tAddress;
+    ::memset(&tAddress, 0, sizeof(tAddress));
+    tAddress.sin_family=AF_INET;
+    tAddress.sin_port=htons(m_unPort);
+    ::inet_pton(AF_INET, m_strAddress.c_str(), &tAddress.sin_addr);
+    if(::connect(nSocket, reinterpret_cast<sockaddr*>(&tAddress), sizeof(tAddress))==0){
+        AddPeer(nSocket, false);
+    }
+    else if(errno==EINPROGRESS){
+        AddPeer(nSocket, true);
+    }
+    else{
+        ::close(nSocket);
+        m_unConnectDelay=CONNECT_RETRY_DELAY;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+UInt32 CALFNetwork::AddPeer(int n_socket,
+                            bool b_connecting){
+    int nNoDelay=1;
+    ::setsockopt(n_socket, IPPROTO_TCP, TCP_NODELAY, &nNoDelay, sizeof(nNoDelay));
+    /* Reuse a free slot, so that a reconnecting peer keeps its index */
+    UInt32 unPeer=0;
+    while(unPeer<m_vecPeers.size() && m_vecPeers[unPeer].Socket>=0) ++unPeer;
+    if(unPeer==m_vecPeers.size()) m_vecPeers.push_back(SPeer());
+    SPeer& sPeer=m_vecPeers[unPeer];
+    sPeer.Socket=n_socket;
+    sPeer.Connecting=b_connecting;
+    sPeer.Eof=false;
+    sPeer.Rank=0;
+    sPeer.Ranked=false;
+    sPeer.RxOpen=false;
+    sPeer.Rx.clear();
+    sPeer.RxHead=0;
+    sPeer.Tx.clear();
+    sPeer.TxHead=0;
+    /* In lockstep mode, the first frame tells the rank of this ALF */
+    if(IsLockstep()) AppendControl(sPeer.Tx, CONTROL_HELLO, m_unRank);
+    epoll_event tEvent;
+    /* A connecting socket becomes writable once connected */
+    tEvent.events=b_connecting ? EPOLLOUT : EPOLLIN;
+    tEvent.data.u32=unPeer;
+    ::epoll_ctl(m_nEpoll, EPOLL_CTL_ADD, n_socket, &tEvent);
+    if(!b_connecting && !m_vecBacklog.empty()){
+        sPeer.Tx.insert(sPeer.Tx.end(), m_vecBacklog.begin(), m_vecBacklog.end());
+        m_vecBacklog.clear();
+    }
+    return unPeer;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::ClosePeer(UInt32 un_peer){
+    SPeer& sPeer=m_vecPeers[un_peer];
+    ::epoll_ctl(m_nEpoll, EPOLL_CTL_DEL, sPeer.Socket, NULL);
+    ::close(sPeer.Socket);
+    sPeer.Socket=-1;
+    sPeer.Connecting=false;
+    sPeer.Eof=false;
+    sPeer.RxOpen=false;
+    sPeer.Rx.clear();
+    sPeer.RxHead=0;
+    sPeer.Tx.clear();
+    sPeer.TxHead=0;
+    if(m_bClient) m_unConnectDelay=CONNECT_RETRY_DELAY;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::AcceptPeers(){
+    while(true){
+        int nSocket=::accept4(m_nListenSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(nSocket<0) return;
+        AddPeer(nSocket, false);
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::ReadPeer(UInt32 un_peer){
+    SPeer& sPeer=m_vecPeers[un_peer];
+    while(true){
+        /* Keep some room at the end of the buffer; it only grows to the largest frame */
+        size_t unUsed=sPeer.Rx.size();
+        if(sPeer.Rx.capacity()-unUsed<MIN_RX_SPACE){
+            sPeer.Rx.reserve(Max<size_t>(2*sPeer.Rx.capacity(), unUsed+MIN_RX_SPACE));
+        }
+        size_t unSpace=sPeer.Rx.capacity()-unUsed;
+        sPeer.Rx.resize(unUsed+unSpace);
+        ssize_t nReceived=::recv(sPeer.Socket, &sPeer.Rx[unUsed], unSpace, 0);
+        sPeer.Rx.resize(unUsed+(nReceived>0 ? nReceived : 0));
+        if(nReceived>0) continue;
+        if(nReceived<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) return;
+        if(nReceived<0 && errno==EINTR) continue;
+        /* Closed by the other side: keep what it sent until it is received */
+        if(nReceived==0 && sPeer.Rx.size()>sPeer.RxHead){
+            ::epoll_ctl(m_nEpoll, EPOLL_CTL_DEL, sPeer.Socket, NULL);
+            sPeer.Eof=true;
+            return;
+        }
+        ClosePeer(un_peer);
+        return;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::WritePeer(UInt32 un_peer){
+    SPeer& sPeer=m_vecPeers[un_peer];
+    while(sPeer.TxHead<sPeer.Tx.size()){
+        ssize_t nSent=::send(sPeer.Socket, &sPeer.Tx[sPeer.TxHead], sPeer.Tx.size()-sPeer.TxHead, MSG_NOSIGNAL);
+        if(nSent>0){
+            sPeer.TxHead+=nSent;
+            continue;
+        }
+        if(nSent<0 && errno==EINTR) continue;
+        if(nSent<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) break;
+        ClosePeer(un_peer);
+        return;
+    }
+    /* What the socket did not take is sent at the next exchange */
+    if(sPeer.TxHead==sPeer.Tx.size()){
+        sPeer.Tx.clear();
+        sPeer.TxHead=0;
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Exchange(){
+    if(!IsOpen()) return;
+    /* The frames of the last exchange were read: drop them, and move the partial ones to the front */
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        SPeer& sPeer=m_vecPeers[i];
+        if(sPeer.RxHead>0){
+            sPeer.Rx.erase(sPeer.Rx.begin(), sPeer.Rx.begin()+sPeer.RxHead);
+            sPeer.RxHead=0;
+        }
+        if(sPeer.Eof && sPeer.Rx.empty()) ClosePeer(i);
+    }
+    m_unRxPeer=0;
+    PollEvents(0);
+    /* Outside lockstep mode, Receive() goes through the peers by slot */
+    if(!IsLockstep()){
+        m_vecRxOrder.resize(m_vecPeers.size());
+        for(UInt32 i=0;i<m_vecPeers.size();i++) m_vecRxOrder[i]=i;
+    }
+    Flush();
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::PollEvents(int n_timeout){
+    /* The delay only runs while the client is disconnected */
+    if(m_bClient && m_unConnectDelay>0 && --m_unConnectDelay==0){
+        StartConnect();
+    }
+    epoll_event ptEvents[MAX_EVENTS];
+    int nEvents;
+    do{
+        nEvents=::epoll_wait(m_nEpoll, ptEvents, MAX_EVENTS, n_timeout);
+        /* Only the first wait may block */
+        n_timeout=0;
+        for(int e=0;e<nEvents;e++){
+            UInt32 unPeer=ptEvents[e].data.u32;
+            if(unPeer==LISTEN_EVENT){
+                AcceptPeers();
+                continue;
+            }
+            SPeer& sPeer=m_vecPeers[unPeer];
+            if(sPeer.Socket<0) continue;
+            if(sPeer.Connecting){
+                int nError=0;
+                socklen_t unLength=sizeof(nError);
+                ::getsockopt(sPeer.Socket, SOL_SOCKET, SO_ERROR, &nError, &unLength);
+                if(nError!=0){
+                    /* The other ALF is not listening yet */
+                    ClosePeer(unPeer);
+                    continue;
+                }
+                sPeer.Connecting=false;
+                epoll_event tEvent;
+                tEvent.events=EPOLLIN;
+                tEvent.data.u32=unPeer;
+                ::epoll_ctl(m_nEpoll, EPOLL_CTL_MOD, sPeer.Socket, &tEvent);
+                if(!m_vecBacklog.empty()){
+                    sPeer.Tx.insert(sPeer.Tx.end(), m_vecBacklog.begin(), m_vecBacklog.end());
+                    m_vecBacklog.clear();
+                }
+                continue;
+            }
+            ReadPeer(unPeer);
+        }
+    }while(nEvents==MAX_EVENTS);
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFNetwork::BeginStep(){
+    if(!IsLockstep()){
+        Exchange();
+        return true;
+    }
+    /* Skip what the last boundary left unread, so that the next messages start after its markers */
+    SFrame sFrame;
+    while(Receive(sFrame));
+    Exchange();
+    m_bBoundary=(m_unStep%m_unLockstepPeriod==0);
+    ++m_unStep;
+    if(!m_bBoundary) return false;
+    WaitForPeers();
+    ++m_unBoundary;
+    return true;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::EndStep(){
+    if(m_bBoundary){
+        /* The marker follows all the messages of the ticks since the last boundary */
+        for(UInt32 i=0;i<m_vecPeers.size();i++){
+            if(IsPeerConnected(i))
+                AppendControl(m_vecPeers[i].Tx, CONTROL_MARKER, m_unBoundary-1);
+        }
+        m_bBoundary=false;
+    }
+    Flush();
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::WaitForPeers(){
+    UInt32 unExpected=m_bClient ? 1 : m_unLockstepPeers;
+    Real fStart=GetMonotonicTime();
+    while(true){
+        /* The first boundary waits for the peers to connect, the next ones for their markers */
+        bool bReady=true;
+        UInt32 unPeers=0;
+        for(UInt32 i=0;i<m_vecPeers.size();i++){
+            SPeer& sPeer=m_vecPeers[i];
+            if(sPeer.Socket<0 || sPeer.Connecting) continue;
+            UInt32 unMarker=0;
+            bool bMarker=ScanPeer(i, unMarker);
+            if(sPeer.Socket<0) continue;
+            ++unPeers;
+            if(!sPeer.Ranked || (m_unBoundary>0 && !bMarker)){
+                /* A peer that closed the connection will not send what is missing */
+                if(sPeer.Eof){
+                    THROW_ARGOSEXCEPTION("An ALF peer disconnected during a lockstep experiment");
+                }
+                bReady=false;
+            }
+            else if(m_unBoundary>0){
+                if(unMarker!=m_unBoundary-1){
+                    THROW_ARGOSEXCEPTION("ALF peer " << i << " is out of step: boundary " << unMarker << " received, " << m_unBoundary-1 << " expected; check that all the ALFs use the same lockstep period");
+                }
+            }
+        }
+        if(m_unBoundary>0 && unPeers<unExpected){
+            THROW_ARGOSEXCEPTION("An ALF peer disconnected during a lockstep experiment");
+        }
+        if(unPeers>unExpected){
+            THROW_ARGOSEXCEPTION(unPeers << " ALF peers connected, but the lockstep mode expects " << unExpected);
+        }
+        if(bReady && unPeers==unExpected) break;
+        if(m_fTimeout>0 && GetMonotonicTime()-fStart>m_fTimeout){
+            THROW_ARGOSEXCEPTION("Timeout while waiting for the ALF peers at lockstep boundary " << m_unBoundary);
+        }
+        Flush();
+        PollEvents(SYNC_POLL_INTERVAL);
+    }
+    /* Receive() goes through the peers by rank, up to their marker */
+    std::vector<std::pair<UInt32,UInt32> > vecRanks;
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        if(m_vecPeers[i].Socket<0 || m_vecPeers[i].Connecting) continue;
+        m_vecPeers[i].RxOpen=(m_unBoundary>0);
+        vecRanks.push_back(std::make_pair(m_vecPeers[i].Rank, i));
+    }
+    std::sort(vecRanks.begin(), vecRanks.end());
+    m_vecRxOrder.resize(vecRanks.size());
+    for(UInt32 i=0;i<vecRanks.size();i++) m_vecRxOrder[i]=vecRanks[i].second;
+    m_unRxPeer=0;
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFNetwork::ScanPeer(UInt32 un_peer,
+                           UInt32& un_marker){
+    SPeer& sPeer=m_vecPeers[un_peer];
+    size_t unPos=sPeer.RxHead;
+    while(sPeer.Rx.size()-unPos>=FRAME_HEADER_SIZE){
+        UInt32 unHeader=ReadUInt32(&sPeer.Rx[unPos]);
+        UInt32 unSize=unHeader&~CONTROL_FLAG;
+        if(unSize>MAX_FRAME_SIZE){
+            LOGERR << "[ALF] Dropping the connection to peer " << un_peer << ": invalid frame size " << unSize << std::endl;
+            ClosePeer(un_peer);
+            return false;
+        }
+        if(sPeer.Rx.size()-unPos-FRAME_HEADER_SIZE<unSize) return false;
+        if((unHeader&CONTROL_FLAG) && unSize==CONTROL_SIZE){
+            const char* pchControl=&sPeer.Rx[unPos+FRAME_HEADER_SIZE];
+            if(pchControl[0]==CONTROL_MARKER){
+                un_marker=ReadUInt32(pchControl+1);
+                return true;
+            }
+            /* The announcement is the first frame of a peer */
+            if(pchControl[0]==CONTROL_HELLO && unPos==sPeer.RxHead){
+                sPeer.Rank=ReadUInt32(pchControl+1);
+                sPeer.Ranked=true;
+                sPeer.RxHead+=FRAME_HEADER_SIZE+unSize;
+            }
+        }
+        unPos+=FRAME_HEADER_SIZE+unSize;
+    }
+    return false;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Flush(){
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        if(IsPeerConnected(i) && !m_vecPeers[i].Tx.empty())
+            WritePeer(i);
+    }
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::AppendFrame(std::vector<char>& vec_buffer,
+                              const void* pt_data,
+                              UInt32 un_size){
+    UInt32 unHeader=htonl(un_size);
+    const char* pchHeader=reinterpret_cast<const char*>(&unHeader);
+    const char* pchData=static_cast<const char*>(pt_data);
+    vec_buffer.insert(vec_buffer.end(), pchHeader, pchHeader+FRAME_HEADER_SIZE);
+    vec_buffer.insert(vec_buffer.end(), pchData, pchData+un_size);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::AppendControl(std::vector<char>& vec_buffer,
+                                UInt8 un_type,
+                                UInt32 un_value){
+    UInt32 unHeader=htonl(CONTROL_FLAG|CONTROL_SIZE);
+    UInt32 unValue=htonl(un_value);
+    const char* pchHeader=reinterpret_cast<const char*>(&unHeader);
+    const char* pchValue=reinterpret_cast<const char*>(&unValue);
+    vec_buffer.insert(vec_buffer.end(), pchHeader, pchHeader+FRAME_HEADER_SIZE);
+    vec_buffer.push_back(un_type);
+    vec_buffer.insert(vec_buffer.end(), pchValue, pchValue+sizeof(unValue));
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::Send(const void* pt_data,
+                       UInt32 un_size){
+    bool bSent=false;
+    for(UInt32 i=0;i<m_vecPeers.size();i++){
+        if(IsPeerConnected(i)){
+            AppendFrame(m_vecPeers[i].Tx, pt_data, un_size);
+            bSent=true;
+        }
+    }
+    if(!bSent) AppendFrame(m_vecBacklog, pt_data, un_size);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFNetwork::SendTo(UInt32 un_peer,
+                         const void* pt_data,
+                         UInt32 un_size){
+    if(IsPeerConnected(un_peer))
+        AppendFrame(m_vecPeers[un_peer].Tx, pt_data, un_size);
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFNetwork::Receive(SFrame& s_frame){
+    for(;m_unRxPeer<m_vecRxOrder.size();m_unRxPeer++){
+        UInt32 unPeer=m_vecRxOrder[m_unRxPeer];
+        if(unPeer>=m_vecPeers.size()) continue;
+        SPeer& sPeer=m_vecPeers[unPeer];
+        /* In lockstep mode, the messages after the marker belong to the next boundary */
+        while(sPeer.Socket>=0 && (!IsLockstep() || sPeer.RxOpen) &&
+              sPeer.Rx.size()-sPeer.RxHead>=FRAME_HEADER_SIZE){
+            UInt32 unHeader=ReadUInt32(&sPeer.Rx[sPeer.RxHead]);
+            UInt32 unSize=unHeader&~CONTROL_FLAG;
+            if(unSize>MAX_FRAME_SIZE){
+                LOGERR << "[ALF] Dropping the connection to peer " << unPeer << ": invalid frame size " << unSize << std::endl;
+                ClosePeer(unPeer);
+                break;
+            }
+            /* Partial frames are completed by the next exchanges */
+            if(sPeer.Rx.size()-sPeer.RxHead<FRAME_HEADER_SIZE+unSize) break;
+            const char* pchData=&sPeer.Rx[sPeer.RxHead+FRAME_HEADER_SIZE];
+            sPeer.RxHead+=FRAME_HEADER_SIZE+unSize;
+            if(unHeader&CONTROL_FLAG){
+                if(unSize==CONTROL_SIZE && pchData[0]==CONTROL_MARKER) sPeer.RxOpen=false;
+                continue;
+            }
+            s_frame.Peer=unPeer;
+            s_frame.Data=pchData;
+            s_frame.Size=unSize;
+            return true;
+        }
+    }
+    return false;
+}
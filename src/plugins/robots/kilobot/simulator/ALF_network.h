@@ -0,0 +1,308 @@
+/**
+ * @file <ALF_network.h>
+ *
+ * @brief This is the header file of the networking layer of the ARK Loop Functions (ALF).
+ * It connects ALFs running in different ARGoS instances over TCP, without ever blocking:
+ * all the socket operations of a tick happen in Exchange(), driven by epoll, and the
+ * messages are length-prefixed frames reassembled in a receive buffer per peer.
+ *
+ * In lockstep mode, the ALFs also agree on the ticks at which they exchange their state:
+ * every period ticks, each ALF sends a boundary marker after the messages of the tick, and
+ * at the next boundary it waits for the markers of all its peers before receiving what was
+ * sent up to them. The messages thus arrive one period late, but always at the same tick,
+ * whatever the relative speed of the ARGoS instances, and each instance only waits when it
+ * runs more than one period ahead of the slowest one.
+ *
+ */
+
+#ifndef ALF_NETWORK_H
+#define ALF_NETWORK_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <string>
+#include <vector>
+
+
+using namespace argos;
+
+/**
+ * @brief The CALFNetwork class
+ */
+
+class CALFNetwork
+{
+
+public:
+
+    /** A received message */
+    struct SFrame {
+        /** The peer that sent the message */
+        UInt32 Peer;
+        /** The payload, valid until the next call to Exchange() */
+        const char* Data;
+        /** The size of the payload */
+        UInt32 Size;
+    };
+
+    /**
+     * Class constructor.
+     */
+    CALFNetwork();
+
+    /**
+     * Class destructor.
+     * It closes all the sockets.
+     */
+    ~CALFNetwork();
+
+    /**
+     * Enables the lockstep mode; it must be called before Listen() or Connect().
+     * @param un_period The ticks between two boundaries; 0 disables the lockstep mode.
+     * @param un_num_peers The peers to wait for: the ALFs connecting to a listening ALF, or 1.
+     * @param un_rank The rank of this ALF. Received messages are returned by increasing rank of
+     * their sender, so the peers of an ALF should have different ranks.
+     * @param f_timeout The seconds to wait for the peers before giving up; 0 waits forever.
+     */
+    void SetLockstep(UInt32 un_period,
+                     UInt32 un_num_peers = 1,
+                     UInt32 un_rank = 0,
+                     Real f_timeout = 0);
+
+    /**
+     * Returns whether the lockstep mode is enabled.
+     */
+    bool IsLockstep() const {
+        return m_unLockstepPeriod > 0;
+    }
+
+    /**
+     * Starts accepting peers on the given port and local IPv4 address.
+     * The peers are accepted by Exchange(), so this call does not wait for them.
+     * @throws CARGoSException If the port cannot be opened.
+     */
+    void Listen(UInt16 un_port,
+                const std::string& str_address = "0.0.0.0");
+
+    /**
+     * Starts connecting to the ALF listening at the given address.
+     * The connection is completed by Exchange(), and tried again while the other ALF is not listening.
+     * @throws CARGoSException If the address is not valid.
+     */
+    void Connect(const std::string& str_address,
+                 UInt16 un_port);
+
+    /**
+     * Closes all the sockets and drops the pending messages.
+     */
+    void Close();
+
+    /**
+     * Returns whether Listen() or Connect() was called.
+     */
+    bool IsOpen() const {
+        return m_nEpoll >= 0;
+    }
+
+    /**
+     * Returns the number of connected peers.
+     */
+    UInt32 GetNumPeers() const;
+
+    /**
+     * Returns the number of peer slots, connected or not.
+     * Peer indices are below this number, and a reconnecting peer may reuse a slot.
+     */
+    UInt32 GetNumPeerSlots() const {
+        return m_vecPeers.size();
+    }
+
+    /**
+     * Returns whether the peer in the given slot is connected.
+     */
+    bool IsPeerConnected(UInt32 un_peer) const;
+
+    /**
+     * Does the socket operations of a tick: accepts or connects peers, reads all the
+     * available data and sends the queued messages. It never blocks.
+     */
+    void Exchange();
+
+    /**
+     * Starts a tick: does an Exchange() and, in lockstep mode at a boundary, waits for the
+     * markers of all the peers.
+     * @return true if Receive() may return messages at this tick: always outside lockstep mode,
+     * only at the boundaries in lockstep mode.
+     * @throws CARGoSException If a peer disconnected, is out of step, or the wait timed out.
+     */
+    bool BeginStep();
+
+    /**
+     * Ends a tick: queues the boundary marker in lockstep mode and sends the queued messages.
+     */
+    void EndStep();
+
+    /**
+     * Sends the queued messages, without reading.
+     * It does nothing if no message is queued.
+     */
+    void Flush();
+
+    /**
+     * Queues a message for all the peers.
+     * Messages queued while no peer is connected are delivered to the first peer that connects.
+     */
+    void Send(const void* pt_data,
+              UInt32 un_size);
+
+    /**
+     * Queues a message for all the peers.
+     */
+    void Send(const std::string& str_data) {
+        Send(str_data.data(), str_data.size());
+    }
+
+    /**
+     * Queues a message for the given peer.
+     */
+    void SendTo(UInt32 un_peer,
+                const void* pt_data,
+                UInt32 un_size);
+
+    /**
+     * Returns the next complete message received by the last Exchange(), peer by peer.
+     * @param s_frame Filled with the message.
+     * @return false if there is no more message.
+     */
+    bool Receive(SFrame& s_frame);
+
+private:
+
+    struct SPeer {
+        /** The socket, or -1 if the slot is free */
+        int Socket;
+        /** Whether the connection is still being established */
+        bool Connecting;
+        /** Whether the peer closed the connection; what it sent can still be received */
+        bool Eof;
+        /** In lockstep mode, the rank announced by the peer, and whether it was announced */
+        UInt32 Rank;
+        bool Ranked;
+        /** In lockstep mode, whether Receive() may return messages up to the next marker */
+        bool RxOpen;
+        /** Received data; the bytes before RxHead were consumed */
+        std::vector<char> Rx;
+        size_t RxHead;
+        /** Data to send; the bytes before TxHead were sent */
+        std::vector<char> Tx;
+        size_t TxHead;
+    };
+
+    /**
+     * Opens a non-blocking connection to the listening ALF.
+     */
+    void StartConnect();
+
+    /**
+     * Accepts all the pending peers.
+     */
+    void AcceptPeers();
+
+    /**
+     * Waits for socket events at most the given milliseconds, and handles them.
+     */
+    void PollEvents(int n_timeout);
+
+    /**
+     * In lockstep mode, waits until all the peers are connected and sent the marker
+     * of the previous boundary.
+     */
+    void WaitForPeers();
+
+    /**
+     * Handles the announcement of a peer at the front of its receive buffer, and looks
+     * for the first marker after it.
+     * @param un_marker Set to the index of the marker, if any.
+     * @return true if a complete marker was received.
+     */
+    bool ScanPeer(UInt32 un_peer,
+                  UInt32& un_marker);
+
+    /**
+     * Reads all the available data from a peer.
+     */
+    void ReadPeer(UInt32 un_peer);
+
+    /**
+     * Sends as much queued data as the socket of a peer takes.
+     */
+    void WritePeer(UInt32 un_peer);
+
+    /**
+     * Adds a connected or connecting socket, and returns its slot.
+     */
+    UInt32 AddPeer(int n_socket,
+                   bool b_connecting);
+
+    /**
+     * Closes the connection to a peer and frees its slot.
+     */
+    void ClosePeer(UInt32 un_peer);
+
+    /**
+     * Appends a frame to a buffer.
+     */
+    static void AppendFrame(std::vector<char>& vec_buffer,
+                            const void* pt_data,
+                            UInt32 un_size);
+
+    /**
+     * Appends a control frame of the lockstep mode to a buffer.
+     */
+    static void AppendControl(std::vector<char>& vec_buffer,
+                              UInt8 un_type,
+                              UInt32 un_value);
+
+    /** The epoll instance, or -1 */
+    int m_nEpoll;
+
+    /** The listening socket, or -1 */
+    int m_nListenSocket;
+
+    /** Whether this ALF connects to another one */
+    bool m_bClient;
+
+    /** Address of the ALF to connect to */
+    std::string m_strAddress;
+    UInt16 m_unPort;
+
+    /** Exchanges to wait before trying to connect again */
+    UInt32 m_unConnectDelay;
+
+    /** The peers */
+    std::vector<SPeer> m_vecPeers;
+
+    /** Messages queued while no peer was connected */
+    std::vector<char> m_vecBacklog;
+
+    /** The peer whose messages Receive() is returning, as a position in m_vecRxOrder */
+    UInt32 m_unRxPeer;
+
+    /** The order in which Receive() goes through the peers */
+    std::vector<UInt32> m_vecRxOrder;
+
+    /** Lockstep mode: the period, the peers to wait for, the rank and the timeout */
+    UInt32 m_unLockstepPeriod;
+    UInt32 m_unLockstepPeers;
+    UInt32 m_unRank;
+    Real m_fTimeout;
+
+    /** Lockstep mode: the ticks started, and the boundaries passed */
+    UInt32 m_unStep;
+    UInt32 m_unBoundary;
+
+    /** Lockstep mode: whether the current tick is a boundary */
+    bool m_bBoundary;
+};
+
+#endif
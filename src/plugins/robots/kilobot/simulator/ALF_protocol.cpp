@@ -0,0 +1,100 @@
+/**
+ * @file <ALF_protocol.cpp>
+ *
+ * @brief This is the source file of the message format exchanged by the ARK Loop Functions (ALF).
+ *
+ */
+
+#include "ALF_protocol.h"
+
+#include <cstring>
+
+/** Current version of the protocol; messages of other versions are rejected */
+static const UInt8 PROTOCOL_VERSION = 1;
+
+static const UInt8 MAGIC_0 = 'A';
+static const UInt8 MAGIC_1 = 'K';
+
+static const UInt32 HEADER_SIZE = 12;
+
+/****************************************/
+/****************************************/
+
+CALFMessageWriter::CALFMessageWriter():
+    m_unFieldsOffset(HEADER_SIZE),
+    m_unFieldSize(0){
+    Start(0);
+}
+
+/****************************************/
+/****************************************/
+
+void CALFMessageWriter::Start(UInt8 un_type,
+                              UInt16 un_num_entries,
+                              UInt8 un_field_size){
+    UInt32 unBitsSize=(un_num_entries+7)/8;
+    UInt32 unBodySize=unBitsSize+un_num_entries*un_field_size;
+    /* The buffer keeps its capacity from one message to the next */
+    m_vecBuffer.assign(HEADER_SIZE+unBodySize, 0);
+    m_vecBuffer[0]=MAGIC_0;
+    m_vecBuffer[1]=MAGIC_1;
+    m_vecBuffer[2]=PROTOCOL_VERSION;
+    m_vecBuffer[3]=un_type;
+    m_vecBuffer[4]=un_num_entries>>8;
+    m_vecBuffer[5]=un_num_entries&0xFF;
+    m_vecBuffer[6]=un_field_size;
+    m_vecBuffer[8]=unBodySize>>24;
+    m_vecBuffer[9]=(unBodySize>>16)&0xFF;
+    m_vecBuffer[10]=(unBodySize>>8)&0xFF;
+    m_vecBuffer[11]=unBodySize&0xFF;
+    m_unFieldsOffset=HEADER_SIZE+unBitsSize;
+    m_unFieldSize=un_field_size;
+}
+
+/****************************************/
+/****************************************/
+
+void CALFMessageWriter::SetBit(UInt16 un_entry,
+                               bool b_value){
+    char& chByte=m_vecBuffer[HEADER_SIZE+(un_entry>>3)];
+    if(b_value)
+        chByte|=1<<(un_entry&7);
+    else
+        chByte&=~(1<<(un_entry&7));
+}
+
+/****************************************/
+/****************************************/
+
+CALFMessageReader::CALFMessageReader():
+    m_unType(0),
+    m_unNumEntries(0),
+    m_unFieldSize(0),
+    m_punBits(NULL),
+    m_punFields(NULL){
+}
+
+/****************************************/
+/****************************************/
+
+bool CALFMessageReader::Parse(const char* pch_data,
+                              UInt32 un_size){
+    const UInt8* punData=reinterpret_cast<const UInt8*>(pch_data);
+    if(un_size<HEADER_SIZE ||
+       punData[0]!=MAGIC_0 || punData[1]!=MAGIC_1 ||
+       punData[2]!=PROTOCOL_VERSION)
+        return false;
+    UInt16 unNumEntries=(punData[4]<<8)|punData[5];
+    UInt8 unFieldSize=punData[6];
+    UInt32 unBodySize=(static_cast<UInt32>(punData[8])<<24)|(punData[9]<<16)|(punData[10]<<8)|punData[11];
+    UInt32 unBitsSize=(unNumEntries+7)/8;
+    if(unBodySize!=un_size-HEADER_SIZE ||
+       unBodySize!=unBitsSize+static_cast<UInt32>(unNumEntries)*unFieldSize)
+        return false;
+    m_unType=punData[3];
+    m_unNumEntries=unNumEntries;
+    m_unFieldSize=unFieldSize;
+    m_punBits=punData+HEADER_SIZE;
+    m_punFields=m_punBits+unBitsSize;
+    return true;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file <ALF_protocol.h>
+ *
+ * @brief This is the header file of the message format exchanged by the ARK Loop Functions (ALF)
+ * over CALFNetwork to keep the state of their virtual areas in sync.
+ *
+ * A message is a 12-byte header followed by a body; integers are in network byte order.
+ * Header: the magic bytes "AK", the protocol version, the message type, the number of
+ * entries (UInt16), the size of the fields of an entry, a reserved byte, and the size
+ * of the body (UInt32).
+ * Body: one bit per entry, packed LSB first, followed by the fields of each entry.
+ * An entry is usually a virtual area, whose bit tells whether it is completed.
+ *
+ */
+
+#ifndef ALF_PROTOCOL_H
+#define ALF_PROTOCOL_H
+
+#include <argos3/core/utility/datatypes/datatypes.h>
+
+#include <vector>
+
+
+using namespace argos;
+
+/** Types of the messages exchanged by the ALFs */
+enum EALFMessageType {
+    /** Setup of the areas: the fields of each entry are defined by the experiment */
+    ALF_MSG_INIT = 1,
+    /** Request for the setup, without entries */
+    ALF_MSG_INIT_REQUEST = 2,
+    /** Acknowledgement of the setup, without entries */
+    ALF_MSG_INIT_ACK = 3,
+    /** State of the areas: the bit of an entry is set for a completed or freed area */
+    ALF_MSG_AREA_STATE = 4,
+    /** Tasks fulfilled by the sender: the bit of an entry is set for a fulfilled task */
+    ALF_MSG_TASK_STATE = 5,
+    /** Areas selected by the sender: the bit of an entry is set for a selected area */
+    ALF_MSG_AREA_SELECTION = 6
+};
+
+/**
+ * @brief The CALFMessageWriter class builds a message in its own buffer
+ */
+
+class CALFMessageWriter
+{
+
+public:
+
+    /**
+     * Class constructor.
+     */
+    CALFMessageWriter();
+
+    /**
+     * Starts a new message, with all the bits and fields cleared.
+     * @param un_type The message type.
+     * @param un_num_entries The number of entries.
+     * @param un_field_size The size in bytes of the fields of an entry.
+     */
+    void Start(UInt8 un_type,
+               UInt16 un_num_entries = 0,
+               UInt8 un_field_size = 0);
+
+    /**
+     * Sets the bit of an entry.
+     */
+    void SetBit(UInt16 un_entry,
+                bool b_value = true);
+
+    /**
+     * Returns the fields of an entry, to be filled.
+     */
+    UInt8* GetFields(UInt16 un_entry) {
+        return reinterpret_cast<UInt8*>(&m_vecBuffer[m_unFieldsOffset + un_entry * m_unFieldSize]);
+    }
+
+    /**
+     * Returns the message.
+     */
+    const char* GetData() const {
+        return &m_vecBuffer[0];
+    }
+
+    /**
+     * Returns the size of the message.
+     */
+    UInt32 GetSize() const {
+        return m_vecBuffer.size();
+    }
+
+private:
+
+    std::vector<char> m_vecBuffer;
+
+    UInt32 m_unFieldsOffset;
+    UInt8 m_unFieldSize;
+};
+
+/**
+ * @brief The CALFMessageReader class reads a message in place, without copying it
+ */
+
+class CALFMessageReader
+{
+
+public:
+
+    /**
+     * Class constructor.
+     */
+    CALFMessageReader();
+
+    /**
+     * Checks a message and points the reader to it.
+     * The message must stay valid while the reader is used.
+     * @return false if the data is not a message of this protocol version, or is truncated.
+     */
+    bool Parse(const char* pch_data,
+               UInt32 un_size);
+
+    /**
+     * Returns the message type.
+     */
+    UInt8 GetType() const {
+        return m_unType;
+    }
+
+    /**
+     * Returns the number of entries.
+     */
+    UInt16 GetNumEntries() const {
+        return m_unNumEntries;
+    }
+
+    /**
+     * Returns the size in bytes of the fields of an entry.
+     */
+    UInt8 GetFieldSize() const {
+        return m_unFieldSize;
+    }
+
+    /**
+     * Returns the bit of an entry; false beyond the last entry.
+     */
+    bool GetBit(UInt16 un_entry) const {
+        return un_entry < m_unNumEntries && (m_punBits[un_entry >> 3] >> (un_entry & 7)) & 1;
+    }
+
+    /**
+     * Returns the fields of an entry.
+     */
+    const UInt8* GetFields(UInt16 un_entry) const {
+        return m_punFields + un_entry * m_unFieldSize;
+    }
+
+private:
+
+    UInt8 m_unType;
+    UInt16 m_unNumEntries;
+    UInt8 m_unFieldSize;
+    const UInt8* m_punBits;
+    const UInt8* m_punFields;
+};
+
+#endif
@@ -36,7 +36,10 @@ namespace argos {
                       KILOBOT_MAX_TORQUE,
                       KILOBOT_INTERPIN_DISTANCE,
                       c_entity.GetConfigurationNode()),
-      m_fCurrentWheelVelocity(m_cWheeledEntity.GetWheelVelocities()) {
+      m_fCurrentWheelVelocity(m_cWheeledEntity.GetWheelVelocities()),
+      m_bStopped(false) {
+      m_sLightAnchorPose.Valid = false;
+      m_sCommAnchorPose.Valid = false;
       /* Parse the XML file to check if friction was specified */
       cpFloat fFriction = KILOBOT_FRICTION;
       if(c_entity.GetConfigurationNode() &&
@@ -92,6 +95,9 @@ namespace argos {
    void CDynamics2DKilobotModel::Reset() {
       CDynamics2DSingleBodyObjectModel::Reset();
       m_cDiffSteering.Reset();
+      m_bStopped = false;
+      m_sLightAnchorPose.Valid = false;
+      m_sCommAnchorPose.Valid = false;
    }
 
    /****************************************/
@@ -103,10 +109,13 @@ namespace argos {
          (m_fCurrentWheelVelocity[KILOBOT_RIGHT_WHEEL] != 0.0f)) {
          m_cDiffSteering.SetWheelVelocity(m_fCurrentWheelVelocity[KILOBOT_LEFT_WHEEL],
                                           m_fCurrentWheelVelocity[KILOBOT_RIGHT_WHEEL]);
+         m_bStopped = false;
       }
-      else {
-         /* No, we don't want to move - zero all speeds */
+      else if(!m_bStopped) {
+         /* No, we don't want to move - zero all speeds, which stay zero until
+            the wheels turn again */
          m_cDiffSteering.Reset();
+         m_bStopped = true;
       }
    }
 
@@ -114,28 +123,40 @@ namespace argos {
    /****************************************/
 
    void CDynamics2DKilobotModel::UpdateLightAnchor(SAnchor& s_anchor) {
-      /* Start in origin, put anchor in offset */
-      s_anchor.Position = s_anchor.OffsetPosition;
-      /* Rotate anchor by body orientation in world */
-      s_anchor.Orientation.FromAngleAxis(CRadians(GetBody()->a), CVector3::Z);
-      s_anchor.Position.Rotate(s_anchor.Orientation);
-      /* Translate anchor by body position in world */
-      s_anchor.Position.SetX(s_anchor.Position.GetX() + GetBody()->p.x);
-      s_anchor.Position.SetY(s_anchor.Position.GetY() + GetBody()->p.y);
+      UpdateAnchor(s_anchor, m_sLightAnchorPose);
    }
 
    /****************************************/
    /****************************************/
 
    void CDynamics2DKilobotModel::UpdateCommAnchor(SAnchor& s_anchor) {
-      /* Start in origin, put anchor in offset */
-      s_anchor.Position = s_anchor.OffsetPosition;
-      /* Rotate anchor by body orientation in world */
-      s_anchor.Orientation.FromAngleAxis(CRadians(GetBody()->a), CVector3::Z);
-      s_anchor.Position.Rotate(s_anchor.Orientation);
-      /* Translate anchor by body position in world */
-      s_anchor.Position.SetX(s_anchor.Position.GetX() + GetBody()->p.x);
-      s_anchor.Position.SetY(s_anchor.Position.GetY() + GetBody()->p.y);
+      UpdateAnchor(s_anchor, m_sCommAnchorPose);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CDynamics2DKilobotModel::UpdateAnchor(SAnchor& s_anchor,
+                                              SAnchorPose& s_pose) {
+      /* Nothing to do if the body did not move, e.g. a still kilobot that
+         was not pushed */
+      const cpBody* ptBody = GetBody();
+      if(s_pose.Valid &&
+         s_pose.Position.x == ptBody->p.x &&
+         s_pose.Position.y == ptBody->p.y &&
+         s_pose.Angle == ptBody->a) {
+         return;
+      }
+      s_pose.Position = ptBody->p;
+      s_pose.Angle = ptBody->a;
+      s_pose.Valid = true;
+      /* Rotate the offset by the body orientation in world, then translate it
+         by the body position in world */
+      const CVector3& cOffset = s_anchor.OffsetPosition;
+      s_anchor.Position.Set(ptBody->p.x + cOffset.GetX() * ptBody->rot.x - cOffset.GetY() * ptBody->rot.y,
+                            ptBody->p.y + cOffset.GetX() * ptBody->rot.y + cOffset.GetY() * ptBody->rot.x,
+                            cOffset.GetZ());
+      s_anchor.Orientation.FromAngleAxis(CRadians(ptBody->a), CVector3::Z);
    }
 
    /****************************************/
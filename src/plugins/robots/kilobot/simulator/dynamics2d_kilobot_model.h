@@ -33,6 +33,21 @@ namespace argos {
       void UpdateLightAnchor(SAnchor& s_anchor);
       void UpdateCommAnchor(SAnchor& s_anchor);
 
+   private:
+
+      /**
+       * The pose of the body when an anchor was last placed. The anchors of a
+       * kilobot that did not move since are left as they are.
+       */
+      struct SAnchorPose {
+         cpVect Position;
+         cpFloat Angle;
+         bool Valid;
+      };
+
+      void UpdateAnchor(SAnchor& s_anchor,
+                        SAnchorPose& s_pose);
+
    private:
 
       CKilobotEntity& m_cKilobotEntity;
@@ -41,6 +56,12 @@ namespace argos {
       CDynamics2DDifferentialSteeringControl m_cDiffSteering;
 
       const Real* m_fCurrentWheelVelocity;
+
+      /** Whether the wheels were already still at the last update */
+      bool m_bStopped;
+
+      SAnchorPose m_sLightAnchorPose;
+      SAnchorPose m_sCommAnchorPose;
    };
 
 }
@@ -0,0 +1,265 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_collisions.cpp>
+ */
+
+#include "kilobot_collisions.h"
+#include "kilobot_measures.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace argos {
+
+   static const Real EPSILON = 1e-9;
+
+   /** Distance between the centers of two kilobots in contact */
+   static const Real KILOBOT_CONTACT_DISTANCE = KILOBOT_RADIUS + KILOBOT_RADIUS;
+
+   /****************************************/
+   /****************************************/
+
+   bool ClipSegmentToSlab(Real f_start,
+                          Real f_delta,
+                          Real f_min,
+                          Real f_max,
+                          Real& f_t_min,
+                          Real& f_t_max) {
+      if(Abs(f_delta) < EPSILON) {
+         return f_start >= f_min && f_start <= f_max;
+      }
+      Real fT0 = (f_min - f_start) / f_delta;
+      Real fT1 = (f_max - f_start) / f_delta;
+      if(fT0 > fT1) {
+         Real fTmp = fT0; fT0 = fT1; fT1 = fTmp;
+      }
+      if(fT0 > f_t_min) f_t_min = fT0;
+      if(fT1 < f_t_max) f_t_max = fT1;
+      return f_t_min <= f_t_max;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool IntersectSegmentWithCylinder(const CVector3& c_start,
+                                     const CVector3& c_delta,
+                                     Real f_radius,
+                                     Real f_bottom,
+                                     Real f_top,
+                                     Real& f_t_on_ray) {
+      Real fTMin = 0.0, fTMax = 1.0;
+      Real fA = c_delta.GetX() * c_delta.GetX() + c_delta.GetY() * c_delta.GetY();
+      Real fB = 2.0 * (c_start.GetX() * c_delta.GetX() + c_start.GetY() * c_delta.GetY());
+      Real fC = c_start.GetX() * c_start.GetX() + c_start.GetY() * c_start.GetY() - f_radius * f_radius;
+      if(fA < EPSILON) {
+         /* Vertical segment */
+         if(fC > 0.0) return false;
+      }
+      else {
+         Real fDiscriminant = fB * fB - 4.0 * fA * fC;
+         if(fDiscriminant < 0.0) return false;
+         Real fRoot = Sqrt(fDiscriminant);
+         fTMin = Max<Real>(fTMin, (-fB - fRoot) / (2.0 * fA));
+         fTMax = Min<Real>(fTMax, (-fB + fRoot) / (2.0 * fA));
+         if(fTMin > fTMax) return false;
+      }
+      if(!ClipSegmentToSlab(c_start.GetZ(), c_delta.GetZ(), f_bottom, f_top, fTMin, fTMax)) return false;
+      f_t_on_ray = fTMin;
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool IntersectSegmentWithBox(const CVector3& c_start,
+                                const CVector3& c_delta,
+                                const CVector2& c_half_size,
+                                Real f_height,
+                                Real& f_t_on_ray) {
+      Real fTMin = 0.0, fTMax = 1.0;
+      if(!ClipSegmentToSlab(c_start.GetX(), c_delta.GetX(), -c_half_size.GetX(), c_half_size.GetX(), fTMin, fTMax) ||
+         !ClipSegmentToSlab(c_start.GetY(), c_delta.GetY(), -c_half_size.GetY(), c_half_size.GetY(), fTMin, fTMax) ||
+         !ClipSegmentToSlab(c_start.GetZ(), c_delta.GetZ(), 0.0, f_height, fTMin, fTMax))
+         return false;
+      f_t_on_ray = fTMin;
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool PenetrateBox(Real f_x,
+                     Real f_y,
+                     Real f_cos,
+                     Real f_sin,
+                     Real f_half_x,
+                     Real f_half_y,
+                     Real& f_dx,
+                     Real& f_dy) {
+      /* Work in the frame of the box */
+      Real fLocalX =  f_x * f_cos + f_y * f_sin;
+      Real fLocalY = -f_x * f_sin + f_y * f_cos;
+      Real fClosestX = std::min(std::max(fLocalX, -f_half_x), f_half_x);
+      Real fClosestY = std::min(std::max(fLocalY, -f_half_y), f_half_y);
+      Real fOutX = fLocalX - fClosestX;
+      Real fOutY = fLocalY - fClosestY;
+      Real fDistance2 = fOutX * fOutX + fOutY * fOutY;
+      if(fDistance2 >= KILOBOT_RADIUS * KILOBOT_RADIUS) {
+         return false;
+      }
+      Real fMoveX, fMoveY;
+      if(fDistance2 > 0.0) {
+         /* The center is outside the box: move away from the closest point */
+         Real fDistance = std::sqrt(fDistance2);
+         fMoveX = fOutX * (KILOBOT_RADIUS - fDistance) / fDistance;
+         fMoveY = fOutY * (KILOBOT_RADIUS - fDistance) / fDistance;
+      }
+      else {
+         /* The center is inside the box: move out through the closest side */
+         Real fDepthX = f_half_x - Abs(fLocalX);
+         Real fDepthY = f_half_y - Abs(fLocalY);
+         fMoveX = fMoveY = 0.0;
+         if(fDepthX < fDepthY) {
+            fMoveX = (fLocalX < 0.0 ? -1.0 : 1.0) * (fDepthX + KILOBOT_RADIUS);
+         }
+         else {
+            fMoveY = (fLocalY < 0.0 ? -1.0 : 1.0) * (fDepthY + KILOBOT_RADIUS);
+         }
+      }
+      f_dx = fMoveX * f_cos - fMoveY * f_sin;
+      f_dy = fMoveX * f_sin + fMoveY * f_cos;
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotDiscGrid::CKilobotDiscGrid() :
+      m_unCellsX(0),
+      m_unCellsY(0) {}
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotDiscGrid::Sort(const Real* pf_x,
+                               const Real* pf_y,
+                               UInt32 un_num) {
+      m_vecOrder.resize(un_num);
+      m_vecSortedCell.resize(un_num);
+      m_vecX.resize(un_num);
+      m_vecY.resize(un_num);
+      m_vecDeltaX.resize(un_num);
+      m_vecDeltaY.resize(un_num);
+      if(un_num == 0) return;
+      /* The bounding rectangle of the bodies */
+      Real fMinX = pf_x[0], fMaxX = pf_x[0];
+      Real fMinY = pf_y[0], fMaxY = pf_y[0];
+      for(UInt32 i = 1; i < un_num; ++i) {
+         fMinX = std::min(fMinX, pf_x[i]);
+         fMaxX = std::max(fMaxX, pf_x[i]);
+         fMinY = std::min(fMinY, pf_y[i]);
+         fMaxY = std::max(fMaxY, pf_y[i]);
+      }
+      /*
+       * Cells at least as large as a kilobot, so that only the neighboring cells need
+       * to be checked; scattered swarms get larger cells to bound the grid size
+       */
+      Real fCellSize = KILOBOT_CONTACT_DISTANCE;
+      Real fMaxCells = 16.0 * un_num + 4096.0;
+      while((std::floor((fMaxX - fMinX) / fCellSize) + 1.0) *
+            (std::floor((fMaxY - fMinY) / fCellSize) + 1.0) > fMaxCells) {
+         fCellSize *= 2.0;
+      }
+      m_unCellsX = static_cast<UInt32>((fMaxX - fMinX) / fCellSize) + 1;
+      m_unCellsY = static_cast<UInt32>((fMaxY - fMinY) / fCellSize) + 1;
+      /* Counting sort of the bodies by cell */
+      m_vecCell.resize(un_num);
+      m_vecCellStart.assign(m_unCellsX * m_unCellsY + 1, 0);
+      for(UInt32 i = 0; i < un_num; ++i) {
+         UInt32 unX = std::min(static_cast<UInt32>((pf_x[i] - fMinX) / fCellSize), m_unCellsX - 1);
+         UInt32 unY = std::min(static_cast<UInt32>((pf_y[i] - fMinY) / fCellSize), m_unCellsY - 1);
+         m_vecCell[i] = unY * m_unCellsX + unX;
+         ++m_vecCellStart[m_vecCell[i] + 1];
+      }
+      for(size_t c = 1; c < m_vecCellStart.size(); ++c) {
+         m_vecCellStart[c] += m_vecCellStart[c - 1];
+      }
+      m_vecCellNext.assign(m_vecCellStart.begin(), m_vecCellStart.end() - 1);
+      for(UInt32 i = 0; i < un_num; ++i) {
+         UInt32 k = m_vecCellNext[m_vecCell[i]]++;
+         m_vecOrder[k] = i;
+         m_vecSortedCell[k] = m_vecCell[i];
+         m_vecX[k] = pf_x[i];
+         m_vecY[k] = pf_y[i];
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotDiscGrid::Separate() {
+      const UInt32 unNum = m_vecOrder.size();
+      std::fill(m_vecDeltaX.begin(), m_vecDeltaX.end(), 0.0);
+      std::fill(m_vecDeltaY.begin(), m_vecDeltaY.end(), 0.0);
+      for(UInt32 k = 0; k < unNum; ++k) {
+         /*
+          * Each pair is visited once: the rest of the cell and the cell on the right,
+          * then the three cells of the row above. The cells of a row are contiguous
+          * in the sorted bodies, so both are ranges.
+          */
+         UInt32 unCell = m_vecSortedCell[k];
+         UInt32 unX = unCell % m_unCellsX;
+         UInt32 unY = unCell / m_unCellsX;
+         SeparateRange(k, k + 1,
+                       m_vecCellStart[unX + 1 < m_unCellsX ? unCell + 2 : unCell + 1]);
+         if(unY + 1 < m_unCellsY) {
+            UInt32 unAbove = unCell + m_unCellsX;
+            SeparateRange(k,
+                          m_vecCellStart[unX > 0 ? unAbove - 1 : unAbove],
+                          m_vecCellStart[unX + 1 < m_unCellsX ? unAbove + 2 : unAbove + 1]);
+         }
+      }
+      Real* pfX = m_vecX.data();
+      Real* pfY = m_vecY.data();
+      const Real* pfDeltaX = m_vecDeltaX.data();
+      const Real* pfDeltaY = m_vecDeltaY.data();
+      for(UInt32 k = 0; k < unNum; ++k) {
+         pfX[k] += pfDeltaX[k];
+         pfY[k] += pfDeltaY[k];
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotDiscGrid::SeparateRange(UInt32 un_body,
+                                        UInt32 un_from,
+                                        UInt32 un_to) {
+      const Real* pfX = m_vecX.data();
+      const Real* pfY = m_vecY.data();
+      Real* pfDeltaX = m_vecDeltaX.data();
+      Real* pfDeltaY = m_vecDeltaY.data();
+      Real fX = pfX[un_body];
+      Real fY = pfY[un_body];
+      for(UInt32 l = un_from; l < un_to; ++l) {
+         Real fDX = pfX[l] - fX;
+         Real fDY = pfY[l] - fY;
+         Real fDistance2 = fDX * fDX + fDY * fDY;
+         if(fDistance2 >= KILOBOT_CONTACT_DISTANCE * KILOBOT_CONTACT_DISTANCE) continue;
+         Real fNormalX = 1.0, fNormalY = 0.0;
+         Real fDistance = std::sqrt(fDistance2);
+         if(fDistance > 0.0) {
+            fNormalX = fDX / fDistance;
+            fNormalY = fDY / fDistance;
+         }
+         Real fMove = (KILOBOT_CONTACT_DISTANCE - fDistance) * 0.5;
+         pfDeltaX[un_body] -= fNormalX * fMove;
+         pfDeltaY[un_body] -= fNormalY * fMove;
+         pfDeltaX[l] += fNormalX * fMove;
+         pfDeltaY[l] += fNormalY * fMove;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_collisions.h>
+ *
+ * @brief This file provides the geometry shared by the kilobot physics models and
+ * the light field: segment tests against upright bodies, the separation of a
+ * kilobot from a box, and the separation of overlapping kilobots through a uniform grid.
+ */
+
+#ifndef KILOBOT_COLLISIONS_H
+#define KILOBOT_COLLISIONS_H
+
+namespace argos {
+   class CKilobotDiscGrid;
+}
+
+#include <argos3/core/utility/math/vector2.h>
+#include <argos3/core/utility/math/vector3.h>
+
+#include <vector>
+
+namespace argos {
+
+   /**
+    * Restricts [f_t_min,f_t_max] to the part of the segment f_start+t*f_delta
+    * that lies in [f_min,f_max] along one axis.
+    * @return false if nothing is left.
+    */
+   bool ClipSegmentToSlab(Real f_start,
+                          Real f_delta,
+                          Real f_min,
+                          Real f_max,
+                          Real& f_t_min,
+                          Real& f_t_max);
+
+   /**
+    * Intersects the segment c_start+t*c_delta, t in [0,1], with an upright cylinder
+    * whose axis is the Z axis.
+    * @param f_t_on_ray Set to the first point of the segment in the cylinder.
+    */
+   bool IntersectSegmentWithCylinder(const CVector3& c_start,
+                                     const CVector3& c_delta,
+                                     Real f_radius,
+                                     Real f_bottom,
+                                     Real f_top,
+                                     Real& f_t_on_ray);
+
+   /**
+    * Intersects the segment c_start+t*c_delta, t in [0,1], with a box whose base
+    * is centered in the origin.
+    * @param f_t_on_ray Set to the first point of the segment in the box.
+    */
+   bool IntersectSegmentWithBox(const CVector3& c_start,
+                                const CVector3& c_delta,
+                                const CVector2& c_half_size,
+                                Real f_height,
+                                Real& f_t_on_ray);
+
+   /**
+    * Checks whether a kilobot body overlaps a box rotated around the Z axis.
+    * If it does, (f_dx,f_dy) is set to the shortest move that separates them.
+    * @param f_x The X coordinate of the center of the body, relative to the center of the box.
+    * @param f_y The Y coordinate of the center of the body, relative to the center of the box.
+    * @param f_cos The cosine of the rotation of the box.
+    * @param f_sin The sine of the rotation of the box.
+    * @param f_half_x Half the size of the box on its X axis.
+    * @param f_half_y Half the size of the box on its Y axis.
+    */
+   bool PenetrateBox(Real f_x,
+                     Real f_y,
+                     Real f_cos,
+                     Real f_sin,
+                     Real f_half_x,
+                     Real f_half_y,
+                     Real& f_dx,
+                     Real& f_dy);
+
+   /****************************************/
+   /****************************************/
+
+   /**
+    * Separates overlapping kilobot bodies. The centers of the bodies are sorted by
+    * cell of a uniform grid as large as a kilobot, so that each pair of neighbors is
+    * found in a few ranges of the sorted arrays, then moved apart.
+    */
+   class CKilobotDiscGrid {
+
+   public:
+
+      CKilobotDiscGrid();
+
+      /**
+       * Sorts the bodies by cell.
+       * @param pf_x The X coordinates of the centers of the bodies.
+       * @param pf_y The Y coordinates of the centers of the bodies.
+       * @param un_num The number of bodies.
+       */
+      void Sort(const Real* pf_x,
+                const Real* pf_y,
+                UInt32 un_num);
+
+      /**
+       * Moves apart the sorted bodies that overlap, each making half of the move.
+       * Several calls give tighter crowds; the bodies keep the cell they were sorted in.
+       */
+      void Separate();
+
+      inline UInt32 GetNumBodies() const {
+         return m_vecOrder.size();
+      }
+
+      /**
+       * Returns the position given to Sort() of a sorted body.
+       */
+      inline UInt32 GetIndex(UInt32 un_sorted) const {
+         return m_vecOrder[un_sorted];
+      }
+
+      /**
+       * Returns the X coordinates of the sorted bodies.
+       */
+      inline Real* GetX() {
+         return m_vecX.data();
+      }
+
+      /**
+       * Returns the Y coordinates of the sorted bodies.
+       */
+      inline Real* GetY() {
+         return m_vecY.data();
+      }
+
+   private:
+
+      void SeparateRange(UInt32 un_body,
+                         UInt32 un_from,
+                         UInt32 un_to);
+
+   private:
+
+      std::vector<UInt32> m_vecCell;
+      std::vector<UInt32> m_vecCellStart;
+      std::vector<UInt32> m_vecCellNext;
+      std::vector<UInt32> m_vecOrder;
+      std::vector<UInt32> m_vecSortedCell;
+      std::vector<Real> m_vecX;
+      std::vector<Real> m_vecY;
+      std::vector<Real> m_vecDeltaX;
+      std::vector<Real> m_vecDeltaY;
+      UInt32 m_unCellsX;
+      UInt32 m_unCellsY;
+   };
+
+}
+
+#endif
@@ -36,6 +36,14 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   void CKilobotCommunicationDefaultActuator::SetTxPeriod(Real f_period) {
+      CCI_KilobotCommunicationActuator::SetTxPeriod(f_period);
+      m_pcCommEntity->SetTxPeriod(f_period);
+   }
+
+   /****************************************/
+   /****************************************/
+
    REGISTER_ACTUATOR(CKilobotCommunicationDefaultActuator,
                      "kilobot_communication", "default",
                      "Carlo Pinciroli [ilpincy@gmail.com]",
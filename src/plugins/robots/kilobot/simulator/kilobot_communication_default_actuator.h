@@ -31,6 +31,7 @@ namespace argos {
       virtual void Update();
       virtual void Reset();
       virtual void SetMessage(message_t* pt_msg);
+      virtual void SetTxPeriod(Real f_period);
 
    private:
 
@@ -3,6 +3,7 @@
 #include "kilobot_communication_entity.h"
 #include "kilobot_communication_medium.h"
 #include <argos3/core/simulator/simulator.h>
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
 #include <argos3/core/simulator/entity/composable_entity.h>
 #include <argos3/core/simulator/entity/controllable_entity.h>
 
@@ -75,6 +76,7 @@ namespace argos {
       CVector3 cVectorRobotToMessage;
       /* Update status of last delivery */
       m_bMessageSent = (m_pcCommEntity->GetTxStatus() == CKilobotCommunicationEntity::TX_SUCCESS);
+      m_unMessagesSent = m_bMessageSent ? m_pcCommEntity->GetTxCount() : 0;
       /* Delete old readings */
       m_tPackets.clear();
       /*
@@ -86,18 +88,18 @@ namespace argos {
          sPacket.Message = ptOHCMsg;
          sPacket.Distance.low_gain = 0;
          sPacket.Distance.high_gain = 0;
+         sPacket.Time = CPhysicsEngine::GetSimulationClockTick();
          m_tPackets.push_back(sPacket);
       }
       /*
        * Kilobot messages
        */
       /* Get list of communicating RABs */
-      const CSet<CKilobotCommunicationEntity*,SEntityComparator>& setComms = m_pcMedium->GetKilobotsCommunicatingWith(*m_pcCommEntity);
+      CKilobotCommunicationMedium::SInbox sInbox = m_pcMedium->GetInbox(*m_pcCommEntity);
       /* Go through communicating RABs and create packets */
-      for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it = setComms.begin();
-          it != setComms.end(); ++it) {
+      for(UInt32 i = 0; i < sInbox.Size; ++i) {
          /* Create a reference to the Kilobot communication entity to process */
-         CKilobotCommunicationEntity& cOtherCommEntity = **it;
+         CKilobotCommunicationEntity& cOtherCommEntity = *sInbox.Messages[i].Sender;
          /* Add ray if requested */
          if(m_bShowRays) {
             m_pcControllableEntity->AddCheckedRay(false,
@@ -112,6 +114,8 @@ namespace argos {
                                                cOtherCommEntity.GetPosition()) * 1000.0;
          if(m_pcRNG)
             sPacket.Distance.high_gain += m_pcRNG->Gaussian(m_fDistanceNoiseStdDev);
+         /* Set message arrival time */
+         sPacket.Time = sInbox.Messages[i].Time;
          /* Add message to the list */
          m_tPackets.push_back(sPacket);
       } /* communicating neighbors loop */
@@ -123,6 +127,7 @@ namespace argos {
    void CKilobotCommunicationDefaultSensor::Reset() {
       m_tPackets.clear();
       m_bMessageSent = false;
+      m_unMessagesSent = 0;
    }
 
    /****************************************/
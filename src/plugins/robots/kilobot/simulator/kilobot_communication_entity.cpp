@@ -27,6 +27,8 @@ namespace argos {
       m_fTxRange(f_range),
       m_pcEntityBody(&c_entity_body),
       m_eTxStatus(TX_NONE),
+      m_fTxPeriod(0.0),
+      m_unTxCount(0),
       m_pcMedium(NULL) {
       Disable();
       SetInitPosition(s_anchor.Position);
@@ -40,13 +42,17 @@ namespace argos {
 
    void CKilobotCommunicationEntity::Reset() {
       m_eTxStatus = TX_NONE;
+      m_unTxCount = 0;
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationEntity::Update() {
-      if(m_eTxStatus == TX_SUCCESS) m_eTxStatus = TX_NONE;
+      if(m_eTxStatus == TX_SUCCESS) {
+         m_eTxStatus = TX_NONE;
+         m_unTxCount = 0;
+      }
       SetPosition(m_psAnchor->Position);
       SetOrientation(m_psAnchor->Orientation);
    }
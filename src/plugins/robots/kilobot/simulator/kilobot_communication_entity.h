@@ -74,6 +74,22 @@ namespace argos {
          m_eTxStatus = e_tx_status;
       }
 
+      inline Real GetTxPeriod() const {
+         return m_fTxPeriod;
+      }
+
+      inline void SetTxPeriod(Real f_period) {
+         m_fTxPeriod = f_period;
+      }
+
+      inline UInt32 GetTxCount() const {
+         return m_unTxCount;
+      }
+
+      inline void SetTxCount(UInt32 un_count) {
+         m_unTxCount = un_count;
+      }
+
       inline const message_t* GetTxMessage() const {
          return m_ptMessage;
       }
@@ -110,6 +126,12 @@ namespace argos {
       /** Current message transmission status */
       ETxStatus m_eTxStatus;
 
+      /** Time between two transmissions of the message */
+      Real m_fTxPeriod;
+
+      /** Number of times the message was sent in the last step */
+      UInt32 m_unTxCount;
+
       /** The message to send */
       message_t* m_ptMessage;
 
@@ -3,30 +3,62 @@
 #include <argos3/core/simulator/entity/embodied_entity.h>
 #include <argos3/core/simulator/simulator.h>
 #include <argos3/core/simulator/space/space.h>
-#include <argos3/core/simulator/space/positional_indices/grid.h>
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
 #include <argos3/core/utility/configuration/argos_exception.h>
 #include <argos3/core/utility/logging/argos_log.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_measures.h>
-#include <unordered_map>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
 
 namespace argos {
 
    /****************************************/
    /****************************************/
 
+   /* Side of a tile, in bucket grid cells */
+   static const UInt32 TILE_CELLS = 8;
+
+   /****************************************/
+   /****************************************/
+
    CKilobotCommunicationMedium::CKilobotCommunicationMedium() :
-      m_pcKilobotIndex(NULL),
-      m_pcGridUpdateOperation(NULL),
-      m_pcRNG(NULL),
+      m_unMaxRx(KILOBOT_MAX_RX),
+      m_eRxPolicy(RX_POLICY_ID),
+      m_bCellsSorted(false),
+      m_fCellSize(0.0),
+      m_unCellsX(0),
+      m_unCellsY(0),
+      m_unTilesX(0),
+      m_unThreads(1),
+      m_unUpdateCounter(0),
+      m_unBusyWorkers(0),
+      m_unNextTile(0),
+      m_bQuitWorkers(false),
       m_fRxProb(0.0),
-      m_bIgnoreConflicts(false)
+      m_bIgnoreConflicts(false),
+      m_bTimestamps(false),
+      m_eChannelModel(CHANNEL_PROBABILISTIC),
+      m_pcCsmaRNG(NULL),
+      m_fCsmaTxTime(0.0035),
+      m_fCsmaSlotTime(0.000128),
+      m_unCsmaMinWindow(256),
+      m_unCsmaMaxWindow(4096),
+      m_fCsmaClock(0.0)
    {
+      pthread_mutex_init(&m_tWorkerMutex, NULL);
+      pthread_cond_init(&m_tWorkerStartCond, NULL);
+      pthread_cond_init(&m_tWorkerDoneCond, NULL);
    }
 
    /****************************************/
    /****************************************/
 
    CKilobotCommunicationMedium::~CKilobotCommunicationMedium() {
+      pthread_cond_destroy(&m_tWorkerDoneCond);
+      pthread_cond_destroy(&m_tWorkerStartCond);
+      pthread_mutex_destroy(&m_tWorkerMutex);
    }
 
    /****************************************/
@@ -41,22 +73,73 @@ namespace argos {
          TConfigurationNode& tArena = GetNode(CSimulator::GetInstance().GetConfigurationRoot(), "arena");
          GetNodeAttribute(tArena, "size", cArenaSize);
          GetNodeAttributeOrDefault(tArena, "center", cArenaCenter, cArenaCenter);
-         /* Create the positional index for embodied entities */
-         UInt32 unXCells = Ceil(cArenaSize.GetX() / (KILOBOT_RADIUS+KILOBOT_RADIUS));
-         UInt32 unYCells = Ceil(cArenaSize.GetY() / (KILOBOT_RADIUS+KILOBOT_RADIUS));
-         CGrid<CKilobotCommunicationEntity>* pcGrid = new CGrid<CKilobotCommunicationEntity>(
-            cArenaCenter - cArenaSize * 0.5f, cArenaCenter + cArenaSize * 0.5f,
-            unXCells, unYCells, 1);
-         m_pcGridUpdateOperation = new CKilobotCommunicationEntityGridEntityUpdater(*pcGrid);
-         pcGrid->SetUpdateEntityOperation(m_pcGridUpdateOperation);
-         m_pcKilobotIndex = pcGrid;
+         /* The bucket grid covers the arena; its cells are sized at the first update */
+         m_cArenaMin.Set(cArenaCenter.GetX() - cArenaSize.GetX() * 0.5,
+                         cArenaCenter.GetY() - cArenaSize.GetY() * 0.5);
+         m_cArenaSize.Set(cArenaSize.GetX(), cArenaSize.GetY());
          /* Set probability of receiving a message */
          GetNodeAttributeOrDefault(t_tree, "message_drop_prob", m_fRxProb, m_fRxProb);
          m_fRxProb = 1.0 - m_fRxProb;
-         /* Create random number generator */
-         m_pcRNG = CRandom::CreateRNG("argos");
          /* Whether or not to ignore conflicts due to channel congestion */
          GetNodeAttributeOrDefault(t_tree, "ignore_conflicts", m_bIgnoreConflicts, m_bIgnoreConflicts);
+         /* Size of the inboxes and what to keep when they overflow */
+         GetNodeAttributeOrDefault(t_tree, "max_rx", m_unMaxRx, m_unMaxRx);
+         if(m_unMaxRx == 0 || m_unMaxRx > KILOBOT_MAX_RX) {
+            THROW_ARGOSEXCEPTION("The attribute \"max_rx\" must be between 1 and " << KILOBOT_MAX_RX <<
+                                 ", the number of messages a Kilobot can process in a step; " <<
+                                 m_unMaxRx << " given");
+         }
+         std::string strRxPolicy = "id";
+         GetNodeAttributeOrDefault(t_tree, "rx_policy", strRxPolicy, strRxPolicy);
+         if(strRxPolicy == "id") {
+            m_eRxPolicy = RX_POLICY_ID;
+         }
+         else if(strRxPolicy == "distance") {
+            m_eRxPolicy = RX_POLICY_DISTANCE;
+         }
+         else if(strRxPolicy == "random") {
+            m_eRxPolicy = RX_POLICY_RANDOM;
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Unknown receive policy \"" << strRxPolicy << "\", allowed values are \"id\", \"distance\" and \"random\"");
+         }
+         /* Whether to deliver messages at their time within the step */
+         GetNodeAttributeOrDefault(t_tree, "timestamps", m_bTimestamps, m_bTimestamps);
+         /* Channel model */
+         std::string strModel = "probabilistic";
+         GetNodeAttributeOrDefault(t_tree, "model", strModel, strModel);
+         if(strModel == "probabilistic") {
+            m_eChannelModel = CHANNEL_PROBABILISTIC;
+         }
+         else if(strModel == "csma") {
+            m_eChannelModel = CHANNEL_CSMA;
+            GetNodeAttributeOrDefault(t_tree, "tx_time", m_fCsmaTxTime, m_fCsmaTxTime);
+            GetNodeAttributeOrDefault(t_tree, "slot_time", m_fCsmaSlotTime, m_fCsmaSlotTime);
+            GetNodeAttributeOrDefault(t_tree, "min_window", m_unCsmaMinWindow, m_unCsmaMinWindow);
+            GetNodeAttributeOrDefault(t_tree, "max_window", m_unCsmaMaxWindow, m_unCsmaMaxWindow);
+            if(m_fCsmaTxTime <= 0.0 || m_fCsmaSlotTime <= 0.0) {
+               THROW_ARGOSEXCEPTION("The attributes \"tx_time\" and \"slot_time\" must be greater than zero");
+            }
+            if(m_unCsmaMinWindow == 0 || m_unCsmaMaxWindow < m_unCsmaMinWindow) {
+               THROW_ARGOSEXCEPTION("The attribute \"min_window\" must be greater than zero and not greater than \"max_window\"");
+            }
+            m_pcCsmaRNG = CRandom::CreateRNG("argos");
+         }
+         else {
+            THROW_ARGOSEXCEPTION("Unknown channel model \"" << strModel << "\", allowed values are \"probabilistic\" and \"csma\"");
+         }
+         /* Start the worker threads */
+         GetNodeAttributeOrDefault(t_tree, "threads", m_unThreads, m_unThreads);
+         if(m_unThreads == 0) m_unThreads = 1;
+         m_bQuitWorkers = false;
+         m_vecWorkers.resize(m_unThreads - 1);
+         for(size_t i = 0; i < m_vecWorkers.size(); ++i) {
+            int nError = pthread_create(&m_vecWorkers[i], NULL, &StartWorkerThread, this);
+            if(nError != 0) {
+               m_vecWorkers.resize(i);
+               THROW_ARGOSEXCEPTION("Can't create worker thread: " << ::strerror(nError));
+            }
+         }
       }
       catch(CARGoSException& ex) {
          THROW_ARGOSEXCEPTION_NESTED("Error in initialization of the range-and-bearing medium", ex);
@@ -67,6 +150,11 @@ namespace argos {
    /****************************************/
 
    void CKilobotCommunicationMedium::PostSpaceInit() {
+      /* Make room for a message to every entity, so that setting them
+         never allocates memory */
+      m_vecOHCMessages.resize(GetSpace().GetEntityVector().size());
+      m_vecOHCShared.resize(m_vecOHCMessages.size(), -1);
+      m_vecOHCValid.resize(m_vecOHCMessages.size() / 64 + 1, 0);
       Update();
    }
 
@@ -74,188 +162,586 @@ namespace argos {
    /****************************************/
 
    void CKilobotCommunicationMedium::Reset() {
-      /* Reset positional index of Kilobot entities */
-      m_pcKilobotIndex->Reset();
-      /* Delete adjacency matrix */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         it->second.clear();
-      }
+      /* Delete received messages */
+      std::fill(m_vecInboxSizes.begin(), m_vecInboxSizes.end(), 0);
+      /* Delete overhead controller messages */
+      ClearOHCMessages();
+      /* Stop the transmissions in progress */
+      ClearCsma();
+      m_fCsmaClock = 0.0;
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationMedium::Destroy() {
-      delete m_pcKilobotIndex;
-      if(m_pcGridUpdateOperation != NULL)
-         delete m_pcGridUpdateOperation;
+      /* Stop the worker threads */
+      pthread_mutex_lock(&m_tWorkerMutex);
+      m_bQuitWorkers = true;
+      pthread_cond_broadcast(&m_tWorkerStartCond);
+      pthread_mutex_unlock(&m_tWorkerMutex);
+      for(size_t i = 0; i < m_vecWorkers.size(); ++i) {
+         pthread_join(m_vecWorkers[i], NULL);
+      }
+      m_vecWorkers.clear();
+      m_vecEntities.clear();
+      m_vecDenseIndices.clear();
+      m_bCellsSorted = false;
+      m_vecInboxes.clear();
+      m_vecInboxSizes.clear();
+      m_vecCsmaStates.clear();
+      ClearCsma();
+      m_vecOHCMessages.clear();
+      m_vecOHCShared.clear();
+      m_vecOHCValid.clear();
+      m_vecSharedOHCMessages.clear();
+      m_vecFreeSharedOHCMessages.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateGrid() {
+      UInt32 unEntities = m_vecEntities.size();
+      /* Cache the entity data, and find the largest range */
+      m_vecPositions.resize(unEntities);
+      m_vecSqTxRanges.resize(unEntities);
+      m_vecTxPeriods.resize(unEntities);
+      m_vecTxAttempts.resize(unEntities);
+      Real fMaxRange = KILOBOT_RADIUS + KILOBOT_RADIUS;
+      for(UInt32 i = 0; i < unEntities; ++i) {
+         CKilobotCommunicationEntity& cKilobot = *m_vecEntities[i];
+         m_vecPositions[i].Set(cKilobot.GetPosition().GetX(),
+                               cKilobot.GetPosition().GetY());
+         m_vecSqTxRanges[i] = Square(cKilobot.GetTxRange());
+         m_vecTxPeriods[i] = cKilobot.GetTxPeriod();
+         m_vecTxAttempts[i] = (cKilobot.GetTxStatus() == CKilobotCommunicationEntity::TX_ATTEMPT);
+         if(cKilobot.GetTxRange() > fMaxRange)
+            fMaxRange = cKilobot.GetTxRange();
+      }
+      /* Resize the grid if the largest range changed, so that all the
+         entities in range of a transmitter are in the 3x3 cells around it */
+      if(fMaxRange != m_fCellSize) {
+         m_fCellSize = fMaxRange;
+         m_unCellsX = Max<UInt32>(1, Ceil(m_cArenaSize.GetX() / m_fCellSize));
+         m_unCellsY = Max<UInt32>(1, Ceil(m_cArenaSize.GetY() / m_fCellSize));
+         m_vecCellStart.resize(m_unCellsX * m_unCellsY + 1);
+         /* The tiles keep their random number generators across resizes */
+         m_unTilesX = (m_unCellsX + TILE_CELLS - 1) / TILE_CELLS;
+         UInt32 unTiles = m_unTilesX * ((m_unCellsY + TILE_CELLS - 1) / TILE_CELLS);
+         for(UInt32 i = m_vecTiles.size(); i < unTiles; ++i) {
+            m_vecTiles.push_back(STile());
+            m_vecTiles.back().RNG = CRandom::CreateRNG("argos");
+         }
+         m_vecTileStart.resize(unTiles + 1);
+         /* The recent transmissions refer to the old cells */
+         ClearCsma();
+         m_vecCsmaCellTransmissions.resize(m_unCellsX * m_unCellsY);
+         m_bCellsSorted = false;
+      }
+      /* Counting sort of the entities by cell, unless they all stayed in
+         their cells, as in a swarm that has mostly stopped */
+      m_vecCellOf.resize(unEntities);
+      for(UInt32 i = 0; i < unEntities; ++i) {
+         UInt32 unCell = GetCell(m_vecPositions[i]);
+         if(unCell != m_vecCellOf[i]) {
+            m_vecCellOf[i] = unCell;
+            m_bCellsSorted = false;
+         }
+      }
+      if(!m_bCellsSorted) {
+         m_vecCellEntities.resize(unEntities);
+         std::fill(m_vecCellStart.begin(), m_vecCellStart.end(), 0);
+         for(UInt32 i = 0; i < unEntities; ++i) {
+            ++m_vecCellStart[m_vecCellOf[i] + 1];
+         }
+         for(size_t i = 1; i < m_vecCellStart.size(); ++i) {
+            m_vecCellStart[i] += m_vecCellStart[i-1];
+         }
+         for(UInt32 i = 0; i < unEntities; ++i) {
+            m_vecCellEntities[m_vecCellStart[m_vecCellOf[i]]++] = i;
+         }
+         /* The fill pass moved each start to the start of the next cell */
+         for(size_t i = m_vecCellStart.size() - 1; i > 0; --i) {
+            m_vecCellStart[i] = m_vecCellStart[i-1];
+         }
+         m_vecCellStart[0] = 0;
+         m_bCellsSorted = true;
+      }
+      /* Counting sort of the transmitters by tile, in dense index order
+         within each tile */
+      std::fill(m_vecTileStart.begin(), m_vecTileStart.end(), 0);
+      for(UInt32 i = 0; i < unEntities; ++i) {
+         if(m_vecTxAttempts[i]) {
+            UInt32 unTile =
+               (m_vecCellOf[i] / m_unCellsX / TILE_CELLS) * m_unTilesX +
+               (m_vecCellOf[i] % m_unCellsX / TILE_CELLS);
+            ++m_vecTileStart[unTile + 1];
+         }
+      }
+      for(size_t i = 1; i < m_vecTileStart.size(); ++i) {
+         m_vecTileStart[i] += m_vecTileStart[i-1];
+      }
+      m_vecTransmitters.resize(m_vecTileStart.back());
+      for(UInt32 i = 0; i < unEntities; ++i) {
+         if(m_vecTxAttempts[i]) {
+            UInt32 unTile =
+               (m_vecCellOf[i] / m_unCellsX / TILE_CELLS) * m_unTilesX +
+               (m_vecCellOf[i] % m_unCellsX / TILE_CELLS);
+            m_vecTransmitters[m_vecTileStart[unTile]++] = i;
+         }
+      }
+      for(size_t i = m_vecTileStart.size() - 1; i > 0; --i) {
+         m_vecTileStart[i] = m_vecTileStart[i-1];
+      }
+      m_vecTileStart[0] = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKilobotCommunicationMedium::GetCell(const CVector2& c_position) const {
+      SInt32 nI = Floor((c_position.GetX() - m_cArenaMin.GetX()) / m_fCellSize);
+      SInt32 nJ = Floor((c_position.GetY() - m_cArenaMin.GetY()) / m_fCellSize);
+      nI = Min<SInt32>(Max<SInt32>(nI, 0), m_unCellsX - 1);
+      nJ = Min<SInt32>(Max<SInt32>(nJ, 0), m_unCellsY - 1);
+      return nJ * m_unCellsX + nI;
    }
 
    /****************************************/
    /****************************************/
 
-   static size_t HashKilobotPair(const std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*>& c_pair) {
-      return
-         reinterpret_cast<size_t>(c_pair.first) ^
-         reinterpret_cast<size_t>(c_pair.second);
+   void CKilobotCommunicationMedium::DeliverMessage(UInt32 un_receiver,
+                                                    UInt32 un_transmitter,
+                                                    Real f_key,
+                                                    Real f_time) {
+      SReceivedMessage* psInbox = &m_vecInboxes[un_receiver * m_unMaxRx];
+      UInt32& unSize = m_vecInboxSizes[un_receiver];
+      CKilobotCommunicationEntity* pcSender = m_vecEntities[un_transmitter];
+      /* Count the copies of the message already in the inbox */
+      UInt32 unCopy = 0;
+      for(UInt32 k = 0; k < unSize; ++k) {
+         if(psInbox[k].Sender == pcSender) ++unCopy;
+      }
+      /* When the inbox is full, the message must beat the last one */
+      if(unSize == m_unMaxRx) {
+         if(!IsBefore(unCopy, f_key, psInbox[unSize - 1])) return;
+         --unSize;
+      }
+      /* Insert the message keeping the inbox sorted by copy, then by key */
+      UInt32 k = unSize;
+      for(; k > 0 && IsBefore(unCopy, f_key, psInbox[k - 1]); --k) {
+         psInbox[k] = psInbox[k - 1];
+      }
+      psInbox[k].Sender = pcSender;
+      psInbox[k].Copy = unCopy;
+      psInbox[k].Key = f_key;
+      psInbox[k].Time = f_time;
+      ++unSize;
    }
 
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateTile(UInt32 un_tile) {
+      STile& sTile = m_vecTiles[un_tile];
+      sTile.Deliveries.clear();
+      for(UInt32 t = m_vecTileStart[un_tile]; t < m_vecTileStart[un_tile + 1]; ++t) {
+         UInt32 unTx = m_vecTransmitters[t];
+         const CVector2& cTxPos = m_vecPositions[unTx];
+         SInt32 nCellI = m_vecCellOf[unTx] % m_unCellsX;
+         SInt32 nCellJ = m_vecCellOf[unTx] / m_unCellsX;
+         /* Find the robots in range and the transmitting robots heard,
+            going through the 3x3 cells around the transmitter */
+         sTile.Receivers.clear();
+         UInt32 unConflicts = 0;
+         for(SInt32 j = Max<SInt32>(nCellJ - 1, 0); j <= Min<SInt32>(nCellJ + 1, m_unCellsY - 1); ++j) {
+            for(SInt32 i = Max<SInt32>(nCellI - 1, 0); i <= Min<SInt32>(nCellI + 1, m_unCellsX - 1); ++i) {
+               UInt32 unCell = j * m_unCellsX + i;
+               for(UInt32 k = m_vecCellStart[unCell]; k < m_vecCellStart[unCell + 1]; ++k) {
+                  UInt32 unOther = m_vecCellEntities[k];
+                  if(unOther == unTx) continue;
+                  Real fSqDistance = SquareDistance(cTxPos, m_vecPositions[unOther]);
+                  /* The other robot receives the transmitter's message */
+                  if(fSqDistance < m_vecSqTxRanges[unTx]) {
+                     SDelivery sDelivery = { unOther, unTx, fSqDistance, 0.0 };
+                     sTile.Receivers.push_back(sDelivery);
+                  }
+                  /* The transmitter hears the other transmitting robot */
+                  if(m_vecTxAttempts[unOther] &&
+                     fSqDistance < m_vecSqTxRanges[unOther])
+                     ++unConflicts;
+               }
+            }
+         }
+         /* Is this robot conflicting? */
+         if(m_bIgnoreConflicts ||
+            unConflicts == 0 ||
+            sTile.RNG->Uniform(CRange<UInt32>(0, unConflicts + 1)) == 0) {
+            /* The robot can transmit */
+            m_vecEntities[unTx]->SetTxStatus(CKilobotCommunicationEntity::TX_SUCCESS);
+            /* Without timestamps, the message is sent once and arrives at the
+               end of the step; with timestamps, it is sent every period
+               from a random time in the step */
+            Real fStep = CPhysicsEngine::GetSimulationClockTick();
+            Real fTime = fStep;
+            Real fPeriod = 0.0;
+            if(m_bTimestamps) {
+               fPeriod = m_vecTxPeriods[unTx];
+               fTime = sTile.RNG->Uniform(CRange<Real>(0.0, (fPeriod > 0.0 && fPeriod < fStep) ? fPeriod : fStep));
+            }
+            UInt32 unCount = 0;
+            do {
+               ++unCount;
+               /* Go through the robots in range */
+               for(size_t k = 0; k < sTile.Receivers.size(); ++k) {
+                  /* If transmission succeeds, the other robot receives the message */
+                  if(sTile.RNG->Bernoulli(m_fRxProb)) {
+                     SDelivery sDelivery = sTile.Receivers[k];
+                     if(m_eRxPolicy == RX_POLICY_ID)
+                        sDelivery.Key = m_vecEntities[unTx]->GetIndex();
+                     else if(m_eRxPolicy == RX_POLICY_RANDOM)
+                        sDelivery.Key = sTile.RNG->Uniform(CRange<Real>(0.0, 1.0));
+                     sDelivery.Time = fTime;
+                     sTile.Deliveries.push_back(sDelivery);
+                  }
+               } /* receivers loop */
+               fTime += fPeriod;
+            } while(fPeriod > 0.0 && fTime < fStep);
+            m_vecEntities[unTx]->SetTxCount(unCount);
+         } /* conflict check */
+      } /* transmitters loop */
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateTiles() {
+      UInt32 unTiles = m_vecTileStart.size() - 1;
+      UInt32 unTile;
+      while((unTile = __atomic_fetch_add(&m_unNextTile, 1, __ATOMIC_RELAXED)) < unTiles) {
+         UpdateTile(unTile);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::WorkerThread() {
+      UInt32 unLastUpdate = 0;
+      pthread_mutex_lock(&m_tWorkerMutex);
+      while(1) {
+         /* Wait for an update to start */
+         while(!m_bQuitWorkers && m_unUpdateCounter == unLastUpdate) {
+            pthread_cond_wait(&m_tWorkerStartCond, &m_tWorkerMutex);
+         }
+         if(m_bQuitWorkers) break;
+         unLastUpdate = m_unUpdateCounter;
+         pthread_mutex_unlock(&m_tWorkerMutex);
+         UpdateTiles();
+         pthread_mutex_lock(&m_tWorkerMutex);
+         if(--m_unBusyWorkers == 0) {
+            pthread_cond_signal(&m_tWorkerDoneCond);
+         }
+      }
+      pthread_mutex_unlock(&m_tWorkerMutex);
+   }
+
+   void* CKilobotCommunicationMedium::StartWorkerThread(void* pt_medium) {
+      reinterpret_cast<CKilobotCommunicationMedium*>(pt_medium)->WorkerThread();
+      return NULL;
+   }
+
+   /****************************************/
+   /****************************************/
+
    void CKilobotCommunicationMedium::Update() {
       /*
-       * Update positional index of Kilobot entities
+       * Delete obsolete received messages
        */
-      m_pcKilobotIndex->Update();
+      std::fill(m_vecInboxSizes.begin(), m_vecInboxSizes.end(), 0);
       /*
-       * Delete obsolete adjacency matrices
+       * Sort robots into cells and transmitters into tiles
        */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         it->second.clear();
+      UpdateGrid();
+      if(m_eChannelModel == CHANNEL_CSMA) {
+         UpdateCsma();
+         return;
       }
-      m_tTxNeighbors.clear();
       /*
-       * Construct the adjacency matrix of transmitting robots
+       * Resolve conflicts and deliver messages tile by tile. Each tile
+       * has its own random number generator, so the result does not
+       * depend on the number of threads.
        */
-      /* Buffer for the communicating entities */
-      CSet<CKilobotCommunicationEntity*,SEntityComparator> cOtherKilobots;
-      /* This map contains the pairs that have already been checked */
-      unordered_map<size_t, std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> > mapPairsAlreadyChecked;
-      /* Iterator for the above structure */
-      unordered_map<size_t, std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> >::iterator itPair;
-      /* Used as test key */
-      std::pair<CKilobotCommunicationEntity*, CKilobotCommunicationEntity*> cTestKey;
-      /* Used as hash for the test key */
-      size_t unTestHash;
-      /* The square distance between two Kilobots */
-      Real fSqDistance;
-      /* Go through the Kilobot entities */
-      for(TAdjacencyMatrix::iterator it = m_tCommMatrix.begin();
-          it != m_tCommMatrix.end();
-          ++it) {
-         /* Get a reference to the current Kilobot entity */
-         CKilobotCommunicationEntity& cKilobot = *reinterpret_cast<CKilobotCommunicationEntity*>(GetSpace().GetEntityVector()[it->first]);
-         /* Is this robot trying to transmit? */
-         if(cKilobot.GetTxStatus() == CKilobotCommunicationEntity::TX_ATTEMPT) {
-            /* Yes, add it to the list of transmitting robots */
-            m_tTxNeighbors[cKilobot.GetIndex()];
-            /* Get the list of Kilobots in range */
-            cOtherKilobots.clear();
-            m_pcKilobotIndex->GetEntitiesAt(cOtherKilobots, cKilobot.GetPosition());
-            /* Go through the Kilobots in range */
-            for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it2 = cOtherKilobots.begin();
-                it2 != cOtherKilobots.end();
-                ++it2) {
-               /* Get a reference to the neighboring Kilobot */
-               CKilobotCommunicationEntity& cOtherKilobot = **it2;
-               /* First, make sure the entities are not the same and
-                  that they are both transmitting */
-               if(&cKilobot != &cOtherKilobot &&
-                  cOtherKilobot.GetTxStatus() == CKilobotCommunicationEntity::TX_ATTEMPT) {
-                  /* Proceed if the pair has not been checked already */
-                  if(&cKilobot < &cOtherKilobot) {
-                     cTestKey.first = &cKilobot;
-                     cTestKey.second = &cOtherKilobot;
-                  }
-                  else {
-                     cTestKey.first = &cOtherKilobot;
-                     cTestKey.second = &cKilobot;
-                  }
-                  unTestHash = HashKilobotPair(cTestKey);
-                  itPair = mapPairsAlreadyChecked.find(unTestHash);
-                  if(itPair == mapPairsAlreadyChecked.end() ||   /* Pair does not exist */
-                     itPair->second.first != cTestKey.first ||   /* Pair exists, but first Kilobot involved is different */
-                     itPair->second.second != cTestKey.second) { /* Pair exists, but second Kilobot involved is different */
-                     /* Mark this pair as already checked */
-                     mapPairsAlreadyChecked[unTestHash] = cTestKey;
-                     /* Calculate square distance */
-                     fSqDistance = SquareDistance(cKilobot.GetPosition(),
-                                                  cOtherKilobot.GetPosition());
-                     if(fSqDistance < Square(cOtherKilobot.GetTxRange())) {
-                        /* cKilobot receives cOtherKilobot's message */
-                        m_tTxNeighbors[cKilobot.GetIndex()].insert(&cOtherKilobot);
-                     }
-                     if(fSqDistance < Square(cKilobot.GetTxRange())) {
-                        /* cOtherKilobot receives cKilobot's message */
-                        m_tTxNeighbors[cOtherKilobot.GetIndex()].insert(&cKilobot);
-                     }
-                  } /* pair check */
-               } /* entity identity + transmit check */
-            } /* neighbors loop */
-         } /* transmission check */
-      } /* robot loop */
+      m_unNextTile = 0;
+      if(m_vecWorkers.empty()) {
+         UpdateTiles();
+      }
+      else {
+         pthread_mutex_lock(&m_tWorkerMutex);
+         m_unBusyWorkers = m_vecWorkers.size();
+         ++m_unUpdateCounter;
+         pthread_cond_broadcast(&m_tWorkerStartCond);
+         pthread_mutex_unlock(&m_tWorkerMutex);
+         UpdateTiles();
+         pthread_mutex_lock(&m_tWorkerMutex);
+         while(m_unBusyWorkers > 0) {
+            pthread_cond_wait(&m_tWorkerDoneCond, &m_tWorkerMutex);
+         }
+         pthread_mutex_unlock(&m_tWorkerMutex);
+      }
       /*
-       * Go through transmitting robots and broadcast messages
+       * Fill the inboxes, in tile order
        */
-      /* Buffer to store the intersection data */
-      SEmbodiedEntityIntersectionItem sIntersectionItem;
-      /* Loop over transmitting robots */
-      for(TAdjacencyMatrix::iterator it = m_tTxNeighbors.begin();
-          it != m_tTxNeighbors.end();
-          ++it) {
-         /* Is this robot conflicting? */
-         if(m_bIgnoreConflicts ||
-            it->second.empty() ||
-            m_pcRNG->Uniform(CRange<UInt32>(0, it->second.size() + 1)) == 0) {
-            /* The robot can transmit */
-            /* Get a reference to the current Kilobot entity */
-            CKilobotCommunicationEntity& cKilobot = *reinterpret_cast<CKilobotCommunicationEntity*>(GetSpace().GetEntityVector()[it->first]);
-            /* Change its transmission status */
-            cKilobot.SetTxStatus(CKilobotCommunicationEntity::TX_SUCCESS);
-            /* Go through its neighbors */
-            cOtherKilobots.clear();
-            m_pcKilobotIndex->GetEntitiesAt(cOtherKilobots, cKilobot.GetPosition());
-            for(CSet<CKilobotCommunicationEntity*,SEntityComparator>::iterator it2 = cOtherKilobots.begin();
-                it2 != cOtherKilobots.end();
-                ++it2) {
-               /* Get a reference to the neighboring Kilobot entity */
-               CKilobotCommunicationEntity& cOtherKilobot = **it2;
-               /* Make sure the robots are different */
-               if(&cKilobot != &cOtherKilobot) {
-                  /* Calculate distance */
-                  fSqDistance = SquareDistance(cKilobot.GetPosition(),
-                                               cOtherKilobot.GetPosition());
-                  /* If robots are within transmission range and transmission succeeds... */
-                  if(fSqDistance < Square(cKilobot.GetTxRange()) &&
-                     m_pcRNG->Bernoulli(m_fRxProb)) {
-                     /* cOtherKilobot receives cKilobot's message */
-                     m_tCommMatrix[cOtherKilobot.GetIndex()].insert(&cKilobot);
-                  }
-               } /* identity check */
-            } /* neighbor loop */
-         } /* conflict check */
-      } /* transmitters loop */
+      for(size_t i = 0; i + 1 < m_vecTileStart.size(); ++i) {
+         const std::vector<SDelivery>& vecDeliveries = m_vecTiles[i].Deliveries;
+         for(size_t j = 0; j < vecDeliveries.size(); ++j) {
+            DeliverMessage(vecDeliveries[j].Receiver,
+                           vecDeliveries[j].Transmitter,
+                           vecDeliveries[j].Key,
+                           vecDeliveries[j].Time);
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::UpdateCsma() {
+      Real fStepEnd = m_fCsmaClock + CPhysicsEngine::GetSimulationClockTick();
+      /* The robots that started trying to transmit wait for a random backoff */
+      for(UInt32 i = 0; i < m_vecEntities.size(); ++i) {
+         SCsmaState& sState = m_vecCsmaStates[i];
+         if(m_vecTxAttempts[i] && !sState.Scheduled) {
+            sState.Scheduled = true;
+            ScheduleCsmaEvent(m_fCsmaClock +
+                              m_pcCsmaRNG->Uniform(CRange<UInt32>(0, sState.Window)) * m_fCsmaSlotTime,
+                              i, false);
+         }
+      }
+      /* Process the events of this step in time order; the later ones
+         stay queued for the next steps */
+      while(!m_vecCsmaEvents.empty() && m_vecCsmaEvents.front().Time < fStepEnd) {
+         std::pop_heap(m_vecCsmaEvents.begin(), m_vecCsmaEvents.end(), std::greater<SCsmaEvent>());
+         SCsmaEvent sEvent = m_vecCsmaEvents.back();
+         m_vecCsmaEvents.pop_back();
+         if(sEvent.End)
+            EndCsmaTransmission(sEvent.Entity);
+         else
+            StartCsmaTransmission(sEvent.Entity, sEvent.Time);
+      }
+      m_fCsmaClock = fStepEnd;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::StartCsmaTransmission(UInt32 un_entity,
+                                                           Real f_time) {
+      SCsmaState& sState = m_vecCsmaStates[un_entity];
+      /* The robot gave up transmitting in the meantime */
+      if(!m_vecTxAttempts[un_entity]) {
+         sState.Scheduled = false;
+         return;
+      }
+      /* Carrier sense: back off again if someone else is transmitting */
+      const CVector2& cPosition = m_vecPositions[un_entity];
+      if(IsChannelBusy(cPosition, f_time, f_time, un_entity)) {
+         ScheduleCsmaEvent(f_time +
+                           (1 + m_pcCsmaRNG->Uniform(CRange<UInt32>(0, sState.Window))) * m_fCsmaSlotTime,
+                           un_entity, false);
+         return;
+      }
+      /* Transmit */
+      SCsmaTransmission& sTx = sState.Transmission;
+      sTx.Transmitter = un_entity;
+      sTx.Start = f_time;
+      sTx.Position = cPosition;
+      sTx.SqRange = m_vecSqTxRanges[un_entity];
+      m_vecCsmaCellTransmissions[GetCell(cPosition)].push_back(sTx);
+      ScheduleCsmaEvent(f_time + m_fCsmaTxTime, un_entity, true);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::EndCsmaTransmission(UInt32 un_entity) {
+      SCsmaState& sState = m_vecCsmaStates[un_entity];
+      const SCsmaTransmission& sTx = sState.Transmission;
+      Real fEnd = sTx.Start + m_fCsmaTxTime;
+      /* Arrival time of the message within the step */
+      Real fTime = m_bTimestamps ?
+         (fEnd - m_fCsmaClock) :
+         CPhysicsEngine::GetSimulationClockTick();
+      /* Deliver the message to the robots in range that heard nothing else,
+         including their own transmissions */
+      UInt32 unCell = GetCell(sTx.Position);
+      SInt32 nCellI = unCell % m_unCellsX;
+      SInt32 nCellJ = unCell / m_unCellsX;
+      for(SInt32 j = Max<SInt32>(nCellJ - 1, 0); j <= Min<SInt32>(nCellJ + 1, m_unCellsY - 1); ++j) {
+         for(SInt32 i = Max<SInt32>(nCellI - 1, 0); i <= Min<SInt32>(nCellI + 1, m_unCellsX - 1); ++i) {
+            UInt32 unOtherCell = j * m_unCellsX + i;
+            for(UInt32 k = m_vecCellStart[unOtherCell]; k < m_vecCellStart[unOtherCell + 1]; ++k) {
+               UInt32 unOther = m_vecCellEntities[k];
+               if(unOther == un_entity) continue;
+               Real fSqDistance = SquareDistance(sTx.Position, m_vecPositions[unOther]);
+               if(fSqDistance < sTx.SqRange &&
+                  (m_bIgnoreConflicts ||
+                   !IsChannelBusy(m_vecPositions[unOther], sTx.Start, fEnd, un_entity)) &&
+                  m_pcCsmaRNG->Bernoulli(m_fRxProb)) {
+                  Real fKey = fSqDistance;
+                  if(m_eRxPolicy == RX_POLICY_ID)
+                     fKey = m_vecEntities[un_entity]->GetIndex();
+                  else if(m_eRxPolicy == RX_POLICY_RANDOM)
+                     fKey = m_pcCsmaRNG->Uniform(CRange<Real>(0.0, 1.0));
+                  DeliverMessage(unOther, un_entity, fKey, fTime);
+               }
+            }
+         }
+      }
+      /* The transmitter detects a collision if it heard another transmission */
+      if(!m_bIgnoreConflicts &&
+         IsChannelBusy(sTx.Position, sTx.Start, fEnd, un_entity)) {
+         /* Back off with a doubled contention window */
+         sState.Window = Min(sState.Window * 2, m_unCsmaMaxWindow);
+         ScheduleCsmaEvent(fEnd +
+                           m_pcCsmaRNG->Uniform(CRange<UInt32>(0, sState.Window)) * m_fCsmaSlotTime,
+                           un_entity, false);
+      }
+      else {
+         CKilobotCommunicationEntity& cKilobot = *m_vecEntities[un_entity];
+         cKilobot.SetTxStatus(CKilobotCommunicationEntity::TX_SUCCESS);
+         cKilobot.SetTxCount(cKilobot.GetTxCount() + 1);
+         sState.Window = m_unCsmaMinWindow;
+         /* With timestamps, the robot sends again after its period */
+         if(m_bTimestamps && m_vecTxPeriods[un_entity] > 0.0) {
+            ScheduleCsmaEvent(fEnd + m_vecTxPeriods[un_entity], un_entity, false);
+         }
+         else {
+            sState.Scheduled = false;
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKilobotCommunicationMedium::IsChannelBusy(const CVector2& c_position,
+                                                   Real f_from,
+                                                   Real f_to,
+                                                   UInt32 un_skip) {
+      /* Transmissions that ended this long ago can't overlap any future query */
+      Real fExpired = f_from - m_fCsmaTxTime;
+      UInt32 unCell = GetCell(c_position);
+      SInt32 nCellI = unCell % m_unCellsX;
+      SInt32 nCellJ = unCell / m_unCellsX;
+      for(SInt32 j = Max<SInt32>(nCellJ - 1, 0); j <= Min<SInt32>(nCellJ + 1, m_unCellsY - 1); ++j) {
+         for(SInt32 i = Max<SInt32>(nCellI - 1, 0); i <= Min<SInt32>(nCellI + 1, m_unCellsX - 1); ++i) {
+            std::vector<SCsmaTransmission>& vecTxs = m_vecCsmaCellTransmissions[j * m_unCellsX + i];
+            for(size_t k = 0; k < vecTxs.size(); ) {
+               const SCsmaTransmission& sTx = vecTxs[k];
+               if(sTx.Start + m_fCsmaTxTime <= fExpired) {
+                  vecTxs[k] = vecTxs.back();
+                  vecTxs.pop_back();
+                  continue;
+               }
+               if(sTx.Transmitter != un_skip &&
+                  sTx.Start < f_to &&
+                  sTx.Start + m_fCsmaTxTime > f_from &&
+                  SquareDistance(sTx.Position, c_position) < sTx.SqRange) {
+                  return true;
+               }
+               ++k;
+            }
+         }
+      }
+      return false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::ScheduleCsmaEvent(Real f_time,
+                                                       UInt32 un_entity,
+                                                       bool b_end) {
+      SCsmaEvent sEvent = { f_time, un_entity, b_end };
+      m_vecCsmaEvents.push_back(sEvent);
+      std::push_heap(m_vecCsmaEvents.begin(), m_vecCsmaEvents.end(), std::greater<SCsmaEvent>());
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::ClearCsma() {
+      m_vecCsmaEvents.clear();
+      for(size_t i = 0; i < m_vecCsmaCellTransmissions.size(); ++i) {
+         m_vecCsmaCellTransmissions[i].clear();
+      }
+      for(size_t i = 0; i < m_vecCsmaStates.size(); ++i) {
+         m_vecCsmaStates[i].Window = m_unCsmaMinWindow;
+         m_vecCsmaStates[i].Scheduled = false;
+      }
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationMedium::AddEntity(CKilobotCommunicationEntity& c_entity) {
-      m_tCommMatrix.insert(
-         std::make_pair<ssize_t, CSet<CKilobotCommunicationEntity*,SEntityComparator> >(
-            c_entity.GetIndex(), CSet<CKilobotCommunicationEntity*,SEntityComparator>()));
-      m_pcKilobotIndex->AddEntity(c_entity);
+      if(c_entity.GetIndex() >= static_cast<ssize_t>(m_vecDenseIndices.size()))
+         m_vecDenseIndices.resize(c_entity.GetIndex() + 1, -1);
+      if(m_vecDenseIndices[c_entity.GetIndex()] >= 0)
+         return;
+      m_vecDenseIndices[c_entity.GetIndex()] = m_vecEntities.size();
+      m_vecEntities.push_back(&c_entity);
+      m_vecRobotIndices.push_back(c_entity.GetParent().GetIndex());
+      m_vecInboxes.resize(m_vecEntities.size() * m_unMaxRx);
+      m_vecInboxSizes.push_back(0);
+      SCsmaState sState;
+      sState.Window = m_unCsmaMinWindow;
+      sState.Scheduled = false;
+      m_vecCsmaStates.push_back(sState);
+      m_bCellsSorted = false;
    }
 
    /****************************************/
    /****************************************/
 
    void CKilobotCommunicationMedium::RemoveEntity(CKilobotCommunicationEntity& c_entity) {
-      m_pcKilobotIndex->RemoveEntity(c_entity);
-      TAdjacencyMatrix::iterator it = m_tCommMatrix.find(c_entity.GetIndex());
-      if(it != m_tCommMatrix.end())
-         m_tCommMatrix.erase(it);
+      if(c_entity.GetIndex() < 0 ||
+         c_entity.GetIndex() >= static_cast<ssize_t>(m_vecDenseIndices.size()) ||
+         m_vecDenseIndices[c_entity.GetIndex()] < 0)
+         return;
+      /* Move the last entity in the place of the removed one */
+      ssize_t nDense = m_vecDenseIndices[c_entity.GetIndex()];
+      CKilobotCommunicationEntity* pcLast = m_vecEntities.back();
+      m_vecEntities[nDense] = pcLast;
+      m_vecRobotIndices[nDense] = m_vecRobotIndices.back();
+      std::copy(m_vecInboxes.end() - m_unMaxRx, m_vecInboxes.end(),
+                m_vecInboxes.begin() + nDense * m_unMaxRx);
+      m_vecInboxSizes[nDense] = m_vecInboxSizes.back();
+      m_vecCsmaStates[nDense] = m_vecCsmaStates.back();
+      m_vecDenseIndices[pcLast->GetIndex()] = nDense;
+      m_vecDenseIndices[c_entity.GetIndex()] = -1;
+      m_vecEntities.pop_back();
+      m_vecRobotIndices.pop_back();
+      m_vecInboxes.resize(m_vecEntities.size() * m_unMaxRx);
+      m_vecInboxSizes.pop_back();
+      m_vecCsmaStates.pop_back();
+      /* The scheduled events and the sort by cell refer to the old dense indices */
+      ClearCsma();
+      m_bCellsSorted = false;
    }
 
    /****************************************/
    /****************************************/
 
-   const CSet<CKilobotCommunicationEntity*,SEntityComparator>& CKilobotCommunicationMedium::GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const {
-      TAdjacencyMatrix::const_iterator it = m_tCommMatrix.find(c_entity.GetIndex());
-      if(it != m_tCommMatrix.end()) {
-         return it->second;
+   CKilobotCommunicationMedium::SInbox CKilobotCommunicationMedium::GetInbox(CKilobotCommunicationEntity& c_entity) const {
+      if(c_entity.GetIndex() >= 0 &&
+         c_entity.GetIndex() < static_cast<ssize_t>(m_vecDenseIndices.size()) &&
+         m_vecDenseIndices[c_entity.GetIndex()] >= 0) {
+         ssize_t nDense = m_vecDenseIndices[c_entity.GetIndex()];
+         SInbox sInbox = { &m_vecInboxes[nDense * m_unMaxRx], m_vecInboxSizes[nDense] };
+         return sInbox;
       }
       else {
          THROW_ARGOSEXCEPTION("Kilobot entity \"" << c_entity.GetId() << "\" is not managed by the Kilobot medium \"" << GetId() << "\"");
@@ -265,23 +751,130 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   void CKilobotCommunicationMedium::SetOHCMessage(ssize_t n_index,
+                                                   const message_t* pt_message) {
+      if(pt_message != NULL) {
+         /* Make room for the robot, if necessary */
+         if(n_index >= static_cast<ssize_t>(m_vecOHCMessages.size())) {
+            m_vecOHCMessages.resize(n_index + 1);
+            m_vecOHCShared.resize(n_index + 1, -1);
+            m_vecOHCValid.resize(n_index / 64 + 1, 0);
+         }
+         ReleaseSharedOHCMessage(n_index);
+         m_vecOHCMessages[n_index] = *pt_message;
+         m_vecOHCValid[n_index / 64] |= (1ULL << (n_index % 64));
+      }
+      else if(n_index < static_cast<ssize_t>(m_vecOHCMessages.size())) {
+         ReleaseSharedOHCMessage(n_index);
+         m_vecOHCValid[n_index / 64] &= ~(1ULL << (n_index % 64));
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::SetSharedOHCMessage(ssize_t n_index,
+                                                         UInt32 un_shared) {
+      /* Make room for the robot, if necessary */
+      if(n_index >= static_cast<ssize_t>(m_vecOHCMessages.size())) {
+         m_vecOHCMessages.resize(n_index + 1);
+         m_vecOHCShared.resize(n_index + 1, -1);
+         m_vecOHCValid.resize(n_index / 64 + 1, 0);
+      }
+      /* Take the new message before releasing the old one, in case they are the same */
+      ++m_vecSharedOHCMessages[un_shared].Users;
+      ReleaseSharedOHCMessage(n_index);
+      m_vecOHCShared[n_index] = un_shared;
+      m_vecOHCValid[n_index / 64] |= (1ULL << (n_index % 64));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::ReleaseSharedOHCMessage(ssize_t n_index) {
+      SInt32 nShared = m_vecOHCShared[n_index];
+      if(nShared >= 0) {
+         if(--m_vecSharedOHCMessages[nShared].Users == 0)
+            m_vecFreeSharedOHCMessages.push_back(nShared);
+         m_vecOHCShared[n_index] = -1;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKilobotCommunicationMedium::AddSharedOHCMessage(const message_t* pt_message) {
+      UInt32 unShared;
+      if(m_vecFreeSharedOHCMessages.empty()) {
+         unShared = m_vecSharedOHCMessages.size();
+         m_vecSharedOHCMessages.push_back(SSharedOHCMessage());
+      }
+      else {
+         unShared = m_vecFreeSharedOHCMessages.back();
+         m_vecFreeSharedOHCMessages.pop_back();
+      }
+      m_vecSharedOHCMessages[unShared].Message = *pt_message;
+      m_vecSharedOHCMessages[unShared].Users = 0;
+      return unShared;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::GetEntitiesInBox(const CVector2& c_min,
+                                                      const CVector2& c_max) {
+      m_vecOHCCandidates.clear();
+      /* Entities added or removed since the last update are not in the grid
+         yet, and the dense indices in it may be out of date */
+      if(!m_bCellsSorted) UpdateGrid();
+      UInt32 unMin = GetCell(c_min);
+      UInt32 unMax = GetCell(c_max);
+      for(UInt32 j = unMin / m_unCellsX; j <= unMax / m_unCellsX; ++j) {
+         /* The cells of a row are contiguous in m_vecCellEntities */
+         UInt32 unFrom = m_vecCellStart[j * m_unCellsX + unMin % m_unCellsX];
+         UInt32 unTo = m_vecCellStart[j * m_unCellsX + unMax % m_unCellsX + 1];
+         m_vecOHCCandidates.insert(m_vecOHCCandidates.end(),
+                                   m_vecCellEntities.begin() + unFrom,
+                                   m_vecCellEntities.begin() + unTo);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   template<typename TEST>
+   UInt32 CKilobotCommunicationMedium::SendOHCMessageToCandidates(const message_t* pt_message,
+                                                                  const TEST& t_test) {
+      UInt32 unRecipients = 0;
+      if(pt_message != NULL) {
+         UInt32 unShared = AddSharedOHCMessage(pt_message);
+         for(size_t i = 0; i < m_vecOHCCandidates.size(); ++i) {
+            if(t_test(m_vecPositions[m_vecOHCCandidates[i]])) {
+               SetSharedOHCMessage(m_vecRobotIndices[m_vecOHCCandidates[i]], unShared);
+               ++unRecipients;
+            }
+         }
+         /* Nobody took the message */
+         if(unRecipients == 0)
+            m_vecFreeSharedOHCMessages.push_back(unShared);
+      }
+      else {
+         for(size_t i = 0; i < m_vecOHCCandidates.size(); ++i) {
+            if(t_test(m_vecPositions[m_vecOHCCandidates[i]])) {
+               SetOHCMessage(m_vecRobotIndices[m_vecOHCCandidates[i]], NULL);
+               ++unRecipients;
+            }
+         }
+      }
+      return unRecipients;
+   }
+
+   /****************************************/
+   /****************************************/
+
    void CKilobotCommunicationMedium::SendOHCMessageTo(CKilobotEntity& c_robot,
                                                       message_t* pt_message) {
-      /*
-       * old   | new   | action
-       * ------+-------+---------------------
-       * ~null | ~null | delete old, copy new
-       * ~null |  null | delete old, set null
-       *  null | ~null | copy new
-       *  null |  null | nothing to do
-       */
-      /* Get old message and delete it if necessary */
-      message_t* ptOldMsg = GetOHCMessageFor(c_robot);
-      if(ptOldMsg != NULL) delete ptOldMsg;
-      /* Set message */
-      m_mapOHCMessages[c_robot.GetIndex()] = NULL;
-      if(pt_message != NULL)
-         m_mapOHCMessages[c_robot.GetIndex()] = new message_t(*pt_message);
+      SetOHCMessage(c_robot.GetIndex(), pt_message);
    }
 
    /****************************************/
@@ -289,33 +882,110 @@ namespace argos {
 
    void CKilobotCommunicationMedium::SendOHCMessageTo(std::vector<CKilobotEntity*>& vec_robots,
                                                       message_t* pt_message) {
+      if(pt_message != NULL && !vec_robots.empty()) {
+         UInt32 unShared = AddSharedOHCMessage(pt_message);
+         for(size_t i = 0; i < vec_robots.size(); ++i) {
+            SetSharedOHCMessage(vec_robots[i]->GetIndex(), unShared);
+         }
+      }
+      else {
+         for(size_t i = 0; i < vec_robots.size(); ++i) {
+            SetOHCMessage(vec_robots[i]->GetIndex(), NULL);
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   struct SInCircle {
+      CVector2 Center;
+      Real SqRadius;
+      bool operator()(const CVector2& c_position) const {
+         return SquareDistance(c_position, Center) <= SqRadius;
+      }
+   };
+
+   UInt32 CKilobotCommunicationMedium::SendOHCMessageToCircle(const CVector2& c_center,
+                                                              Real f_radius,
+                                                              const message_t* pt_message) {
+      GetEntitiesInBox(c_center - CVector2(f_radius, f_radius),
+                       c_center + CVector2(f_radius, f_radius));
+      SInCircle sTest = { c_center, f_radius * f_radius };
+      return SendOHCMessageToCandidates(pt_message, sTest);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   struct SInPolygon {
+      const std::vector<CVector2>& Vertices;
+      /* Even-odd rule: count the edges crossed by a ray towards +X */
+      bool operator()(const CVector2& c_position) const {
+         bool bInside = false;
+         for(size_t i = 0, j = Vertices.size() - 1; i < Vertices.size(); j = i++) {
+            const CVector2& cA = Vertices[i];
+            const CVector2& cB = Vertices[j];
+            if((cA.GetY() > c_position.GetY()) != (cB.GetY() > c_position.GetY()) &&
+               c_position.GetX() < cA.GetX() + (cB.GetX() - cA.GetX()) *
+               (c_position.GetY() - cA.GetY()) / (cB.GetY() - cA.GetY()))
+               bInside = !bInside;
+         }
+         return bInside;
+      }
+   };
+
+   UInt32 CKilobotCommunicationMedium::SendOHCMessageToPolygon(const std::vector<CVector2>& vec_vertices,
+                                                               const message_t* pt_message) {
+      if(vec_vertices.size() < 3) {
+         THROW_ARGOSEXCEPTION("A polygon needs at least 3 vertices, " << vec_vertices.size() << " given");
+      }
+      CVector2 cMin = vec_vertices[0];
+      CVector2 cMax = vec_vertices[0];
+      for(size_t i = 1; i < vec_vertices.size(); ++i) {
+         cMin.Set(Min(cMin.GetX(), vec_vertices[i].GetX()),
+                  Min(cMin.GetY(), vec_vertices[i].GetY()));
+         cMax.Set(Max(cMax.GetX(), vec_vertices[i].GetX()),
+                  Max(cMax.GetY(), vec_vertices[i].GetY()));
+      }
+      GetEntitiesInBox(cMin, cMax);
+      SInPolygon sTest = { vec_vertices };
+      return SendOHCMessageToCandidates(pt_message, sTest);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotCommunicationMedium::SendOHCMessagesTo(const std::vector<CKilobotEntity*>& vec_robots,
+                                                       const message_t* pt_messages) {
       for(size_t i = 0; i < vec_robots.size(); ++i) {
-         /*
-          * old   | new   | action
-          * ------+-------+---------------------
-          * ~null | ~null | delete old, copy new
-          * ~null |  null | delete old, set null
-          *  null | ~null | copy new
-          *  null |  null | nothing to do
-          */
-         /* Get old message and delete it if necessary */
-         message_t* ptOldMsg = GetOHCMessageFor(*vec_robots[i]);
-         if(ptOldMsg != NULL) delete ptOldMsg;
-         /* Set message */
-         m_mapOHCMessages[vec_robots[i]->GetIndex()] = NULL;
-         if(pt_message != NULL)
-            m_mapOHCMessages[vec_robots[i]->GetIndex()] = new message_t(*pt_message);
+         SetOHCMessage(vec_robots[i]->GetIndex(), pt_messages + i);
       }
    }
 
    /****************************************/
    /****************************************/
 
+   void CKilobotCommunicationMedium::ClearOHCMessages() {
+      std::fill(m_vecOHCValid.begin(), m_vecOHCValid.end(), 0);
+      std::fill(m_vecOHCShared.begin(), m_vecOHCShared.end(), -1);
+      m_vecSharedOHCMessages.clear();
+      m_vecFreeSharedOHCMessages.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
    message_t* CKilobotCommunicationMedium::GetOHCMessageFor(CKilobotEntity& c_robot) {
-      /* Look for robot in map */
-      std::unordered_map<ssize_t, message_t*>::iterator it = m_mapOHCMessages.find(c_robot.GetIndex());
-      /* Return entry if robot found, NULL otherwise */
-      return (it == m_mapOHCMessages.end()) ? NULL : (it->second);
+      ssize_t nIndex = c_robot.GetIndex();
+      /* Return the message if the robot has one, NULL otherwise */
+      if(nIndex < static_cast<ssize_t>(m_vecOHCMessages.size()) &&
+         (m_vecOHCValid[nIndex / 64] & (1ULL << (nIndex % 64)))) {
+         if(m_vecOHCShared[nIndex] >= 0)
+            return &m_vecSharedOHCMessages[m_vecOHCShared[nIndex]].Message;
+         return &m_vecOHCMessages[nIndex];
+      }
+      return NULL;
    }
 
    /****************************************/
@@ -349,7 +1019,51 @@ namespace argos {
                    "default behavior is to allow robots to complete message delivery according to a\n"
                    "random choice. If you don't want conflicts to be simulated, set the flag\n"
                    "'ignore_conflicts' to 'true':\n\n"
-                   "<kilobot_communication id=\"kbc\" ignore_conflicts=\"true\" />\n"
+                   "<kilobot_communication id=\"kbc\" ignore_conflicts=\"true\" />\n\n"
+                   "In dense swarms, the update of the medium can be spread over multiple threads\n"
+                   "by setting the attribute 'threads'. The arena is divided into square tiles, and\n"
+                   "the transmitting robots of each tile are processed by one thread. Every tile\n"
+                   "has its own random number generator, so the results are the same regardless of\n"
+                   "the number of threads. By default, the medium is updated by the simulation\n"
+                   "thread only:\n\n"
+                   "<kilobot_communication id=\"kbc\" threads=\"4\" />\n\n"
+                   "A robot receives at most 'max_rx' messages per time step (by default and at\n"
+                   "most, 4, as many as a Kilobot can process). A message from the overhead\n"
+                   "controller is passed to the robot first, and the messages from the other robots\n"
+                   "beyond 4 in total are dropped. When more messages arrive, the attribute\n"
+                   "'rx_policy' sets which ones are kept: 'id' (default) keeps the senders with the\n"
+                   "lowest index, 'distance' keeps the closest senders, and 'random' keeps a random\n"
+                   "selection. The kept messages are passed to the robot in the same order:\n\n"
+                   "<kilobot_communication id=\"kbc\" max_rx=\"4\" rx_policy=\"distance\" />\n\n"
+                   "The attribute 'model' selects how channel congestion is simulated. The default\n"
+                   "model, 'probabilistic', is described above. The 'csma' model simulates carrier\n"
+                   "sense multiple access with collision avoidance within each time step: a robot\n"
+                   "that wants to transmit waits for a random number of backoff slots, drawn from its\n"
+                   "contention window, then senses the channel. If another robot in range is\n"
+                   "transmitting, it backs off again; otherwise, it transmits. A robot receives a\n"
+                   "message only if it heard no other transmission at the same time. A transmitter\n"
+                   "that heard another transmission detects a collision, doubles its contention\n"
+                   "window and tries again; after a successful transmission, the window is reset.\n"
+                   "The model is tuned by the duration of a transmission 'tx_time' (in seconds,\n"
+                   "default 0.0035), the duration of a backoff slot 'slot_time' (in seconds, default\n"
+                   "0.000128), and the contention window bounds 'min_window' and 'max_window' (in\n"
+                   "slots, default 256 and 4096). The 'csma' model is always updated by the\n"
+                   "simulation thread only, regardless of 'threads':\n\n"
+                   "<kilobot_communication id=\"kbc\" model=\"csma\" tx_time=\"0.0035\"\n"
+                   "                       slot_time=\"0.000128\" min_window=\"256\"\n"
+                   "                       max_window=\"4096\" />\n\n"
+                   "By default, a robot sends its message at most once per time step, and the\n"
+                   "messages it receives are processed as if they arrived at the end of the step.\n"
+                   "When the time step is longer than the transmission period of the robots\n"
+                   "(kilo_tx_period), this lowers the message rate. Setting 'timestamps' to 'true'\n"
+                   "makes robots send their message every transmission period within the step,\n"
+                   "and delivers each message with its time of arrival: the behavior receives the\n"
+                   "messages in arrival order, with kilo_ticks set to the time of arrival, and\n"
+                   "kilo_message_tx_success() is called once per transmission. The 'max_rx' cap\n"
+                   "still applies to all the copies received in a step: a second copy from a sender\n"
+                   "is kept only after one message from each other sender, whatever 'rx_policy'.\n"
+                   "With many neighbors, a robot may thus receive fewer copies than were sent:\n\n"
+                   "<kilobot_communication id=\"kbc\" timestamps=\"true\" />\n"
                    ,
                    "Under development"
       );
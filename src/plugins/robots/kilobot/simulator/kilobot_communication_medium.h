@@ -8,10 +8,11 @@ namespace argos {
 }
 
 #include <argos3/core/utility/math/rng.h>
+#include <argos3/core/utility/math/vector2.h>
 #include <argos3/core/simulator/medium/medium.h>
-#include <argos3/core/simulator/space/positional_indices/positional_index.h>
 #include <argos3/plugins/robots/kilobot/simulator/kilobot_communication_entity.h>
-#include <unordered_map>
+#include <pthread.h>
+#include <vector>
 
 
 namespace argos {
@@ -20,8 +21,44 @@ namespace argos {
 
    public:
 
-      /** Defines the adjacency matrix */
-      typedef unordered_map<ssize_t, CSet<CKilobotCommunicationEntity*, SEntityComparator> > TAdjacencyMatrix;
+      /**
+       * The channel model.
+       */
+      enum EChannelModel {
+         CHANNEL_PROBABILISTIC = 0, // one random winner among conflicting robots per step
+         CHANNEL_CSMA               // carrier sense and backoff within the step
+      };
+
+      /**
+       * Which messages an inbox keeps when more arrive than it can hold.
+       */
+      enum ERxPolicy {
+         RX_POLICY_ID = 0,   // lowest sender index first
+         RX_POLICY_DISTANCE, // closest sender first
+         RX_POLICY_RANDOM    // random order
+      };
+
+      /**
+       * A message received by an entity.
+       */
+      struct SReceivedMessage {
+         /** The entity that sent the message */
+         CKilobotCommunicationEntity* Sender;
+         /** Number of earlier messages from the same sender in the inbox; lowest comes first */
+         UInt32 Copy;
+         /** Ordering key according to the receive policy; lowest comes first among equal copies */
+         Real Key;
+         /** Time into the step at which the message arrived */
+         Real Time;
+      };
+
+      /**
+       * The messages received by an entity in the last step, stored contiguously.
+       */
+      struct SInbox {
+         const SReceivedMessage* Messages;
+         UInt32 Size;
+      };
 
    public:
 
@@ -54,19 +91,19 @@ namespace argos {
       void RemoveEntity(CKilobotCommunicationEntity& c_entity);
 
       /**
-       * Returns an immutable vector of entities that can communicate with the given entity.
+       * Returns the messages received by the given entity in the last step.
+       * At most GetMaxRx() messages are kept, sorted according to the receive policy.
        * @param c_entity The wanted entity.
-       * @return An immutable vector of entities that can communicate with the given entity.       
+       * @return The inbox of the given entity.
        * @throws CARGoSException If the passed entity is not managed by this medium.
        */
-      const CSet<CKilobotCommunicationEntity*,SEntityComparator>& GetKilobotsCommunicatingWith(CKilobotCommunicationEntity& c_entity) const;
+      SInbox GetInbox(CKilobotCommunicationEntity& c_entity) const;
 
       /**
-       * Returns a reference to the adjacency matrix.
-       * @return A reference to the adjacency matrix.
+       * Returns the maximum number of messages an entity receives in a step.
        */
-      TAdjacencyMatrix& GetCommMatrix(){
-          return m_tCommMatrix;
+      inline UInt32 GetMaxRx() const {
+         return m_unMaxRx;
       }
 
       /**
@@ -82,6 +119,7 @@ namespace argos {
 
       /**
        * Sends a message to the given robots, as if it were done by the overhead controller.
+       * The message is stored once and shared by all the recipients.
        * Only one message per time step can be set.
        * Once set, a message stays until explicitly erased.
        * To erase a message, set it to NULL.
@@ -89,33 +127,386 @@ namespace argos {
        * @param pt_message The message payload.
        */
       void SendOHCMessageTo(std::vector<CKilobotEntity*>& vec_robots,
-                            message_t* Message);
+                            message_t* pt_message);
+
+      /**
+       * Sends a message to the robots within the given circle, as if it were done by the overhead controller.
+       * The message is stored once and shared by all the recipients, which are
+       * found through the bucket grid at their positions in the last update.
+       * Once set, a message stays until explicitly erased.
+       * To erase the messages of the robots in the circle, set it to NULL.
+       * @param c_center The center of the circle.
+       * @param f_radius The radius of the circle.
+       * @param pt_message The message payload.
+       * @return The number of recipients.
+       */
+      UInt32 SendOHCMessageToCircle(const CVector2& c_center,
+                                    Real f_radius,
+                                    const message_t* pt_message);
+
+      /**
+       * Sends a message to the robots within the given polygon, as if it were done by the overhead controller.
+       * The message is stored once and shared by all the recipients, which are
+       * found through the bucket grid at their positions in the last update.
+       * Once set, a message stays until explicitly erased.
+       * To erase the messages of the robots in the polygon, set it to NULL.
+       * @param vec_vertices The vertices of the polygon, in order.
+       * @param pt_message The message payload.
+       * @return The number of recipients.
+       */
+      UInt32 SendOHCMessageToPolygon(const std::vector<CVector2>& vec_vertices,
+                                     const message_t* pt_message);
+
+      /**
+       * Sends a different message to each of the given robots, as if it were done by the overhead controller.
+       * Robot vec_robots[i] gets message pt_messages[i].
+       * Once set, a message stays until explicitly erased.
+       * @param vec_robots The message recipients.
+       * @param pt_messages The message payloads, one per recipient.
+       */
+      void SendOHCMessagesTo(const std::vector<CKilobotEntity*>& vec_robots,
+                             const message_t* pt_messages);
+
+      /**
+       * Erases the overhead controller messages of all the robots.
+       */
+      void ClearOHCMessages();
 
       /**
        * Returns the OHC message for the given Kilobot.
+       * A message shared by several robots is returned at the same address to all of them.
        * @returns the OHC message payload (or NULL if no message is associated to the given robot)
        */
       message_t* GetOHCMessageFor(CKilobotEntity& c_robot);
 
    private:
 
-      /** The adjacency matrix, that associates each entity with the entities that communicate with it */
-      TAdjacencyMatrix m_tCommMatrix;
+      /**
+       * A message to deliver from a transmitter to a receiver.
+       */
+      struct SDelivery {
+         /** Dense index of the receiver */
+         UInt32 Receiver;
+         /** Dense index of the transmitter */
+         UInt32 Transmitter;
+         /** Ordering key according to the receive policy */
+         Real Key;
+         /** Time into the step at which the message arrived */
+         Real Time;
+      };
 
-      /** The adjacency matrix of neighbors of a transmitting robot who are also transmitting */
-      TAdjacencyMatrix m_tTxNeighbors;
+      struct SCsmaTransmission {
+         /** Dense index of the transmitter */
+         UInt32 Transmitter;
+         /** Start time of the transmission */
+         Real Start;
+         /** Position of the transmitter */
+         CVector2 Position;
+         /** Square transmission range */
+         Real SqRange;
+      };
 
-      /** A positional index for the kilobot communication entities */
-      CPositionalIndex<CKilobotCommunicationEntity>* m_pcKilobotIndex;
+      struct SCsmaState {
+         /** Current contention window, in slots */
+         UInt32 Window;
+         /** Whether a transmission attempt or end is scheduled */
+         bool Scheduled;
+         /** The transmission in progress, if any */
+         SCsmaTransmission Transmission;
+      };
 
-      /** The update operation for the grid positional index */
-      CKilobotCommunicationEntityGridEntityUpdater* m_pcGridUpdateOperation;
+      struct SCsmaEvent {
+         /** Time of the event */
+         Real Time;
+         /** Dense index of the robot concerned */
+         UInt32 Entity;
+         /** Whether this is the end of a transmission or an attempt */
+         bool End;
+         /* Ordering for a min-heap: earliest first, ends before attempts */
+         bool operator>(const SCsmaEvent& s_other) const {
+            if(Time != s_other.Time) return Time > s_other.Time;
+            if(End != s_other.End) return !End;
+            return Entity > s_other.Entity;
+         }
+      };
 
-      /** A list of messages set through SendOHCMessageTo() */
-      std::unordered_map<ssize_t, message_t*> m_mapOHCMessages;
+      /**
+       * The data of a tile, i.e., a square block of bucket grid cells whose
+       * transmitters are processed together.
+       */
+      struct STile {
+         /** Random number generator of the tile */
+         CRandom::CRNG* RNG;
+         /** The entities in range of the current transmitter, keyed by square distance */
+         std::vector<SDelivery> Receivers;
+         /** Messages delivered by the transmitters in the tile */
+         std::vector<SDelivery> Deliveries;
+      };
+
+      /**
+       * Sorts the managed entities into the cells of the bucket grid,
+       * and the transmitting entities into the tiles.
+       */
+      void UpdateGrid();
 
-      /** Random number generator */
-      CRandom::CRNG* m_pcRNG;
+      /**
+       * Resolves the conflicts and delivers the messages of the transmitters
+       * in the given tile.
+       * @param un_tile The index of the tile.
+       */
+      void UpdateTile(UInt32 un_tile);
+
+      /**
+       * Processes tiles until none is left.
+       */
+      void UpdateTiles();
+
+      /**
+       * Returns the bucket grid cell containing the given position.
+       */
+      UInt32 GetCell(const CVector2& c_position) const;
+
+      /**
+       * Returns whether a message with the given copy number and key ranks before a received one.
+       */
+      static bool IsBefore(UInt32 un_copy,
+                           Real f_key,
+                           const SReceivedMessage& s_message) {
+         return un_copy < s_message.Copy ||
+            (un_copy == s_message.Copy && f_key < s_message.Key);
+      }
+
+      /**
+       * Puts a message in the inbox of a receiver, if it fits.
+       * With timestamps, a sender can deliver several copies of its message in a step:
+       * a copy ranks after the messages of all the senders with fewer copies in the inbox,
+       * so the copies of one sender cannot push out the other senders.
+       * @param un_receiver The dense index of the receiver.
+       * @param un_transmitter The dense index of the transmitter.
+       * @param f_key The ordering key of the message.
+       * @param f_time The time into the step at which the message arrived.
+       */
+      void DeliverMessage(UInt32 un_receiver,
+                          UInt32 un_transmitter,
+                          Real f_key,
+                          Real f_time);
+
+      /**
+       * Runs the CSMA channel until the end of the current step.
+       */
+      void UpdateCsma();
+
+      /**
+       * Handles a robot whose backoff expired: it senses the channel,
+       * and transmits if the channel is free or backs off again if busy.
+       */
+      void StartCsmaTransmission(UInt32 un_entity,
+                                 Real f_time);
+
+      /**
+       * Handles the end of a transmission: it delivers the message to the
+       * receivers that heard no other transmission meanwhile, and tells
+       * the transmitter whether it detected a collision.
+       */
+      void EndCsmaTransmission(UInt32 un_entity);
+
+      /**
+       * Returns whether the given position is reached by a transmission
+       * overlapping the interval (f_from, f_to).
+       * @param c_position The position to check.
+       * @param f_from The start of the interval.
+       * @param f_to The end of the interval.
+       * @param un_skip The dense index of a transmitter to ignore.
+       */
+      bool IsChannelBusy(const CVector2& c_position,
+                         Real f_from,
+                         Real f_to,
+                         UInt32 un_skip);
+
+      /**
+       * Schedules an event of the CSMA channel.
+       */
+      void ScheduleCsmaEvent(Real f_time,
+                             UInt32 un_entity,
+                             bool b_end);
+
+      /**
+       * Forgets all the ongoing transmissions and scheduled events.
+       */
+      void ClearCsma();
+
+      /**
+       * Collects the dense indices of the entities whose bucket grid cell
+       * overlaps the given box into m_vecOHCCandidates.
+       * The cells are those of the last update, unless entities were added
+       * or removed since, in which case the grid is rebuilt first.
+       */
+      void GetEntitiesInBox(const CVector2& c_min,
+                            const CVector2& c_max);
+
+      /**
+       * Main loop of a worker thread.
+       */
+      void WorkerThread();
+
+      static void* StartWorkerThread(void* pt_medium);
+
+   private:
+
+      /** The managed entities, addressed by dense index */
+      CKilobotCommunicationEntity::TVector m_vecEntities;
+
+      /** Maps the space index of an entity to its dense index, or -1 if not managed */
+      std::vector<ssize_t> m_vecDenseIndices;
+
+      /** The inboxes, m_unMaxRx slots per entity in dense index order */
+      std::vector<SReceivedMessage> m_vecInboxes;
+
+      /** Number of messages in each inbox, addressed by dense index */
+      std::vector<UInt32> m_vecInboxSizes;
+
+      /** Capacity of an inbox */
+      UInt32 m_unMaxRx;
+
+      /** Which messages an inbox keeps when more arrive than it can hold */
+      ERxPolicy m_eRxPolicy;
+
+      /** Position of each entity on the XY plane, addressed by dense index */
+      std::vector<CVector2> m_vecPositions;
+
+      /** Square transmission range of each entity, addressed by dense index */
+      std::vector<Real> m_vecSqTxRanges;
+
+      /** Time between two transmissions of each entity, addressed by dense index */
+      std::vector<Real> m_vecTxPeriods;
+
+      /** Whether each entity is attempting transmission, addressed by dense index */
+      std::vector<UInt8> m_vecTxAttempts;
+
+      /** Bucket grid cell of each entity, addressed by dense index */
+      std::vector<UInt32> m_vecCellOf;
+
+      /** Start of each cell in m_vecCellEntities; the last element is the total */
+      std::vector<UInt32> m_vecCellStart;
+
+      /** Dense indices of the entities sorted by cell */
+      std::vector<UInt32> m_vecCellEntities;
+
+      /** Whether the sort by cell still matches the entities and the grid */
+      bool m_bCellsSorted;
+
+      /** Start of each tile in m_vecTransmitters; the last element is the total */
+      std::vector<UInt32> m_vecTileStart;
+
+      /** Dense indices of the entities attempting transmission, sorted by tile */
+      std::vector<UInt32> m_vecTransmitters;
+
+      /** The tiles */
+      std::vector<STile> m_vecTiles;
+
+      /** Corner of the arena with the smallest coordinates */
+      CVector2 m_cArenaMin;
+
+      /** Size of the arena */
+      CVector2 m_cArenaSize;
+
+      /** Side of a bucket grid cell, never smaller than the largest transmission range */
+      Real m_fCellSize;
+
+      /** Number of bucket grid cells along X */
+      UInt32 m_unCellsX;
+
+      /** Number of bucket grid cells along Y */
+      UInt32 m_unCellsY;
+
+      /** Number of tiles along X */
+      UInt32 m_unTilesX;
+
+      /** Number of threads updating the tiles, including the simulation thread */
+      UInt32 m_unThreads;
+
+      /** The worker threads */
+      std::vector<pthread_t> m_vecWorkers;
+
+      /** Protects the worker thread state */
+      pthread_mutex_t m_tWorkerMutex;
+
+      /** Signals the workers that an update started */
+      pthread_cond_t m_tWorkerStartCond;
+
+      /** Signals the simulation thread that the workers are done */
+      pthread_cond_t m_tWorkerDoneCond;
+
+      /** Counts the updates, so that workers can tell a new update started */
+      UInt32 m_unUpdateCounter;
+
+      /** Number of workers still working on the current update */
+      UInt32 m_unBusyWorkers;
+
+      /** Index of the next tile to process */
+      UInt32 m_unNextTile;
+
+      /** Whether the worker threads must quit */
+      bool m_bQuitWorkers;
+
+      /**
+       * Sets or erases the overhead controller message of the robot with the given index.
+       */
+      void SetOHCMessage(ssize_t n_index,
+                         const message_t* pt_message);
+
+      /**
+       * Makes the robot with the given index share the given overhead controller message.
+       */
+      void SetSharedOHCMessage(ssize_t n_index,
+                               UInt32 un_shared);
+
+      /**
+       * Stops the robot with the given index from sharing an overhead controller message.
+       */
+      void ReleaseSharedOHCMessage(ssize_t n_index);
+
+      /**
+       * Stores a message shared by several robots, and returns its index.
+       */
+      UInt32 AddSharedOHCMessage(const message_t* pt_message);
+
+      /**
+       * Stores a shared message and sets it for the robots in m_vecOHCCandidates
+       * that pass the given test, or erases their messages if pt_message is NULL.
+       * @return The number of recipients.
+       */
+      template<typename TEST>
+      UInt32 SendOHCMessageToCandidates(const message_t* pt_message,
+                                        const TEST& t_test);
+
+      /** A message shared by several robots */
+      struct SSharedOHCMessage {
+         message_t Message;
+         /** Number of robots sharing the message */
+         UInt32 Users;
+      };
+
+      /** The messages set through SendOHCMessageTo(), addressed by robot index */
+      std::vector<message_t> m_vecOHCMessages;
+
+      /** The shared message of each robot, or -1 if none, addressed by robot index */
+      std::vector<SInt32> m_vecOHCShared;
+
+      /** The messages shared by several robots */
+      std::vector<SSharedOHCMessage> m_vecSharedOHCMessages;
+
+      /** The unused slots of m_vecSharedOHCMessages */
+      std::vector<UInt32> m_vecFreeSharedOHCMessages;
+
+      /** Scratch buffer with the dense indices of the robots a message might be sent to */
+      std::vector<UInt32> m_vecOHCCandidates;
+
+      /** Robot index of each entity, addressed by dense index */
+      std::vector<UInt32> m_vecRobotIndices;
+
+      /** One bit per robot index, set if the robot has a message */
+      std::vector<UInt64> m_vecOHCValid;
 
       /** Probability of receiving a message */
       Real m_fRxProb;
@@ -123,6 +514,39 @@ namespace argos {
       /** Whether to ignore communication conflicts due to channel congestion */
       bool m_bIgnoreConflicts;
 
+      /** Whether messages are sent every transmission period and timestamped within the step */
+      bool m_bTimestamps;
+
+      /** The channel model */
+      EChannelModel m_eChannelModel;
+
+      /** CSMA: random number generator */
+      CRandom::CRNG* m_pcCsmaRNG;
+
+      /** CSMA: duration of a message transmission */
+      Real m_fCsmaTxTime;
+
+      /** CSMA: duration of a backoff slot */
+      Real m_fCsmaSlotTime;
+
+      /** CSMA: minimum contention window, in slots */
+      UInt32 m_unCsmaMinWindow;
+
+      /** CSMA: maximum contention window, in slots */
+      UInt32 m_unCsmaMaxWindow;
+
+      /** CSMA: time at the start of the current step */
+      Real m_fCsmaClock;
+
+      /** CSMA: state of each robot, addressed by dense index */
+      std::vector<SCsmaState> m_vecCsmaStates;
+
+      /** CSMA: the scheduled events, as a min-heap */
+      std::vector<SCsmaEvent> m_vecCsmaEvents;
+
+      /** CSMA: the recent transmissions in each bucket grid cell */
+      std::vector<std::vector<SCsmaTransmission> > m_vecCsmaCellTransmissions;
+
    };
 
 }
@@ -0,0 +1,462 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_light_field.cpp>
+ */
+
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/simulator/space/space.h>
+#include <argos3/core/simulator/entity/embodied_entity.h>
+#include <argos3/plugins/simulator/entities/box_entity.h>
+#include <argos3/plugins/simulator/entities/cylinder_entity.h>
+#include <argos3/plugins/simulator/entities/light_entity.h>
+
+#include "kilobot_collisions.h"
+#include "kilobot_entity.h"
+#include "kilobot_measures.h"
+#include "kilobot_light_field.h"
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   /** Side of a cell of the kilobot grid */
+   static const Real KILOBOT_GRID_CELL_SIZE = 0.05;
+
+   static const Real EPSILON = 1e-9;
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotLightField& CKilobotLightField::GetInstance() {
+      static CKilobotLightField cInstance;
+      return cInstance;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotLightField::EOcclusion CKilobotLightField::ParseOcclusion(const std::string& str_occlusion) {
+      if(str_occlusion == "physics") return OCCLUSION_PHYSICS;
+      if(str_occlusion == "grid")    return OCCLUSION_GRID;
+      if(str_occlusion == "static")  return OCCLUSION_STATIC;
+      if(str_occlusion == "none")    return OCCLUSION_NONE;
+      THROW_ARGOSEXCEPTION("Unknown occlusion mode \"" << str_occlusion << "\" for the kilobot light sensor: use \"physics\", \"grid\", \"static\" or \"none\"");
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CRadians CKilobotLightField::GetYaw(const CQuaternion& c_orientation) {
+      /* Same as the Z angle of CQuaternion::ToEulerAngles(), without the other two */
+      return ATan2(2.0 * (c_orientation.GetW() * c_orientation.GetZ() + c_orientation.GetX() * c_orientation.GetY()),
+                   1.0 - 2.0 * (c_orientation.GetY() * c_orientation.GetY() + c_orientation.GetZ() * c_orientation.GetZ()));
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotLightField::CKilobotLightField() :
+      m_unTick(0),
+      m_bValid(false),
+      m_bKilobotsValid(false),
+      m_unCellsX(0),
+      m_unCellsY(0),
+      m_fDiscsTop(0.0),
+      m_bBaked(false),
+      m_unBakeX(0),
+      m_unBakeY(0) {
+      pthread_mutex_init(&m_tUpdateMutex, NULL);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKilobotLightField::~CKilobotLightField() {
+      pthread_mutex_destroy(&m_tUpdateMutex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::Update(bool b_kilobots) {
+      UInt32 unTick = CSimulator::GetInstance().GetSpace().GetSimulationClock();
+      pthread_mutex_lock(&m_tUpdateMutex);
+      if(!m_bValid || m_unTick != unTick) {
+         UpdateLights();
+         UpdateObstacles();
+         m_unTick = unTick;
+         m_bValid = true;
+         m_bKilobotsValid = false;
+      }
+      if(b_kilobots && !m_bKilobotsValid) {
+         UpdateKilobots();
+         m_bKilobotsValid = true;
+      }
+      pthread_mutex_unlock(&m_tUpdateMutex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::Reset() {
+      pthread_mutex_lock(&m_tUpdateMutex);
+      m_bValid = false;
+      m_bKilobotsValid = false;
+      pthread_mutex_unlock(&m_tUpdateMutex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::UpdateBake(const SBakeSettings& s_settings) {
+      pthread_mutex_lock(&m_tUpdateMutex);
+      if(m_bBaked &&
+         (s_settings.Response != m_sBakeSettings.Response ||
+          s_settings.Resolution != m_sBakeSettings.Resolution ||
+          s_settings.Headings != m_sBakeSettings.Headings ||
+          s_settings.Occlusion != m_sBakeSettings.Occlusion)) {
+         pthread_mutex_unlock(&m_tUpdateMutex);
+         THROW_ARGOSEXCEPTION("All the kilobot light sensors baking the light field must use the same settings");
+      }
+      bool bChanged = !m_bBaked || m_vecBakedLights.size() != m_vecLights.size();
+      for(UInt32 i = 0; !bChanged && i < m_vecLights.size(); ++i) {
+         bChanged = m_vecLights[i].Intensity != m_vecBakedLights[i].Intensity ||
+            m_vecLights[i].Position.GetX() != m_vecBakedLights[i].Position.GetX() ||
+            m_vecLights[i].Position.GetY() != m_vecBakedLights[i].Position.GetY() ||
+            m_vecLights[i].Position.GetZ() != m_vecBakedLights[i].Position.GetZ();
+      }
+      if(bChanged) {
+         m_sBakeSettings = s_settings;
+         Bake();
+         m_vecBakedLights = m_vecLights;
+         m_bBaked = true;
+      }
+      pthread_mutex_unlock(&m_tUpdateMutex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::Bake() {
+      /* The texture covers the arena, borders included */
+      CSpace& cSpace = CSimulator::GetInstance().GetSpace();
+      const CVector3& cArenaCenter = cSpace.GetArenaCenter();
+      const CVector3& cArenaSize = cSpace.GetArenaSize();
+      Real fResolution = m_sBakeSettings.Resolution;
+      UInt32 unHeadings = m_sBakeSettings.Headings;
+      m_cBakeMin.Set(cArenaCenter.GetX() - 0.5 * cArenaSize.GetX(),
+                     cArenaCenter.GetY() - 0.5 * cArenaSize.GetY());
+      m_unBakeX = Max<UInt32>(1, Ceil(cArenaSize.GetX() / fResolution)) + 1;
+      m_unBakeY = Max<UInt32>(1, Ceil(cArenaSize.GetY() / fResolution)) + 1;
+      m_vecBaked.assign(m_unBakeX * m_unBakeY * unHeadings, 0.0f);
+      /* Kilobots move, so only boxes and cylinders occlude the baked lights */
+      EOcclusion eOcclusion = m_sBakeSettings.Occlusion == OCCLUSION_NONE ? OCCLUSION_NONE : OCCLUSION_STATIC;
+      /* Position of the sensor wrt the kilobot, for each heading */
+      std::vector<CVector2> vecOffsets(unHeadings);
+      std::vector<CRadians> vecYaws(unHeadings);
+      for(UInt32 h = 0; h < unHeadings; ++h) {
+         vecYaws[h] = CRadians::TWO_PI * (static_cast<Real>(h) / unHeadings);
+         vecOffsets[h].Set(KILOBOT_LIGHT_SENSOR_OFFSET.GetX(), KILOBOT_LIGHT_SENSOR_OFFSET.GetY());
+         vecOffsets[h].Rotate(vecYaws[h]);
+      }
+      /* Same computation as the light sensor, at each position and heading */
+      CVector3 cSensor, cRobotToLight;
+      Real fT;
+      for(UInt32 y = 0; y < m_unBakeY; ++y) {
+         for(UInt32 x = 0; x < m_unBakeX; ++x) {
+            float* pfTexel = &m_vecBaked[(y * m_unBakeX + x) * unHeadings];
+            for(UInt32 h = 0; h < unHeadings; ++h) {
+               cSensor.Set(m_cBakeMin.GetX() + x * fResolution + vecOffsets[h].GetX(),
+                           m_cBakeMin.GetY() + y * fResolution + vecOffsets[h].GetY(),
+                           KILOBOT_LIGHT_SENSOR_OFFSET.GetZ());
+               SInt32 nReading = 0;
+               for(UInt32 i = 0; i < m_vecLights.size(); ++i) {
+                  if(IsOccluded(cSensor, m_vecLights[i].Position, eOcclusion, NULL, fT)) continue;
+                  cRobotToLight = m_vecLights[i].Position - cSensor;
+                  cRobotToLight /= m_vecLights[i].Intensity;
+                  CRadians cAngleLightWrtKilobot = cRobotToLight.GetZAngle() - vecYaws[h];
+                  nReading += m_sBakeSettings.Response(
+                     cRobotToLight.Length(),
+                     Abs((cAngleLightWrtKilobot - KILOBOT_LIGHT_SENSOR_ANGLE).SignedNormalize()));
+               }
+               pfTexel[h] = nReading;
+            }
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   Real CKilobotLightField::GetBakedReading(const CVector3& c_position,
+                                            const CRadians& c_yaw) const {
+      UInt32 unHeadings = m_sBakeSettings.Headings;
+      /* Texture coordinates, clamped to the texture */
+      Real fX = (c_position.GetX() - m_cBakeMin.GetX()) / m_sBakeSettings.Resolution;
+      Real fY = (c_position.GetY() - m_cBakeMin.GetY()) / m_sBakeSettings.Resolution;
+      fX = Max<Real>(0.0, Min<Real>(fX, m_unBakeX - 1));
+      fY = Max<Real>(0.0, Min<Real>(fY, m_unBakeY - 1));
+      UInt32 unX0 = Min<UInt32>(Floor(fX), m_unBakeX - 2);
+      UInt32 unY0 = Min<UInt32>(Floor(fY), m_unBakeY - 2);
+      Real fWX = fX - unX0;
+      Real fWY = fY - unY0;
+      /* Headings wrap around */
+      Real fH = c_yaw.GetValue() / CRadians::TWO_PI.GetValue() * unHeadings;
+      SInt32 nH = Floor(fH);
+      Real fWH = fH - nH;
+      nH %= static_cast<SInt32>(unHeadings);
+      if(nH < 0) nH += unHeadings;
+      UInt32 unH0 = nH;
+      UInt32 unH1 = (unH0 + 1) % unHeadings;
+      const float* pfT00 = &m_vecBaked[(unY0 * m_unBakeX + unX0) * unHeadings];
+      const float* pfT10 = pfT00 + unHeadings;
+      const float* pfT01 = pfT00 + m_unBakeX * unHeadings;
+      const float* pfT11 = pfT01 + unHeadings;
+      Real fR0 = (1.0 - fWY) * ((1.0 - fWX) * pfT00[unH0] + fWX * pfT10[unH0]) +
+         fWY * ((1.0 - fWX) * pfT01[unH0] + fWX * pfT11[unH0]);
+      Real fR1 = (1.0 - fWY) * ((1.0 - fWX) * pfT00[unH1] + fWX * pfT10[unH1]) +
+         fWY * ((1.0 - fWX) * pfT01[unH1] + fWX * pfT11[unH1]);
+      return (1.0 - fWH) * fR0 + fWH * fR1;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::UpdateLights() {
+      m_vecLights.clear();
+      CSpace::TMapPerTypePerId& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerTypePerId();
+      CSpace::TMapPerTypePerId::iterator itLights = mapEntities.find("light");
+      if(itLights == mapEntities.end()) return;
+      for(CSpace::TMapPerType::iterator it = itLights->second.begin(); it != itLights->second.end(); ++it) {
+         CLightEntity& cLight = *any_cast<CLightEntity*>(it->second);
+         if(cLight.GetIntensity() > 0.0f) {
+            SLight sLight;
+            sLight.Position = cLight.GetPosition();
+            sLight.Intensity = cLight.GetIntensity();
+            m_vecLights.push_back(sLight);
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::UpdateObstacles() {
+      m_vecObstacles.clear();
+      CSpace::TMapPerTypePerId& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerTypePerId();
+      for(UInt32 unType = 0; unType < 2; ++unType) {
+         CSpace::TMapPerTypePerId::iterator itType = mapEntities.find(unType == 0 ? "box" : "cylinder");
+         if(itType == mapEntities.end()) continue;
+         for(CSpace::TMapPerType::iterator it = itType->second.begin(); it != itType->second.end(); ++it) {
+            SObstacle sObstacle;
+            CEmbodiedEntity* pcBody;
+            if(unType == 0) {
+               CBoxEntity& cBox = *any_cast<CBoxEntity*>(it->second);
+               pcBody = &cBox.GetEmbodiedEntity();
+               sObstacle.Box = true;
+               sObstacle.HalfSize.Set(cBox.GetSize().GetX() * 0.5, cBox.GetSize().GetY() * 0.5);
+               sObstacle.Height = cBox.GetSize().GetZ();
+            }
+            else {
+               CCylinderEntity& cCylinder = *any_cast<CCylinderEntity*>(it->second);
+               pcBody = &cCylinder.GetEmbodiedEntity();
+               sObstacle.Box = false;
+               sObstacle.HalfSize.Set(cCylinder.GetRadius(), cCylinder.GetRadius());
+               sObstacle.Height = cCylinder.GetHeight();
+            }
+            sObstacle.Position = pcBody->GetOriginAnchor().Position;
+            sObstacle.InverseOrientation = pcBody->GetOriginAnchor().Orientation.Inverse();
+            sObstacle.Movable = pcBody->IsMovable();
+            /* Bounding sphere of the body, whatever its orientation */
+            Real fReach = Sqrt(sObstacle.HalfSize.SquareLength() + sObstacle.Height * sObstacle.Height);
+            sObstacle.Min.Set(sObstacle.Position.GetX() - fReach, sObstacle.Position.GetY() - fReach);
+            sObstacle.Max.Set(sObstacle.Position.GetX() + fReach, sObstacle.Position.GetY() + fReach);
+            m_vecObstacles.push_back(sObstacle);
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKilobotLightField::UpdateKilobots() {
+      m_vecDiscs.clear();
+      m_fDiscsTop = -1e9;
+      CSpace& cSpace = CSimulator::GetInstance().GetSpace();
+      CSpace::TMapPerTypePerId& mapEntities = cSpace.GetEntityMapPerTypePerId();
+      CSpace::TMapPerTypePerId::iterator itKilobots = mapEntities.find("kilobot");
+      if(itKilobots != mapEntities.end()) {
+         for(CSpace::TMapPerType::iterator it = itKilobots->second.begin(); it != itKilobots->second.end(); ++it) {
+            CEmbodiedEntity& cBody = any_cast<CKilobotEntity*>(it->second)->GetEmbodiedEntity();
+            const CVector3& cPosition = cBody.GetOriginAnchor().Position;
+            SDisc sDisc;
+            sDisc.X = cPosition.GetX();
+            sDisc.Y = cPosition.GetY();
+            sDisc.Bottom = cPosition.GetZ();
+            sDisc.Top = cPosition.GetZ() + KILOBOT_HEIGHT;
+            sDisc.Entity = &cBody;
+            m_vecDiscs.push_back(sDisc);
+            if(sDisc.Top > m_fDiscsTop) m_fDiscsTop = sDisc.Top;
+         }
+      }
+      /* The grid covers the arena; the kilobots outside it are put in the border cells */
+      const CVector3& cArenaCenter = cSpace.GetArenaCenter();
+      const CVector3& cArenaSize = cSpace.GetArenaSize();
+      m_cGridMin.Set(cArenaCenter.GetX() - 0.5 * cArenaSize.GetX(),
+                     cArenaCenter.GetY() - 0.5 * cArenaSize.GetY());
+      m_unCellsX = Max<UInt32>(1, Ceil(cArenaSize.GetX() / KILOBOT_GRID_CELL_SIZE));
+      m_unCellsY = Max<UInt32>(1, Ceil(cArenaSize.GetY() / KILOBOT_GRID_CELL_SIZE));
+      m_vecCellStart.assign(m_unCellsX * m_unCellsY + 1, 0);
+      /* Count the discs per cell, then place them */
+      for(UInt32 p = 0; p < 2; ++p) {
+         for(UInt32 i = 0; i < m_vecDiscs.size(); ++i) {
+            SInt32 nMinX = Floor((m_vecDiscs[i].X - KILOBOT_RADIUS - m_cGridMin.GetX()) / KILOBOT_GRID_CELL_SIZE);
+            SInt32 nMaxX = Floor((m_vecDiscs[i].X + KILOBOT_RADIUS - m_cGridMin.GetX()) / KILOBOT_GRID_CELL_SIZE);
+            SInt32 nMinY = Floor((m_vecDiscs[i].Y - KILOBOT_RADIUS - m_cGridMin.GetY()) / KILOBOT_GRID_CELL_SIZE);
+            SInt32 nMaxY = Floor((m_vecDiscs[i].Y + KILOBOT_RADIUS - m_cGridMin.GetY()) / KILOBOT_GRID_CELL_SIZE);
+            nMinX = Max<SInt32>(0, Min<SInt32>(nMinX, m_unCellsX - 1));
+            nMaxX = Max<SInt32>(0, Min<SInt32>(nMaxX, m_unCellsX - 1));
+            nMinY = Max<SInt32>(0, Min<SInt32>(nMinY, m_unCellsY - 1));
+            nMaxY = Max<SInt32>(0, Min<SInt32>(nMaxY, m_unCellsY - 1));
+            for(SInt32 y = nMinY; y <= nMaxY; ++y) {
+               for(SInt32 x = nMinX; x <= nMaxX; ++x) {
+                  UInt32 unCell = y * m_unCellsX + x;
+                  if(p == 0) ++m_vecCellStart[unCell + 1];
+                  else m_vecCellDiscs[m_vecCellStart[unCell]++] = i;
+               }
+            }
+         }
+         if(p == 0) {
+            for(UInt32 c = 1; c < m_vecCellStart.size(); ++c) {
+               m_vecCellStart[c] += m_vecCellStart[c - 1];
+            }
+            m_vecCellDiscs.resize(m_vecCellStart.back());
+         }
+      }
+      /* Placing the discs moved each start to the next cell: shift back */
+      for(UInt32 c = m_vecCellStart.size() - 1; c > 0; --c) {
+         m_vecCellStart[c] = m_vecCellStart[c - 1];
+      }
+      m_vecCellStart[0] = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKilobotLightField::IsOccluded(const CVector3& c_start,
+                                       const CVector3& c_end,
+                                       EOcclusion e_occlusion,
+                                       const CEmbodiedEntity* pc_ignored,
+                                       Real& f_t_on_ray) const {
+      if(e_occlusion == OCCLUSION_NONE || e_occlusion == OCCLUSION_PHYSICS) return false;
+      bool bOccluded = IntersectObstacles(c_start, c_end, e_occlusion == OCCLUSION_GRID, f_t_on_ray);
+      if(e_occlusion == OCCLUSION_GRID) {
+         Real fT;
+         if(IntersectKilobots(c_start, c_end, pc_ignored, fT) && (!bOccluded || fT < f_t_on_ray)) {
+            f_t_on_ray = fT;
+            bOccluded = true;
+         }
+      }
+      return bOccluded;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKilobotLightField::IntersectObstacles(const CVector3& c_start,
+                                               const CVector3& c_end,
+                                               bool b_movable,
+                                               Real& f_t_on_ray) const {
+      CVector2 cMin(Min(c_start.GetX(), c_end.GetX()), Min(c_start.GetY(), c_end.GetY()));
+      CVector2 cMax(Max(c_start.GetX(), c_end.GetX()), Max(c_start.GetY(), c_end.GetY()));
+      bool bOccluded = false;
+      for(UInt32 i = 0; i < m_vecObstacles.size(); ++i) {
+         const SObstacle& sObstacle = m_vecObstacles[i];
+         if(sObstacle.Movable && !b_movable) continue;
+         if(cMax.GetX() < sObstacle.Min.GetX() || cMin.GetX() > sObstacle.Max.GetX() ||
+            cMax.GetY() < sObstacle.Min.GetY() || cMin.GetY() > sObstacle.Max.GetY())
+            continue;
+         /* Test the segment in the frame of the obstacle */
+         CVector3 cStart(c_start - sObstacle.Position);
+         cStart.Rotate(sObstacle.InverseOrientation);
+         CVector3 cDelta(c_end - c_start);
+         cDelta.Rotate(sObstacle.InverseOrientation);
+         Real fT;
+         bool bHit = sObstacle.Box ?
+            IntersectSegmentWithBox(cStart, cDelta, sObstacle.HalfSize, sObstacle.Height, fT) :
+            IntersectSegmentWithCylinder(cStart, cDelta, sObstacle.HalfSize.GetX(), 0.0, sObstacle.Height, fT);
+         if(bHit && (!bOccluded || fT < f_t_on_ray)) {
+            f_t_on_ray = fT;
+            bOccluded = true;
+         }
+      }
+      return bOccluded;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKilobotLightField::IntersectKilobots(const CVector3& c_start,
+                                              const CVector3& c_end,
+                                              const CEmbodiedEntity* pc_ignored,
+                                              Real& f_t_on_ray) const {
+      /* Segments above all the kilobots, as those towards a light over the arena, are not occluded */
+      if(m_vecDiscs.empty() || Min(c_start.GetZ(), c_end.GetZ()) > m_fDiscsTop) return false;
+      CVector3 cDelta(c_end - c_start);
+      /* Restrict the segment to the grid */
+      Real fTEnter = 0.0, fTExit = 1.0;
+      if(!ClipSegmentToSlab(c_start.GetX(), cDelta.GetX(), m_cGridMin.GetX(), m_cGridMin.GetX() + m_unCellsX * KILOBOT_GRID_CELL_SIZE, fTEnter, fTExit) ||
+         !ClipSegmentToSlab(c_start.GetY(), cDelta.GetY(), m_cGridMin.GetY(), m_cGridMin.GetY() + m_unCellsY * KILOBOT_GRID_CELL_SIZE, fTEnter, fTExit))
+         return false;
+      /* Walk the cells crossed by the segment, in order */
+      Real fX = c_start.GetX() + fTEnter * cDelta.GetX() - m_cGridMin.GetX();
+      Real fY = c_start.GetY() + fTEnter * cDelta.GetY() - m_cGridMin.GetY();
+      SInt32 nX = Max<SInt32>(0, Min<SInt32>(Floor(fX / KILOBOT_GRID_CELL_SIZE), m_unCellsX - 1));
+      SInt32 nY = Max<SInt32>(0, Min<SInt32>(Floor(fY / KILOBOT_GRID_CELL_SIZE), m_unCellsY - 1));
+      SInt32 nStepX = cDelta.GetX() > 0.0 ? 1 : -1;
+      SInt32 nStepY = cDelta.GetY() > 0.0 ? 1 : -1;
+      Real fTMaxX = 2.0, fTDeltaX = 2.0;
+      Real fTMaxY = 2.0, fTDeltaY = 2.0;
+      if(Abs(cDelta.GetX()) > EPSILON) {
+         fTMaxX = ((nX + (nStepX > 0 ? 1 : 0)) * KILOBOT_GRID_CELL_SIZE + m_cGridMin.GetX() - c_start.GetX()) / cDelta.GetX();
+         fTDeltaX = KILOBOT_GRID_CELL_SIZE / Abs(cDelta.GetX());
+      }
+      if(Abs(cDelta.GetY()) > EPSILON) {
+         fTMaxY = ((nY + (nStepY > 0 ? 1 : 0)) * KILOBOT_GRID_CELL_SIZE + m_cGridMin.GetY() - c_start.GetY()) / cDelta.GetY();
+         fTDeltaY = KILOBOT_GRID_CELL_SIZE / Abs(cDelta.GetY());
+      }
+      Real fBest = 2.0;
+      while(true) {
+         UInt32 unCell = nY * m_unCellsX + nX;
+         for(UInt32 i = m_vecCellStart[unCell]; i < m_vecCellStart[unCell + 1]; ++i) {
+            const SDisc& sDisc = m_vecDiscs[m_vecCellDiscs[i]];
+            if(sDisc.Entity == pc_ignored) continue;
+            Real fT;
+            if(IntersectSegmentWithCylinder(CVector3(c_start.GetX() - sDisc.X, c_start.GetY() - sDisc.Y, c_start.GetZ()),
+                                 cDelta, KILOBOT_RADIUS, sDisc.Bottom, sDisc.Top, fT) &&
+               fT < fBest) {
+               fBest = fT;
+            }
+         }
+         /* A hit before the end of this cell is the closest: the cells after it are farther */
+         Real fTCellExit = Min(fTMaxX, fTMaxY);
+         if(fBest <= fTCellExit || fTCellExit >= fTExit) break;
+         if(fTMaxX < fTMaxY) {
+            nX += nStepX;
+            fTMaxX += fTDeltaX;
+         }
+         else {
+            nY += nStepY;
+            fTMaxY += fTDeltaY;
+         }
+         if(nX < 0 || nX >= (SInt32)m_unCellsX || nY < 0 || nY >= (SInt32)m_unCellsY) break;
+      }
+      if(fBest > 1.0) return false;
+      f_t_on_ray = fBest;
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+}
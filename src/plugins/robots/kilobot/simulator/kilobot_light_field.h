@@ -0,0 +1,236 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kilobot_light_field.h>
+ *
+ * @brief This file provides the light field shared by the kilobot light sensors.
+ *
+ * The light field gathers the lights of the space once per tick, instead of once
+ * per sensor, and checks the occlusion of a light geometrically: kilobots are
+ * upright cylinders found through a uniform grid, boxes and cylinders are tested
+ * in their own frame. This avoids casting a ray through the physics engines for
+ * every robot and every light.
+ *
+ * When the lights and obstacles do not move, the light field can also bake the
+ * readings of a sensor in a texture indexed by position and heading, so that a
+ * sensor only interpolates a few values per tick.
+ */
+
+#ifndef KILOBOT_LIGHT_FIELD_H
+#define KILOBOT_LIGHT_FIELD_H
+
+namespace argos {
+   class CKilobotLightField;
+   class CEmbodiedEntity;
+}
+
+#include <argos3/core/utility/math/angles.h>
+#include <argos3/core/utility/math/quaternion.h>
+#include <argos3/core/utility/math/vector2.h>
+#include <argos3/core/utility/math/vector3.h>
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace argos {
+
+   class CKilobotLightField {
+
+   public:
+
+      /** How a light sensor checks whether a light is occluded */
+      enum EOcclusion {
+         /** Ray casting through the physics engines, against all the embodied entities */
+         OCCLUSION_PHYSICS = 0,
+         /** Kilobots, boxes and cylinders */
+         OCCLUSION_GRID,
+         /** Boxes and cylinders that are not movable */
+         OCCLUSION_STATIC,
+         /** No occlusion */
+         OCCLUSION_NONE
+      };
+
+      /** A light with non zero intensity */
+      struct SLight {
+         CVector3 Position;
+         Real Intensity;
+      };
+
+      /**
+       * The response of a sensor to a light, given the distance to the light scaled by
+       * its intensity, and the angle between the light and the optimal reception direction.
+       */
+      typedef SInt16 (*TResponse)(const Real f_distance,
+                                  const CRadians& c_angular_distance);
+
+      /** How the readings are baked */
+      struct SBakeSettings {
+         TResponse Response;
+         /** Distance between two positions of the texture */
+         Real Resolution;
+         /** Number of headings of the texture */
+         UInt32 Headings;
+         /** The obstacles occluding the lights; kilobots are never considered */
+         EOcclusion Occlusion;
+      };
+
+   public:
+
+      /**
+       * Returns the light field of the space.
+       */
+      static CKilobotLightField& GetInstance();
+
+      /**
+       * Parses the value of the <tt>occlusion</tt> attribute of a sensor.
+       * @throws CARGoSException If the value is unknown.
+       */
+      static EOcclusion ParseOcclusion(const std::string& str_occlusion);
+
+      /**
+       * Returns the rotation of an orientation around the Z axis.
+       */
+      static CRadians GetYaw(const CQuaternion& c_orientation);
+
+      /**
+       * Brings the lights and the obstacles up to date with the current tick.
+       * The first call of a tick does the work, the others return at once.
+       * It can be called by sensors updated in parallel.
+       * @param b_kilobots Whether the kilobots are needed as obstacles at this tick.
+       */
+      void Update(bool b_kilobots);
+
+      /**
+       * Forces the next Update() to gather everything again.
+       */
+      void Reset();
+
+      /**
+       * Returns the lights with non zero intensity.
+       */
+      inline const std::vector<SLight>& GetLights() const {
+         return m_vecLights;
+      }
+
+      /**
+       * Bakes the readings of the sensors if it was not done yet, or if a light changed
+       * position or intensity since. It must be called after Update(), and can be called
+       * by sensors updated in parallel.
+       * @throws CARGoSException If the settings differ from those of another sensor.
+       */
+      void UpdateBake(const SBakeSettings& s_settings);
+
+      /**
+       * Returns the baked reading of a kilobot, interpolated between the closest positions
+       * and headings of the texture.
+       * @param c_position The position of the kilobot.
+       * @param c_yaw The rotation of the kilobot around the Z axis.
+       */
+      Real GetBakedReading(const CVector3& c_position,
+                           const CRadians& c_yaw) const;
+
+      /**
+       * Checks whether the segment between two points crosses an obstacle.
+       * @param c_start The start of the segment.
+       * @param c_end The end of the segment.
+       * @param e_occlusion The obstacles to consider, OCCLUSION_GRID or OCCLUSION_STATIC.
+       * @param pc_ignored The body of the sensing robot, which is not an obstacle.
+       * @param f_t_on_ray Set to the position of the closest intersection on the segment, in [0,1].
+       * @return true if the segment is occluded.
+       */
+      bool IsOccluded(const CVector3& c_start,
+                      const CVector3& c_end,
+                      EOcclusion e_occlusion,
+                      const CEmbodiedEntity* pc_ignored,
+                      Real& f_t_on_ray) const;
+
+   private:
+
+      /** A box or a cylinder */
+      struct SObstacle {
+         /** The origin of the body, at the center of its base */
+         CVector3 Position;
+         CQuaternion InverseOrientation;
+         bool Box;
+         /** Half the size of a box on X and Y, or the radius of a cylinder on X */
+         CVector2 HalfSize;
+         Real Height;
+         bool Movable;
+         /** Bounding rectangle on the XY plane */
+         CVector2 Min;
+         CVector2 Max;
+      };
+
+      /** The body of a kilobot */
+      struct SDisc {
+         Real X;
+         Real Y;
+         Real Bottom;
+         Real Top;
+         const CEmbodiedEntity* Entity;
+      };
+
+   private:
+
+      CKilobotLightField();
+
+      ~CKilobotLightField();
+
+      void UpdateLights();
+
+      void UpdateObstacles();
+
+      void UpdateKilobots();
+
+      void Bake();
+
+      bool IntersectObstacles(const CVector3& c_start,
+                              const CVector3& c_end,
+                              bool b_movable,
+                              Real& f_t_on_ray) const;
+
+      bool IntersectKilobots(const CVector3& c_start,
+                             const CVector3& c_end,
+                             const CEmbodiedEntity* pc_ignored,
+                             Real& f_t_on_ray) const;
+
+   private:
+
+      /** Serializes the updates of the sensors running in parallel */
+      pthread_mutex_t m_tUpdateMutex;
+
+      /** The tick of the last update */
+      UInt32 m_unTick;
+
+      /** Whether the data matches m_unTick */
+      bool m_bValid;
+      bool m_bKilobotsValid;
+
+      std::vector<SLight> m_vecLights;
+
+      std::vector<SObstacle> m_vecObstacles;
+
+      /** The kilobots, with a grid of their indices per cell */
+      std::vector<SDisc> m_vecDiscs;
+      std::vector<UInt32> m_vecCellStart;
+      std::vector<UInt32> m_vecCellDiscs;
+      CVector2 m_cGridMin;
+      UInt32 m_unCellsX;
+      UInt32 m_unCellsY;
+
+      /** The highest top of the kilobots; higher segments are not occluded by them */
+      Real m_fDiscsTop;
+
+      /** The baked readings, by position on Y, then on X, then by heading */
+      std::vector<float> m_vecBaked;
+      SBakeSettings m_sBakeSettings;
+      /** The lights the readings were baked with */
+      std::vector<SLight> m_vecBakedLights;
+      bool m_bBaked;
+      CVector2 m_cBakeMin;
+      UInt32 m_unBakeX;
+      UInt32 m_unBakeY;
+   };
+
+}
+
+#endif
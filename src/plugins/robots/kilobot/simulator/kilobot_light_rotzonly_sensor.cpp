@@ -46,7 +46,15 @@ namespace argos {
       m_bShowRays(false),
       m_pcRNG(NULL),
       m_bAddNoise(false),
-      m_cSpace(CSimulator::GetInstance().GetSpace()) {}
+      m_cSpace(CSimulator::GetInstance().GetSpace()),
+      m_cLightField(CKilobotLightField::GetInstance()),
+      m_eOcclusion(CKilobotLightField::OCCLUSION_PHYSICS),
+      m_bBake(false) {
+      m_sBakeSettings.Response = &ComputeReading;
+      m_sBakeSettings.Resolution = 0.01;
+      m_sBakeSettings.Headings = 32;
+      m_sBakeSettings.Occlusion = m_eOcclusion;
+   }
 
    /****************************************/
    /****************************************/
@@ -81,6 +89,18 @@ namespace argos {
             m_cNoiseRange.Set(-fNoiseLevel*SENSOR_RANGE.GetMax(), fNoiseLevel*SENSOR_RANGE.GetMax());
             m_pcRNG = CRandom::CreateRNG("argos");
          }
+         /* Parse occlusion mode */
+         std::string strOcclusion = "physics";
+         GetNodeAttributeOrDefault(t_tree, "occlusion", strOcclusion, strOcclusion);
+         m_eOcclusion = CKilobotLightField::ParseOcclusion(strOcclusion);
+         /* Parse the settings of the baked light field */
+         GetNodeAttributeOrDefault(t_tree, "bake", m_bBake, m_bBake);
+         GetNodeAttributeOrDefault(t_tree, "bake_resolution", m_sBakeSettings.Resolution, m_sBakeSettings.Resolution);
+         GetNodeAttributeOrDefault(t_tree, "bake_headings", m_sBakeSettings.Headings, m_sBakeSettings.Headings);
+         if(m_sBakeSettings.Resolution <= 0.0f || m_sBakeSettings.Headings == 0) {
+            THROW_ARGOSEXCEPTION("The resolution and the number of headings of the baked light field must be positive");
+         }
+         m_sBakeSettings.Occlusion = m_eOcclusion;
       }
       catch(CARGoSException& ex) {
          THROW_ARGOSEXCEPTION_NESTED("Initialization error in rot_z_only light sensor", ex);
@@ -93,11 +113,20 @@ namespace argos {
    void CKilobotLightRotZOnlySensor::Update() {
       /* Erase reading */
       m_nReading = 0;
+      /* Gather the lights once per tick for all the sensors */
+      m_cLightField.Update(!m_bBake && m_eOcclusion == CKilobotLightField::OCCLUSION_GRID);
       /* Get kilobot orientation in the world */
-      CRadians cOrientationZ, cOrientationY, cOrientationX;
-      m_pcEmbodiedEntity->GetOriginAnchor().Orientation.ToEulerAngles(cOrientationZ,
-                                                                      cOrientationY,
-                                                                      cOrientationX);
+      CRadians cOrientationZ = CKilobotLightField::GetYaw(m_pcEmbodiedEntity->GetOriginAnchor().Orientation);
+      if(m_bBake) {
+         /* Interpolate the readings baked when the lights last changed */
+         m_cLightField.UpdateBake(m_sBakeSettings);
+         m_nReading = Round(m_cLightField.GetBakedReading(m_pcEmbodiedEntity->GetOriginAnchor().Position,
+                                                           cOrientationZ));
+         if(m_bAddNoise)
+            m_nReading += m_pcRNG->Uniform(m_cNoiseRange);
+         SENSOR_RANGE.TruncValue(m_nReading);
+         return;
+      }
       /* Ray used for scanning the environment for obstacles */
       CRay3 cOcclusionCheckRay;
       cOcclusionCheckRay.SetStart(m_pcLightEntity->GetSensor(0).Anchor.Position);
@@ -106,8 +135,9 @@ namespace argos {
       CRadians cAngleLightWrtKilobot;
       /* Buffers to contain data about the intersection */
       SEmbodiedEntityIntersectionItem sIntersection;
-      /* List of light entities */
-      CSpace::TMapPerType& mapLights = m_cSpace.GetEntitiesByType("light");
+      bool bOccluded;
+      /* List of lights with non zero intensity */
+      const std::vector<CKilobotLightField::SLight>& vecLights = m_cLightField.GetLights();
       /*
        * 1. go through the list of light entities in the scene
        * 2. check if a light is occluded
@@ -115,44 +145,50 @@ namespace argos {
        *    NOTE: the readings are additive
        * 4. go through the sensors and clamp their values
        */
-      for(CSpace::TMapPerType::iterator it = mapLights.begin(); it != mapLights.end(); ++it) {
-         /* Get a reference to the light */
-         CLightEntity& cLight = *(any_cast<CLightEntity*>(it->second));
-         /* Consider the light only if it has non zero intensity */
-         if(cLight.GetIntensity() > 0.0f) {
-            /* Set the ray end */
-            cOcclusionCheckRay.SetEnd(cLight.GetPosition());
-            /* Check occlusion between the kilobot and the light */
-            if( !GetClosestEmbodiedEntityIntersectedByRay(sIntersection,
-                                                          cOcclusionCheckRay,
-                                                          *m_pcEmbodiedEntity)) {
-               /* The light is not occluded */
-               if(m_bShowRays)
-                  m_pcControllableEntity->AddCheckedRay(false, cOcclusionCheckRay);
-               /* Get the distance between the light and the kilobot */
-               cOcclusionCheckRay.ToVector(cRobotToLight);
-               /*
-                * Linearly scale the distance with the light intensity
-                * The greater the intensity, the smaller the distance
-                */
-               cRobotToLight /= cLight.GetIntensity();
-               /* Get the angle wrt to kilobot rotation */
-               cAngleLightWrtKilobot = cRobotToLight.GetZAngle();
-               cAngleLightWrtKilobot -= cOrientationZ;
-               /* Set the actual readings */
-               Real fReading = cRobotToLight.Length();
-               CRadians cAngularDistanceFromOptimalLightReceptionPoint =
-                  Abs((cAngleLightWrtKilobot - KILOBOT_LIGHT_SENSOR_ANGLE).SignedNormalize());
-               m_nReading += ComputeReading(fReading,
-                                            cAngularDistanceFromOptimalLightReceptionPoint);
-            }
-            else {
-               /* The ray is occluded */
-               if(m_bShowRays) {
-                  m_pcControllableEntity->AddCheckedRay(true, cOcclusionCheckRay);
-                  m_pcControllableEntity->AddIntersectionPoint(cOcclusionCheckRay,
-                                                               sIntersection.TOnRay);
-               }
+      for(size_t i = 0; i < vecLights.size(); ++i) {
+         const CKilobotLightField::SLight& sLight = vecLights[i];
+         /* Set the ray end */
+         cOcclusionCheckRay.SetEnd(sLight.Position);
+         /* Check occlusion between the kilobot and the light */
+         if(m_eOcclusion == CKilobotLightField::OCCLUSION_PHYSICS) {
+            bOccluded = GetClosestEmbodiedEntityIntersectedByRay(sIntersection,
+                                                                 cOcclusionCheckRay,
+                                                                 *m_pcEmbodiedEntity);
+         }
+         else {
+            bOccluded = m_cLightField.IsOccluded(cOcclusionCheckRay.GetStart(),
+                                                 cOcclusionCheckRay.GetEnd(),
+                                                 m_eOcclusion,
+                                                 m_pcEmbodiedEntity,
+                                                 sIntersection.TOnRay);
+         }
+         if(!bOccluded) {
+            /* The light is not occluded */
+            if(m_bShowRays)
+               m_pcControllableEntity->AddCheckedRay(false, cOcclusionCheckRay);
+            /* Get the distance between the light and the kilobot */
+            cOcclusionCheckRay.ToVector(cRobotToLight);
+            /*
+             * Linearly scale the distance with the light intensity
+             * The greater the intensity, the smaller the distance
+             */
+            cRobotToLight /= sLight.Intensity;
+            /* Get the angle wrt to kilobot rotation */
+            cAngleLightWrtKilobot = cRobotToLight.GetZAngle();
+            cAngleLightWrtKilobot -= cOrientationZ;
+            /* Set the actual readings */
+            Real fReading = cRobotToLight.Length();
+            CRadians cAngularDistanceFromOptimalLightReceptionPoint =
+               Abs((cAngleLightWrtKilobot - KILOBOT_LIGHT_SENSOR_ANGLE).SignedNormalize());
+            m_nReading += ComputeReading(fReading,
+                                         cAngularDistanceFromOptimalLightReceptionPoint);
+         }
+         else {
+            /* The ray is occluded */
+            if(m_bShowRays) {
+               m_pcControllableEntity->AddCheckedRay(true, cOcclusionCheckRay);
+               m_pcControllableEntity->AddIntersectionPoint(cOcclusionCheckRay,
+                                                            sIntersection.TOnRay);
             }
          }
       }
@@ -168,6 +204,7 @@ namespace argos {
 
    void CKilobotLightRotZOnlySensor::Reset() {
       m_nReading = 0;
+      m_cLightField.Reset();
    }
 
    /****************************************/
@@ -243,8 +280,48 @@ namespace argos {
                    "    </my_controller>\n"
                    "    ...\n"
                    "  </controllers>\n\n"
-                   "OPTIONAL XML CONFIGURATION\n\n"
-                   "None.\n",
+                   "By default, the occlusion of each light is checked by casting a ray through the\n"
+                   "physics engines. The attribute \"occlusion\" selects a faster check, shared by all\n"
+                   "the kilobot light sensors: \"grid\" considers kilobots, boxes and cylinders only,\n"
+                   "\"static\" only the boxes and cylinders that are not movable, and \"none\" ignores\n"
+                   "occlusions altogether.\n\n"
+                   "When lights and obstacles do not move, the attribute \"bake\" makes the sensors\n"
+                   "read a texture of the light field computed once, at the first step and again\n"
+                   "whenever a light changes position or intensity. The texture holds the reading\n"
+                   "of a kilobot every \"bake_resolution\" meters (default 0.01) and for\n"
+                   "\"bake_headings\" orientations (default 32), and is interpolated in between.\n"
+                   "Only boxes and cylinders that are not movable occlude the baked lights, unless\n"
+                   "\"occlusion\" is \"none\", and no ray is drawn. All the sensors must use the\n"
+                   "same settings.\n\n"
+                   "  <controllers>\n"
+                   "    ...\n"
+                   "    <my_controller ...>\n"
+                   "      ...\n"
+                   "      <sensors>\n"
+                   "        ...\n"
+                   "        <kilobot_light implementation=\"rot_z_only\"\n"
+                   "                       bake=\"true\"\n"
+                   "                       bake_resolution=\"0.005\" />\n"
+                   "        ...\n"
+                   "      </sensors>\n"
+                   "      ...\n"
+                   "    </my_controller>\n"
+                   "    ...\n"
+                   "  </controllers>\n\n"
+                   "  <controllers>\n"
+                   "    ...\n"
+                   "    <my_controller ...>\n"
+                   "      ...\n"
+                   "      <sensors>\n"
+                   "        ...\n"
+                   "        <kilobot_light implementation=\"rot_z_only\"\n"
+                   "                       occlusion=\"grid\" />\n"
+                   "        ...\n"
+                   "      </sensors>\n"
+                   "      ...\n"
+                   "    </my_controller>\n"
+                   "    ...\n"
+                   "  </controllers>\n\n",
                    "Usable"
       );
 
@@ -17,6 +17,7 @@ namespace argos {
 }
 
 #include <argos3/plugins/robots/kilobot/control_interface/ci_kilobot_light_sensor.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_light_field.h>
 #include <argos3/core/utility/math/range.h>
 #include <argos3/core/utility/math/rng.h>
 #include <argos3/core/simulator/space/space.h>
@@ -66,6 +67,18 @@ namespace argos {
 
       /** Reference to the space */
       CSpace& m_cSpace;
+
+      /** The lights and obstacles shared by all the kilobot light sensors */
+      CKilobotLightField& m_cLightField;
+
+      /** How the occlusion of the lights is checked */
+      CKilobotLightField::EOcclusion m_eOcclusion;
+
+      /** Whether to read the light field baked for static lights */
+      bool m_bBake;
+
+      /** How the light field is baked */
+      CKilobotLightField::SBakeSettings m_sBakeSettings;
    };
 
 }
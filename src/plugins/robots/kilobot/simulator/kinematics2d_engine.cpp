@@ -0,0 +1,551 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_engine.cpp>
+ */
+
+#include "kinematics2d_engine.h"
+#include "kinematics2d_kilobot_model.h"
+#include "kinematics2d_obstacle_model.h"
+#include "kilobot_measures.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace argos {
+
+   enum KILOBOT_WHEELS {
+      KILOBOT_LEFT_WHEEL = 0,
+      KILOBOT_RIGHT_WHEEL = 1
+   };
+
+   /** Distance between the centers of two kilobots in contact */
+   static const Real KILOBOT_CONTACT_DISTANCE = KILOBOT_RADIUS + KILOBOT_RADIUS;
+
+   /** Maximum number of cells of the obstacle grid on each axis */
+   static const Real OBSTACLE_GRID_MAX_CELLS = 256.0;
+
+   /****************************************/
+   /****************************************/
+
+   /*
+    * Checks whether a kilobot body centered in (f_x,f_y) overlaps an obstacle.
+    * If it does, (f_dx,f_dy) is set to the shortest move that separates them.
+    */
+   static bool PenetrateObstacle(const CKinematics2DEngine::SObstacle& s_obstacle,
+                                 Real f_x,
+                                 Real f_y,
+                                 Real& f_dx,
+                                 Real& f_dy) {
+      if(f_x + KILOBOT_RADIUS <= s_obstacle.MinX || f_x - KILOBOT_RADIUS >= s_obstacle.MaxX ||
+         f_y + KILOBOT_RADIUS <= s_obstacle.MinY || f_y - KILOBOT_RADIUS >= s_obstacle.MaxY) {
+         return false;
+      }
+      Real fX = f_x - s_obstacle.X;
+      Real fY = f_y - s_obstacle.Y;
+      if(!s_obstacle.Box) {
+         Real fContact = KILOBOT_RADIUS + s_obstacle.HalfX;
+         Real fDistance2 = fX * fX + fY * fY;
+         if(fDistance2 >= fContact * fContact) {
+            return false;
+         }
+         if(fDistance2 > 0.0) {
+            Real fDistance = std::sqrt(fDistance2);
+            f_dx = fX * (fContact - fDistance) / fDistance;
+            f_dy = fY * (fContact - fDistance) / fDistance;
+         }
+         else {
+            f_dx = fContact;
+            f_dy = 0.0;
+         }
+         return true;
+      }
+      return PenetrateBox(fX, fY,
+                          s_obstacle.Cos, s_obstacle.Sin,
+                          s_obstacle.HalfX, s_obstacle.HalfY,
+                          f_dx, f_dy);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DModel::CKinematics2DModel(CKinematics2DEngine& c_engine,
+                                          CEmbodiedEntity& c_entity) :
+      CPhysicsModel(c_engine, c_entity),
+      m_cKinematics2DEngine(c_engine) {}
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DEngine::CKinematics2DEngine() :
+      m_unCollisionPasses(1),
+      m_fObstacleMinX(0.0),
+      m_fObstacleMinY(0.0),
+      m_fObstacleCellSize(1.0),
+      m_unObstacleCellsX(0),
+      m_unObstacleCellsY(0),
+      m_bObstacleGridValid(false) {
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Init(TConfigurationNode& t_tree) {
+      /* Init parent */
+      CPhysicsEngine::Init(t_tree);
+      /* Parse the XML */
+      GetNodeAttributeOrDefault(t_tree, "collision_passes", m_unCollisionPasses, m_unCollisionPasses);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Reset() {
+      for(CKinematics2DModel::TMap::iterator it = m_tPhysicsModels.begin();
+          it != m_tPhysicsModels.end(); ++it) {
+         it->second->Reset();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Destroy() {
+      /* Empty the physics model map */
+      for(CKinematics2DModel::TMap::iterator it = m_tPhysicsModels.begin();
+          it != m_tPhysicsModels.end(); ++it) {
+         delete it->second;
+      }
+      m_tPhysicsModels.clear();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Update() {
+      /* Update the physics state from the entities */
+      UpdateVelocities();
+      /* Perform the step */
+      for(UInt32 i = 0; i < GetIterations(); ++i) {
+         Integrate(GetPhysicsClockTick());
+         ResolveCollisions();
+      }
+      Normalize();
+      /* Update the simulated space; obstacles never move during a step */
+      for(size_t i = 0; i < m_vecKilobots.size(); ++i) {
+         m_vecKilobots[i]->UpdateEntityStatus();
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DEngine::IsPointContained(const CVector3& c_point) {
+      /* The engine covers the whole arena */
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   size_t CKinematics2DEngine::GetNumPhysicsModels() {
+      return m_tPhysicsModels.size();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DEngine::AddEntity(CEntity& c_entity) {
+      SOperationOutcome cOutcome =
+         CallEntityOperation<CKinematics2DOperationAddEntity, CKinematics2DEngine, SOperationOutcome>
+         (*this, c_entity);
+      return cOutcome.Value;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DEngine::RemoveEntity(CEntity& c_entity) {
+      SOperationOutcome cOutcome =
+         CallEntityOperation<CKinematics2DOperationRemoveEntity, CKinematics2DEngine, SOperationOutcome>
+         (*this, c_entity);
+      return cOutcome.Value;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::CheckIntersectionWithRay(TEmbodiedEntityIntersectionData& t_data,
+                                                      const CRay3& c_ray) const {
+      Real fTOnRay;
+      for(CKinematics2DModel::TMap::const_iterator it = m_tPhysicsModels.begin();
+          it != m_tPhysicsModels.end();
+          ++it) {
+         if(it->second->CheckIntersectionWithRay(fTOnRay, c_ray)) {
+            t_data.push_back(
+               SEmbodiedEntityIntersectionItem(
+                  &(it->second->GetEmbodiedEntity()),
+                  fTOnRay));
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::AddPhysicsModel(const std::string& str_id,
+                                             CKinematics2DModel& c_model) {
+      m_tPhysicsModels[str_id] = &c_model;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::RemovePhysicsModel(const std::string& str_id) {
+      CKinematics2DModel::TMap::iterator it = m_tPhysicsModels.find(str_id);
+      if(it != m_tPhysicsModels.end()) {
+         delete it->second;
+         m_tPhysicsModels.erase(it);
+      }
+      else {
+         THROW_ARGOSEXCEPTION("Kinematics2D model id \"" << str_id << "\" not found in kinematics2d engine \"" << GetId() << "\"");
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKinematics2DEngine::AddKilobot(CKinematics2DKilobotModel& c_model,
+                                          const Real* pf_wheel_velocities) {
+      m_vecKilobots.push_back(&c_model);
+      m_vecWheelVelocities.push_back(pf_wheel_velocities);
+      m_vecX.push_back(0.0);
+      m_vecY.push_back(0.0);
+      m_vecYaw.push_back(0.0);
+      m_vecCos.push_back(1.0);
+      m_vecSin.push_back(0.0);
+      m_vecLinearVelocity.push_back(0.0);
+      m_vecAngularVelocity.push_back(0.0);
+      m_vecStepCos.push_back(1.0);
+      m_vecStepSin.push_back(0.0);
+      return m_vecKilobots.size() - 1;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::RemoveKilobot(UInt32 un_index) {
+      UInt32 unLast = m_vecKilobots.size() - 1;
+      if(un_index != unLast) {
+         m_vecKilobots[un_index]        = m_vecKilobots[unLast];
+         m_vecWheelVelocities[un_index] = m_vecWheelVelocities[unLast];
+         m_vecX[un_index]               = m_vecX[unLast];
+         m_vecY[un_index]               = m_vecY[unLast];
+         m_vecYaw[un_index]             = m_vecYaw[unLast];
+         m_vecCos[un_index]             = m_vecCos[unLast];
+         m_vecSin[un_index]             = m_vecSin[unLast];
+         m_vecLinearVelocity[un_index]  = m_vecLinearVelocity[unLast];
+         m_vecAngularVelocity[un_index] = m_vecAngularVelocity[unLast];
+         m_vecStepCos[un_index]         = m_vecStepCos[unLast];
+         m_vecStepSin[un_index]         = m_vecStepSin[unLast];
+         m_vecKilobots[un_index]->SetIndex(un_index);
+      }
+      m_vecKilobots.pop_back();
+      m_vecWheelVelocities.pop_back();
+      m_vecX.pop_back();
+      m_vecY.pop_back();
+      m_vecYaw.pop_back();
+      m_vecCos.pop_back();
+      m_vecSin.pop_back();
+      m_vecLinearVelocity.pop_back();
+      m_vecAngularVelocity.pop_back();
+      m_vecStepCos.pop_back();
+      m_vecStepSin.pop_back();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::SetKilobotPose(UInt32 un_index,
+                                            Real f_x,
+                                            Real f_y,
+                                            Real f_yaw) {
+      m_vecX[un_index] = f_x;
+      m_vecY[un_index] = f_y;
+      m_vecYaw[un_index] = f_yaw;
+      m_vecCos[un_index] = std::cos(f_yaw);
+      m_vecSin[un_index] = std::sin(f_yaw);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DEngine::IsKilobotColliding(UInt32 un_index) const {
+      /* This is used when placing robots, so a linear search is good enough */
+      Real fX = m_vecX[un_index] + KILOBOT_ECCENTRICITY * m_vecCos[un_index];
+      Real fY = m_vecY[un_index] + KILOBOT_ECCENTRICITY * m_vecSin[un_index];
+      for(UInt32 i = 0; i < m_vecX.size(); ++i) {
+         if(i == un_index) continue;
+         Real fDX = m_vecX[i] + KILOBOT_ECCENTRICITY * m_vecCos[i] - fX;
+         Real fDY = m_vecY[i] + KILOBOT_ECCENTRICITY * m_vecSin[i] - fY;
+         if(fDX * fDX + fDY * fDY < KILOBOT_CONTACT_DISTANCE * KILOBOT_CONTACT_DISTANCE) {
+            return true;
+         }
+      }
+      Real fMoveX, fMoveY;
+      for(UInt32 i = 0; i < m_vecObstacles.size(); ++i) {
+         if(PenetrateObstacle(m_vecObstacles[i], fX, fY, fMoveX, fMoveY)) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   UInt32 CKinematics2DEngine::AddObstacle(const SObstacle& s_obstacle) {
+      m_vecObstacles.push_back(s_obstacle);
+      m_bObstacleGridValid = false;
+      return m_vecObstacles.size() - 1;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::RemoveObstacle(UInt32 un_index) {
+      if(un_index != m_vecObstacles.size() - 1) {
+         m_vecObstacles[un_index] = m_vecObstacles.back();
+         m_vecObstacles[un_index].Model->SetIndex(un_index);
+      }
+      m_vecObstacles.pop_back();
+      m_bObstacleGridValid = false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::SetObstacle(UInt32 un_index,
+                                         const SObstacle& s_obstacle) {
+      m_vecObstacles[un_index] = s_obstacle;
+      m_bObstacleGridValid = false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::UpdateVelocities() {
+      Real fDt = GetPhysicsClockTick();
+      for(size_t i = 0; i < m_vecKilobots.size(); ++i) {
+         Real fLeft  = m_vecWheelVelocities[i][KILOBOT_LEFT_WHEEL];
+         Real fRight = m_vecWheelVelocities[i][KILOBOT_RIGHT_WHEEL];
+         m_vecLinearVelocity[i] = (fLeft + fRight) * 0.5;
+         m_vecAngularVelocity[i] = (fRight - fLeft) / KILOBOT_INTERPIN_DISTANCE;
+      }
+      /* The rotation of a physics step does not change during the simulation step */
+      for(size_t i = 0; i < m_vecKilobots.size(); ++i) {
+         m_vecStepCos[i] = std::cos(m_vecAngularVelocity[i] * fDt);
+         m_vecStepSin[i] = std::sin(m_vecAngularVelocity[i] * fDt);
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Integrate(Real f_dt) {
+      /*
+       * Plain loops over the arrays, without branches or calls, so that the compiler
+       * turns them into SIMD code
+       */
+      const size_t unNum = m_vecX.size();
+      Real* pfX = m_vecX.data();
+      Real* pfY = m_vecY.data();
+      Real* pfYaw = m_vecYaw.data();
+      Real* pfCos = m_vecCos.data();
+      Real* pfSin = m_vecSin.data();
+      const Real* pfLinear = m_vecLinearVelocity.data();
+      const Real* pfAngular = m_vecAngularVelocity.data();
+      const Real* pfStepCos = m_vecStepCos.data();
+      const Real* pfStepSin = m_vecStepSin.data();
+      for(size_t i = 0; i < unNum; ++i) {
+         Real fDistance = pfLinear[i] * f_dt;
+         pfX[i] += fDistance * pfCos[i];
+         pfY[i] += fDistance * pfSin[i];
+      }
+      for(size_t i = 0; i < unNum; ++i) {
+         pfYaw[i] += pfAngular[i] * f_dt;
+      }
+      for(size_t i = 0; i < unNum; ++i) {
+         Real fCos = pfCos[i] * pfStepCos[i] - pfSin[i] * pfStepSin[i];
+         Real fSin = pfSin[i] * pfStepCos[i] + pfCos[i] * pfStepSin[i];
+         pfCos[i] = fCos;
+         pfSin[i] = fSin;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::Normalize() {
+      /* Remove the rounding errors accumulated by the rotations of the physics steps */
+      const size_t unNum = m_vecX.size();
+      Real* pfCos = m_vecCos.data();
+      Real* pfSin = m_vecSin.data();
+      for(size_t i = 0; i < unNum; ++i) {
+         /* The norm is close to 1, where one Newton step gives its inverse square root */
+         Real fInvNorm = 1.5 - 0.5 * (pfCos[i] * pfCos[i] + pfSin[i] * pfSin[i]);
+         pfCos[i] *= fInvNorm;
+         pfSin[i] *= fInvNorm;
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::ResolveCollisions() {
+      const size_t unNum = m_vecX.size();
+      if(unNum == 0) return;
+      /* The centers of the bodies */
+      m_vecCenterX.resize(unNum);
+      m_vecCenterY.resize(unNum);
+      for(size_t i = 0; i < unNum; ++i) {
+         m_vecCenterX[i] = m_vecX[i] + KILOBOT_ECCENTRICITY * m_vecCos[i];
+         m_vecCenterY[i] = m_vecY[i] + KILOBOT_ECCENTRICITY * m_vecSin[i];
+      }
+      m_cDiscGrid.Sort(m_vecCenterX.data(), m_vecCenterY.data(), unNum);
+      for(UInt32 i = 0; i < m_unCollisionPasses; ++i) {
+         m_cDiscGrid.Separate();
+         SeparateFromObstacles();
+      }
+      /* Move the kilobots with their bodies */
+      const Real* pfX = m_cDiscGrid.GetX();
+      const Real* pfY = m_cDiscGrid.GetY();
+      for(size_t k = 0; k < unNum; ++k) {
+         UInt32 i = m_cDiscGrid.GetIndex(k);
+         m_vecX[i] = pfX[k] - KILOBOT_ECCENTRICITY * m_vecCos[i];
+         m_vecY[i] = pfY[k] - KILOBOT_ECCENTRICITY * m_vecSin[i];
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::SeparateFromObstacles() {
+      if(m_vecObstacles.empty()) return;
+      if(!m_bObstacleGridValid) BuildObstacleGrid();
+      Real* pfX = m_cDiscGrid.GetX();
+      Real* pfY = m_cDiscGrid.GetY();
+      Real fMoveX, fMoveY;
+      for(UInt32 k = 0; k < m_cDiscGrid.GetNumBodies(); ++k) {
+         Real fCellX = (pfX[k] - m_fObstacleMinX) / m_fObstacleCellSize;
+         Real fCellY = (pfY[k] - m_fObstacleMinY) / m_fObstacleCellSize;
+         if(fCellX < 0.0 || fCellX >= m_unObstacleCellsX ||
+            fCellY < 0.0 || fCellY >= m_unObstacleCellsY) continue;
+         UInt32 unCell = static_cast<UInt32>(fCellY) * m_unObstacleCellsX + static_cast<UInt32>(fCellX);
+         for(UInt32 j = m_vecObstacleCellStart[unCell]; j < m_vecObstacleCellStart[unCell + 1]; ++j) {
+            if(PenetrateObstacle(m_vecObstacles[m_vecObstacleCells[j]],
+                                 pfX[k], pfY[k],
+                                 fMoveX, fMoveY)) {
+               pfX[k] += fMoveX;
+               pfY[k] += fMoveY;
+            }
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DEngine::BuildObstacleGrid() {
+      /*
+       * The grid covers the obstacles enlarged by the radius of a kilobot, so that the
+       * cell of the center of a kilobot lists all the obstacles its body can touch
+       */
+      Real fMinX = m_vecObstacles[0].MinX, fMaxX = m_vecObstacles[0].MaxX;
+      Real fMinY = m_vecObstacles[0].MinY, fMaxY = m_vecObstacles[0].MaxY;
+      for(size_t i = 1; i < m_vecObstacles.size(); ++i) {
+         fMinX = std::min(fMinX, m_vecObstacles[i].MinX);
+         fMaxX = std::max(fMaxX, m_vecObstacles[i].MaxX);
+         fMinY = std::min(fMinY, m_vecObstacles[i].MinY);
+         fMaxY = std::max(fMaxY, m_vecObstacles[i].MaxY);
+      }
+      m_fObstacleMinX = fMinX - KILOBOT_RADIUS;
+      m_fObstacleMinY = fMinY - KILOBOT_RADIUS;
+      Real fSizeX = fMaxX - fMinX + KILOBOT_CONTACT_DISTANCE;
+      Real fSizeY = fMaxY - fMinY + KILOBOT_CONTACT_DISTANCE;
+      m_fObstacleCellSize = std::max(2.0 * KILOBOT_CONTACT_DISTANCE,
+                                     std::max(fSizeX, fSizeY) / OBSTACLE_GRID_MAX_CELLS);
+      m_unObstacleCellsX = static_cast<UInt32>(fSizeX / m_fObstacleCellSize) + 1;
+      m_unObstacleCellsY = static_cast<UInt32>(fSizeY / m_fObstacleCellSize) + 1;
+      /* Two passes over the cells of each obstacle: count, then fill */
+      m_vecObstacleCellStart.assign(m_unObstacleCellsX * m_unObstacleCellsY + 1, 0);
+      for(int nPass = 0; nPass < 2; ++nPass) {
+         for(size_t i = 0; i < m_vecObstacles.size(); ++i) {
+            const SObstacle& sObstacle = m_vecObstacles[i];
+            UInt32 unFromX = static_cast<UInt32>((sObstacle.MinX - KILOBOT_RADIUS - m_fObstacleMinX) / m_fObstacleCellSize);
+            UInt32 unFromY = static_cast<UInt32>((sObstacle.MinY - KILOBOT_RADIUS - m_fObstacleMinY) / m_fObstacleCellSize);
+            UInt32 unToX = std::min(static_cast<UInt32>((sObstacle.MaxX + KILOBOT_RADIUS - m_fObstacleMinX) / m_fObstacleCellSize), m_unObstacleCellsX - 1);
+            UInt32 unToY = std::min(static_cast<UInt32>((sObstacle.MaxY + KILOBOT_RADIUS - m_fObstacleMinY) / m_fObstacleCellSize), m_unObstacleCellsY - 1);
+            for(UInt32 unY = unFromY; unY <= unToY; ++unY) {
+               for(UInt32 unX = unFromX; unX <= unToX; ++unX) {
+                  UInt32 unCell = unY * m_unObstacleCellsX + unX;
+                  if(nPass == 0) {
+                     ++m_vecObstacleCellStart[unCell + 1];
+                  }
+                  else {
+                     m_vecObstacleCells[m_vecObstacleCellStart[unCell]++] = i;
+                  }
+               }
+            }
+         }
+         if(nPass == 0) {
+            for(size_t c = 1; c < m_vecObstacleCellStart.size(); ++c) {
+               m_vecObstacleCellStart[c] += m_vecObstacleCellStart[c - 1];
+            }
+            m_vecObstacleCells.resize(m_vecObstacleCellStart.back());
+         }
+      }
+      /* Filling moved each start to the start of the next cell */
+      for(size_t c = m_vecObstacleCellStart.size() - 1; c > 0; --c) {
+         m_vecObstacleCellStart[c] = m_vecObstacleCellStart[c - 1];
+      }
+      m_vecObstacleCellStart[0] = 0;
+      m_bObstacleGridValid = true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   REGISTER_PHYSICS_ENGINE(CKinematics2DEngine,
+                           "kinematics2d",
+                           "ARK team",
+                           "1.0",
+                           "A 2D kinematic physics engine for large kilobot swarms.",
+                           "This physics engine moves kilobots with the kinematics of a differential\n"
+                           "drive, and only prevents overlaps: a kilobot that touches another kilobot\n"
+                           "or an obstacle stops at the contact, without pushing. Boxes and cylinders\n"
+                           "are obstacles that never move by themselves. The state of all the kilobots\n"
+                           "is kept in arrays and updated in vectorized loops, and contacts are found\n"
+                           "through a uniform grid, so that swarms of thousands of kilobots run much\n"
+                           "faster than with the dynamics2d engine.\n\n"
+                           "REQUIRED XML CONFIGURATION\n\n"
+                           "  <physics_engines>\n"
+                           "    ...\n"
+                           "    <kinematics2d id=\"k2d\" />\n"
+                           "    ...\n"
+                           "  </physics_engines>\n\n"
+                           "The 'id' attribute is necessary and must be unique among the physics engines.\n\n"
+                           "OPTIONAL XML CONFIGURATION\n\n"
+                           "The 'iterations' attribute sets the number of physics steps per simulation\n"
+                           "step, as for the other engines. The 'collision_passes' attribute sets how\n"
+                           "many times per physics step the overlaps are resolved (default 1); more\n"
+                           "passes give tighter crowds in dense swarms:\n\n"
+                           "  <physics_engines>\n"
+                           "    ...\n"
+                           "    <kinematics2d id=\"k2d\"\n"
+                           "                  iterations=\"10\"\n"
+                           "                  collision_passes=\"2\" />\n"
+                           "    ...\n"
+                           "  </physics_engines>\n",
+                           "Usable"
+      );
+
+}
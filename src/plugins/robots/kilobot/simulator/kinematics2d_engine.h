@@ -0,0 +1,295 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_engine.h>
+ *
+ * @brief This file provides a kinematic physics engine for large kilobot swarms.
+ *
+ * The engine keeps the state of all the kilobots in contiguous arrays and integrates
+ * differential drive kinematics in loops that the compiler can vectorize. Overlaps
+ * between kilobots, and between kilobots and the boxes and cylinders of the arena,
+ * are resolved by moving the robots apart, with a uniform grid as broad phase.
+ * There are no masses, forces or friction: kilobots stop at a contact instead of
+ * pushing each other, and obstacles never move by themselves.
+ */
+
+#ifndef KINEMATICS2D_ENGINE_H
+#define KINEMATICS2D_ENGINE_H
+
+namespace argos {
+   class CKinematics2DEngine;
+   class CKinematics2DModel;
+   class CKinematics2DKilobotModel;
+   class CKinematics2DObstacleModel;
+}
+
+#include <argos3/core/simulator/entity/embodied_entity.h>
+#include <argos3/core/simulator/physics_engine/physics_engine.h>
+#include <argos3/core/simulator/physics_engine/physics_model.h>
+#include <argos3/core/utility/math/ray3.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_collisions.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   class CKinematics2DModel : public CPhysicsModel {
+
+   public:
+
+      typedef std::map<std::string, CKinematics2DModel*> TMap;
+
+   public:
+
+      CKinematics2DModel(CKinematics2DEngine& c_engine,
+                         CEmbodiedEntity& c_entity);
+
+      virtual ~CKinematics2DModel() {}
+
+      virtual bool CheckIntersectionWithRay(Real& f_t_on_ray,
+                                            const CRay3& c_ray) const = 0;
+
+   protected:
+
+      CKinematics2DEngine& m_cKinematics2DEngine;
+   };
+
+   /****************************************/
+   /****************************************/
+
+   class CKinematics2DEngine : public CPhysicsEngine {
+
+   public:
+
+      /** A box or a cylinder, seen from above */
+      struct SObstacle {
+         CKinematics2DObstacleModel* Model;
+         Real X;
+         Real Y;
+         /** Rotation of a box around the Z axis */
+         Real Cos;
+         Real Sin;
+         bool Box;
+         /** Half the size of a box, or the radius of a cylinder in HalfX */
+         Real HalfX;
+         Real HalfY;
+         /** Bounding rectangle */
+         Real MinX;
+         Real MinY;
+         Real MaxX;
+         Real MaxY;
+      };
+
+   public:
+
+      CKinematics2DEngine();
+
+      virtual ~CKinematics2DEngine() {}
+
+      virtual void Init(TConfigurationNode& t_tree);
+
+      virtual void Reset();
+
+      virtual void Destroy();
+
+      virtual void Update();
+
+      virtual bool IsPointContained(const CVector3& c_point);
+
+      virtual size_t GetNumPhysicsModels();
+
+      virtual bool AddEntity(CEntity& c_entity);
+
+      virtual bool RemoveEntity(CEntity& c_entity);
+
+      virtual void CheckIntersectionWithRay(TEmbodiedEntityIntersectionData& t_data,
+                                            const CRay3& c_ray) const;
+
+      void AddPhysicsModel(const std::string& str_id,
+                           CKinematics2DModel& c_model);
+
+      void RemovePhysicsModel(const std::string& str_id);
+
+      /**
+       * Adds a kilobot to the arrays of the engine.
+       * @param c_model The model of the kilobot.
+       * @param pf_wheel_velocities The wheel velocities of the kilobot, left then right.
+       * @return The index of the kilobot in the arrays.
+       */
+      UInt32 AddKilobot(CKinematics2DKilobotModel& c_model,
+                        const Real* pf_wheel_velocities);
+
+      /**
+       * Removes a kilobot from the arrays of the engine. The last kilobot takes its index.
+       */
+      void RemoveKilobot(UInt32 un_index);
+
+      /**
+       * Sets the position of the point between the wheels of a kilobot, and its yaw.
+       */
+      void SetKilobotPose(UInt32 un_index,
+                          Real f_x,
+                          Real f_y,
+                          Real f_yaw);
+
+      inline Real GetKilobotX(UInt32 un_index) const {
+         return m_vecX[un_index];
+      }
+
+      inline Real GetKilobotY(UInt32 un_index) const {
+         return m_vecY[un_index];
+      }
+
+      inline Real GetKilobotYaw(UInt32 un_index) const {
+         return m_vecYaw[un_index];
+      }
+
+      inline Real GetKilobotCos(UInt32 un_index) const {
+         return m_vecCos[un_index];
+      }
+
+      inline Real GetKilobotSin(UInt32 un_index) const {
+         return m_vecSin[un_index];
+      }
+
+      /**
+       * Returns whether the body of a kilobot overlaps another kilobot or an obstacle.
+       */
+      bool IsKilobotColliding(UInt32 un_index) const;
+
+      /**
+       * Adds an obstacle to the engine.
+       * @return The index of the obstacle.
+       */
+      UInt32 AddObstacle(const SObstacle& s_obstacle);
+
+      /**
+       * Removes an obstacle from the engine. The last obstacle takes its index.
+       */
+      void RemoveObstacle(UInt32 un_index);
+
+      /**
+       * Replaces an obstacle that was moved.
+       */
+      void SetObstacle(UInt32 un_index,
+                       const SObstacle& s_obstacle);
+
+   private:
+
+      void UpdateVelocities();
+
+      void Integrate(Real f_dt);
+
+      void Normalize();
+
+      void ResolveCollisions();
+
+      void SeparateFromObstacles();
+
+      void BuildObstacleGrid();
+
+   private:
+
+      CKinematics2DModel::TMap m_tPhysicsModels;
+
+      /** How many times per physics step overlaps are resolved */
+      UInt32 m_unCollisionPasses;
+
+      /* The kilobots, one entry per kilobot in each array */
+      std::vector<CKinematics2DKilobotModel*> m_vecKilobots;
+      std::vector<const Real*> m_vecWheelVelocities;
+      /** Position of the point between the wheels */
+      std::vector<Real> m_vecX;
+      std::vector<Real> m_vecY;
+      std::vector<Real> m_vecYaw;
+      std::vector<Real> m_vecCos;
+      std::vector<Real> m_vecSin;
+      std::vector<Real> m_vecLinearVelocity;
+      std::vector<Real> m_vecAngularVelocity;
+      /** Rotation of a kilobot during one physics step */
+      std::vector<Real> m_vecStepCos;
+      std::vector<Real> m_vecStepSin;
+
+      /* The centers of the bodies of the kilobots, and the grid that separates them */
+      std::vector<Real> m_vecCenterX;
+      std::vector<Real> m_vecCenterY;
+      CKilobotDiscGrid m_cDiscGrid;
+
+      /* The obstacles, with a grid of their indices per cell */
+      std::vector<SObstacle> m_vecObstacles;
+      std::vector<UInt32> m_vecObstacleCellStart;
+      std::vector<UInt32> m_vecObstacleCells;
+      Real m_fObstacleMinX;
+      Real m_fObstacleMinY;
+      Real m_fObstacleCellSize;
+      UInt32 m_unObstacleCellsX;
+      UInt32 m_unObstacleCellsY;
+      bool m_bObstacleGridValid;
+   };
+
+   /****************************************/
+   /****************************************/
+
+   class CKinematics2DOperationAddEntity : public CEntityOperation<CKinematics2DOperationAddEntity, CKinematics2DEngine, SOperationOutcome> {
+   public:
+      virtual ~CKinematics2DOperationAddEntity() {}
+   };
+
+   class CKinematics2DOperationRemoveEntity : public CEntityOperation<CKinematics2DOperationRemoveEntity, CKinematics2DEngine, SOperationOutcome> {
+   public:
+      virtual ~CKinematics2DOperationRemoveEntity() {}
+   };
+
+#define REGISTER_KINEMATICS2D_OPERATION(ACTION, OPERATION, ENTITY)      \
+   REGISTER_ENTITY_OPERATION(ACTION, CKinematics2DEngine, OPERATION, SOperationOutcome, ENTITY);
+
+#define REGISTER_STANDARD_KINEMATICS2D_ADD_ENTITY(SPACE_ENTITY, K2D_MODEL) \
+   class CKinematics2DOperationAdd ## SPACE_ENTITY : public CKinematics2DOperationAddEntity { \
+   public:                                                              \
+   CKinematics2DOperationAdd ## SPACE_ENTITY() {}                       \
+   virtual ~CKinematics2DOperationAdd ## SPACE_ENTITY() {}              \
+   SOperationOutcome ApplyTo(CKinematics2DEngine& c_engine,             \
+                             SPACE_ENTITY& c_entity) {                  \
+      K2D_MODEL* pcPhysModel = new K2D_MODEL(c_engine,                  \
+                                             c_entity);                 \
+      c_engine.AddPhysicsModel(c_entity.GetEmbodiedEntity().GetId(),    \
+                               *pcPhysModel);                           \
+      c_entity.GetEmbodiedEntity().                                     \
+         AddPhysicsModel(c_engine.GetId(), *pcPhysModel);               \
+      return SOperationOutcome(true);                                   \
+   }                                                                    \
+   };                                                                   \
+   REGISTER_KINEMATICS2D_OPERATION(CKinematics2DOperationAddEntity,     \
+                                   CKinematics2DOperationAdd ## SPACE_ENTITY, \
+                                   SPACE_ENTITY);
+
+#define REGISTER_STANDARD_KINEMATICS2D_REMOVE_ENTITY(SPACE_ENTITY)      \
+   class CKinematics2DOperationRemove ## SPACE_ENTITY : public CKinematics2DOperationRemoveEntity { \
+   public:                                                              \
+   CKinematics2DOperationRemove ## SPACE_ENTITY() {}                    \
+   virtual ~CKinematics2DOperationRemove ## SPACE_ENTITY() {}           \
+   SOperationOutcome ApplyTo(CKinematics2DEngine& c_engine,             \
+                             SPACE_ENTITY& c_entity) {                  \
+      c_engine.RemovePhysicsModel(c_entity.GetEmbodiedEntity().GetId()); \
+      c_entity.GetEmbodiedEntity().                                     \
+         RemovePhysicsModel(c_engine.GetId());                          \
+      return SOperationOutcome(true);                                   \
+   }                                                                    \
+   };                                                                   \
+   REGISTER_KINEMATICS2D_OPERATION(CKinematics2DOperationRemoveEntity,  \
+                                   CKinematics2DOperationRemove ## SPACE_ENTITY, \
+                                   SPACE_ENTITY);
+
+#define REGISTER_STANDARD_KINEMATICS2D_OPERATIONS_ON_ENTITY(SPACE_ENTITY, K2D_ENTITY) \
+   REGISTER_STANDARD_KINEMATICS2D_ADD_ENTITY(SPACE_ENTITY, K2D_ENTITY)  \
+   REGISTER_STANDARD_KINEMATICS2D_REMOVE_ENTITY(SPACE_ENTITY)
+
+   /****************************************/
+   /****************************************/
+
+}
+
+#endif
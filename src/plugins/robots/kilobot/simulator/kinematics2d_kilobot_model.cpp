@@ -0,0 +1,193 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_kilobot_model.cpp>
+ */
+
+#include "kinematics2d_kilobot_model.h"
+#include "kilobot_measures.h"
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DKilobotModel::CKinematics2DKilobotModel(CKinematics2DEngine& c_engine,
+                                                        CKilobotEntity& c_kilobot) :
+      CKinematics2DModel(c_engine, c_kilobot.GetEmbodiedEntity()),
+      m_unIndex(c_engine.AddKilobot(*this,
+                                    c_kilobot.GetWheeledEntity().GetWheelVelocities())),
+      m_fElevation(0.0) {
+      /* Set the anchor updaters */
+      RegisterAnchorMethod(GetEmbodiedEntity().GetOriginAnchor(),
+                           &CKinematics2DKilobotModel::UpdateOriginAnchor);
+      RegisterAnchorMethod<CKinematics2DKilobotModel>(
+         GetEmbodiedEntity().GetAnchor("light"),
+         &CKinematics2DKilobotModel::UpdateLightAnchor);
+      RegisterAnchorMethod<CKinematics2DKilobotModel>(
+         GetEmbodiedEntity().GetAnchor("comm"),
+         &CKinematics2DKilobotModel::UpdateCommAnchor);
+      /* Get the initial pose */
+      Reset();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DKilobotModel::~CKinematics2DKilobotModel() {
+      m_cKinematics2DEngine.RemoveKilobot(m_unIndex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DKilobotModel::MoveTo(const CVector3& c_position,
+                                          const CQuaternion& c_orientation) {
+      /* Save the current pose, to go back to it in case of collision */
+      Real fOldX = m_cKinematics2DEngine.GetKilobotX(m_unIndex);
+      Real fOldY = m_cKinematics2DEngine.GetKilobotY(m_unIndex);
+      Real fOldYaw = m_cKinematics2DEngine.GetKilobotYaw(m_unIndex);
+      Real fOldElevation = m_fElevation;
+      /* Move the kilobot */
+      CRadians cYaw, cTmp1, cTmp2;
+      c_orientation.ToEulerAngles(cYaw, cTmp1, cTmp2);
+      m_cKinematics2DEngine.SetKilobotPose(m_unIndex,
+                                           c_position.GetX(),
+                                           c_position.GetY(),
+                                           cYaw.GetValue());
+      m_fElevation = c_position.GetZ();
+      if(IsCollidingWithSomething()) {
+         m_cKinematics2DEngine.SetKilobotPose(m_unIndex, fOldX, fOldY, fOldYaw);
+         m_fElevation = fOldElevation;
+         return false;
+      }
+      UpdateEntityStatus();
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::Reset() {
+      const SAnchor& sOrigin = GetEmbodiedEntity().GetOriginAnchor();
+      CRadians cYaw, cTmp1, cTmp2;
+      sOrigin.Orientation.ToEulerAngles(cYaw, cTmp1, cTmp2);
+      m_cKinematics2DEngine.SetKilobotPose(m_unIndex,
+                                           sOrigin.Position.GetX(),
+                                           sOrigin.Position.GetY(),
+                                           cYaw.GetValue());
+      m_fElevation = sOrigin.Position.GetZ();
+      UpdateEntityStatus();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::CalculateBoundingBox() {
+      Real fX = m_cKinematics2DEngine.GetKilobotX(m_unIndex) +
+         KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotCos(m_unIndex);
+      Real fY = m_cKinematics2DEngine.GetKilobotY(m_unIndex) +
+         KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotSin(m_unIndex);
+      GetBoundingBox().MinCorner.Set(fX - KILOBOT_RADIUS,
+                                     fY - KILOBOT_RADIUS,
+                                     m_fElevation);
+      GetBoundingBox().MaxCorner.Set(fX + KILOBOT_RADIUS,
+                                     fY + KILOBOT_RADIUS,
+                                     m_fElevation + KILOBOT_HEIGHT);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::UpdateFromEntityStatus() {
+      /* The engine reads the wheel velocities of all the kilobots at once */
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DKilobotModel::IsPointContained(const CVector3& c_point) const {
+      if(c_point.GetZ() < m_fElevation || c_point.GetZ() > m_fElevation + KILOBOT_HEIGHT) {
+         return false;
+      }
+      Real fX = c_point.GetX() - m_cKinematics2DEngine.GetKilobotX(m_unIndex) -
+         KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotCos(m_unIndex);
+      Real fY = c_point.GetY() - m_cKinematics2DEngine.GetKilobotY(m_unIndex) -
+         KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotSin(m_unIndex);
+      return fX * fX + fY * fY <= KILOBOT_RADIUS * KILOBOT_RADIUS;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DKilobotModel::IsCollidingWithSomething() const {
+      return m_cKinematics2DEngine.IsKilobotColliding(m_unIndex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DKilobotModel::CheckIntersectionWithRay(Real& f_t_on_ray,
+                                                            const CRay3& c_ray) const {
+      CVector3 cStart(c_ray.GetStart().GetX() - m_cKinematics2DEngine.GetKilobotX(m_unIndex) -
+                      KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotCos(m_unIndex),
+                      c_ray.GetStart().GetY() - m_cKinematics2DEngine.GetKilobotY(m_unIndex) -
+                      KILOBOT_ECCENTRICITY * m_cKinematics2DEngine.GetKilobotSin(m_unIndex),
+                      c_ray.GetStart().GetZ());
+      return IntersectSegmentWithCylinder(cStart,
+                                          c_ray.GetEnd() - c_ray.GetStart(),
+                                          KILOBOT_RADIUS,
+                                          m_fElevation,
+                                          m_fElevation + KILOBOT_HEIGHT,
+                                          f_t_on_ray);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::UpdateOriginAnchor(SAnchor& s_anchor) {
+      s_anchor.Position.Set(m_cKinematics2DEngine.GetKilobotX(m_unIndex),
+                            m_cKinematics2DEngine.GetKilobotY(m_unIndex),
+                            m_fElevation);
+      s_anchor.Orientation = CQuaternion(CRadians(m_cKinematics2DEngine.GetKilobotYaw(m_unIndex)),
+                                         CVector3::Z);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::UpdateLightAnchor(SAnchor& s_anchor) {
+      UpdateAnchor(s_anchor);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::UpdateCommAnchor(SAnchor& s_anchor) {
+      UpdateAnchor(s_anchor);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DKilobotModel::UpdateAnchor(SAnchor& s_anchor) {
+      /* Rotate the offset by the yaw of the kilobot, then translate it */
+      Real fCos = m_cKinematics2DEngine.GetKilobotCos(m_unIndex);
+      Real fSin = m_cKinematics2DEngine.GetKilobotSin(m_unIndex);
+      const CVector3& cOffset = s_anchor.OffsetPosition;
+      s_anchor.Position.Set(m_cKinematics2DEngine.GetKilobotX(m_unIndex) +
+                            cOffset.GetX() * fCos - cOffset.GetY() * fSin,
+                            m_cKinematics2DEngine.GetKilobotY(m_unIndex) +
+                            cOffset.GetX() * fSin + cOffset.GetY() * fCos,
+                            m_fElevation + cOffset.GetZ());
+      s_anchor.Orientation = CQuaternion(CRadians(m_cKinematics2DEngine.GetKilobotYaw(m_unIndex)),
+                                         CVector3::Z);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   REGISTER_STANDARD_KINEMATICS2D_OPERATIONS_ON_ENTITY(CKilobotEntity, CKinematics2DKilobotModel);
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,73 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_kilobot_model.h>
+ *
+ * @brief This file provides the kilobot model of the kinematics2d engine. The state
+ * of the kilobot is kept by the engine, the model only maps it to the entity.
+ */
+
+#ifndef KINEMATICS2D_KILOBOT_MODEL_H
+#define KINEMATICS2D_KILOBOT_MODEL_H
+
+namespace argos {
+   class CKinematics2DKilobotModel;
+   class CKilobotEntity;
+}
+
+#include <argos3/plugins/robots/kilobot/simulator/kinematics2d_engine.h>
+#include <argos3/plugins/robots/kilobot/simulator/kilobot_entity.h>
+
+namespace argos {
+
+   class CKinematics2DKilobotModel : public CKinematics2DModel {
+
+   public:
+
+      CKinematics2DKilobotModel(CKinematics2DEngine& c_engine,
+                                CKilobotEntity& c_kilobot);
+
+      virtual ~CKinematics2DKilobotModel();
+
+      virtual bool MoveTo(const CVector3& c_position,
+                          const CQuaternion& c_orientation);
+
+      virtual void Reset();
+
+      virtual void CalculateBoundingBox();
+
+      virtual void UpdateFromEntityStatus();
+
+      virtual bool IsPointContained(const CVector3& c_point) const;
+
+      virtual bool IsCollidingWithSomething() const;
+
+      virtual bool CheckIntersectionWithRay(Real& f_t_on_ray,
+                                            const CRay3& c_ray) const;
+
+      /**
+       * Sets the index of the kilobot in the arrays of the engine.
+       */
+      inline void SetIndex(UInt32 un_index) {
+         m_unIndex = un_index;
+      }
+
+      void UpdateOriginAnchor(SAnchor& s_anchor);
+      void UpdateLightAnchor(SAnchor& s_anchor);
+      void UpdateCommAnchor(SAnchor& s_anchor);
+
+   private:
+
+      /** Moves an anchor with the kilobot, from its offset */
+      void UpdateAnchor(SAnchor& s_anchor);
+
+   private:
+
+      /** The index of the kilobot in the arrays of the engine */
+      UInt32 m_unIndex;
+
+      /** The kilobot stays at the elevation it was placed at */
+      Real m_fElevation;
+   };
+
+}
+
+#endif
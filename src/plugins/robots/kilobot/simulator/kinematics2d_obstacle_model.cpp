@@ -0,0 +1,206 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_obstacle_model.cpp>
+ */
+
+#include "kinematics2d_obstacle_model.h"
+#include <argos3/plugins/simulator/entities/box_entity.h>
+#include <argos3/plugins/simulator/entities/cylinder_entity.h>
+
+#include <cmath>
+
+namespace argos {
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DObstacleModel::CKinematics2DObstacleModel(CKinematics2DEngine& c_engine,
+                                                          CBoxEntity& c_box) :
+      CKinematics2DModel(c_engine, c_box.GetEmbodiedEntity()),
+      m_bBox(true),
+      m_cHalfSize(c_box.GetSize().GetX() * 0.5,
+                  c_box.GetSize().GetY() * 0.5,
+                  c_box.GetSize().GetZ()) {
+      RegisterAnchorMethod(GetEmbodiedEntity().GetOriginAnchor(),
+                           &CKinematics2DObstacleModel::UpdateOriginAnchor);
+      SetPose(GetEmbodiedEntity().GetOriginAnchor().Position,
+              GetEmbodiedEntity().GetOriginAnchor().Orientation);
+      m_unIndex = m_cKinematics2DEngine.AddObstacle(m_sObstacle);
+      UpdateEntityStatus();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DObstacleModel::CKinematics2DObstacleModel(CKinematics2DEngine& c_engine,
+                                                          CCylinderEntity& c_cylinder) :
+      CKinematics2DModel(c_engine, c_cylinder.GetEmbodiedEntity()),
+      m_bBox(false),
+      m_cHalfSize(c_cylinder.GetRadius(),
+                  c_cylinder.GetRadius(),
+                  c_cylinder.GetHeight()) {
+      RegisterAnchorMethod(GetEmbodiedEntity().GetOriginAnchor(),
+                           &CKinematics2DObstacleModel::UpdateOriginAnchor);
+      SetPose(GetEmbodiedEntity().GetOriginAnchor().Position,
+              GetEmbodiedEntity().GetOriginAnchor().Orientation);
+      m_unIndex = m_cKinematics2DEngine.AddObstacle(m_sObstacle);
+      UpdateEntityStatus();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CKinematics2DObstacleModel::~CKinematics2DObstacleModel() {
+      m_cKinematics2DEngine.RemoveObstacle(m_unIndex);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DObstacleModel::MoveTo(const CVector3& c_position,
+                                           const CQuaternion& c_orientation) {
+      SetPose(c_position, c_orientation);
+      m_cKinematics2DEngine.SetObstacle(m_unIndex, m_sObstacle);
+      UpdateEntityStatus();
+      return true;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DObstacleModel::Reset() {
+      MoveTo(GetEmbodiedEntity().GetOriginAnchor().Position,
+             GetEmbodiedEntity().GetOriginAnchor().Orientation);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DObstacleModel::CalculateBoundingBox() {
+      if(!m_bBox) {
+         CVector3 cAxis(CVector3::Z);
+         cAxis.Rotate(m_cOrientation);
+         CVector3 cTop = m_cPosition + cAxis * m_cHalfSize.GetZ();
+         GetBoundingBox().MinCorner.Set(Min(m_cPosition.GetX(), cTop.GetX()) - m_cHalfSize.GetX(),
+                                        Min(m_cPosition.GetY(), cTop.GetY()) - m_cHalfSize.GetX(),
+                                        Min(m_cPosition.GetZ(), cTop.GetZ()));
+         GetBoundingBox().MaxCorner.Set(Max(m_cPosition.GetX(), cTop.GetX()) + m_cHalfSize.GetX(),
+                                        Max(m_cPosition.GetY(), cTop.GetY()) + m_cHalfSize.GetX(),
+                                        Max(m_cPosition.GetZ(), cTop.GetZ()));
+         return;
+      }
+      /* The bounding box of the corners of the box */
+      for(UInt32 i = 0; i < 8; ++i) {
+         CVector3 cCorner((i & 1) ? m_cHalfSize.GetX() : -m_cHalfSize.GetX(),
+                          (i & 2) ? m_cHalfSize.GetY() : -m_cHalfSize.GetY(),
+                          (i & 4) ? m_cHalfSize.GetZ() : 0.0);
+         cCorner.Rotate(m_cOrientation);
+         cCorner += m_cPosition;
+         if(i == 0) {
+            GetBoundingBox().MinCorner = cCorner;
+            GetBoundingBox().MaxCorner = cCorner;
+         }
+         else {
+            GetBoundingBox().MinCorner.Set(Min(GetBoundingBox().MinCorner.GetX(), cCorner.GetX()),
+                                           Min(GetBoundingBox().MinCorner.GetY(), cCorner.GetY()),
+                                           Min(GetBoundingBox().MinCorner.GetZ(), cCorner.GetZ()));
+            GetBoundingBox().MaxCorner.Set(Max(GetBoundingBox().MaxCorner.GetX(), cCorner.GetX()),
+                                           Max(GetBoundingBox().MaxCorner.GetY(), cCorner.GetY()),
+                                           Max(GetBoundingBox().MaxCorner.GetZ(), cCorner.GetZ()));
+         }
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DObstacleModel::IsPointContained(const CVector3& c_point) const {
+      CVector3 cLocal(c_point - m_cPosition);
+      cLocal.Rotate(m_cOrientation.Inverse());
+      if(cLocal.GetZ() < 0.0 || cLocal.GetZ() > m_cHalfSize.GetZ()) {
+         return false;
+      }
+      if(m_bBox) {
+         return Abs(cLocal.GetX()) <= m_cHalfSize.GetX() &&
+            Abs(cLocal.GetY()) <= m_cHalfSize.GetY();
+      }
+      return cLocal.GetX() * cLocal.GetX() + cLocal.GetY() * cLocal.GetY() <=
+         m_cHalfSize.GetX() * m_cHalfSize.GetX();
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DObstacleModel::IsCollidingWithSomething() const {
+      /* Obstacles may touch each other, and kilobots are checked on their side */
+      return false;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   bool CKinematics2DObstacleModel::CheckIntersectionWithRay(Real& f_t_on_ray,
+                                                             const CRay3& c_ray) const {
+      /* Test the segment in the frame of the body */
+      CQuaternion cInverse(m_cOrientation.Inverse());
+      CVector3 cStart(c_ray.GetStart() - m_cPosition);
+      cStart.Rotate(cInverse);
+      CVector3 cDelta(c_ray.GetEnd() - c_ray.GetStart());
+      cDelta.Rotate(cInverse);
+      if(m_bBox) {
+         return IntersectSegmentWithBox(cStart, cDelta,
+                                        CVector2(m_cHalfSize.GetX(), m_cHalfSize.GetY()),
+                                        m_cHalfSize.GetZ(),
+                                        f_t_on_ray);
+      }
+      return IntersectSegmentWithCylinder(cStart, cDelta,
+                                          m_cHalfSize.GetX(), 0.0, m_cHalfSize.GetZ(),
+                                          f_t_on_ray);
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DObstacleModel::UpdateOriginAnchor(SAnchor& s_anchor) {
+      s_anchor.Position = m_cPosition;
+      s_anchor.Orientation = m_cOrientation;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CKinematics2DObstacleModel::SetPose(const CVector3& c_position,
+                                            const CQuaternion& c_orientation) {
+      m_cPosition = c_position;
+      m_cOrientation = c_orientation;
+      CRadians cYaw, cTmp1, cTmp2;
+      c_orientation.ToEulerAngles(cYaw, cTmp1, cTmp2);
+      m_sObstacle.Model = this;
+      m_sObstacle.X = c_position.GetX();
+      m_sObstacle.Y = c_position.GetY();
+      m_sObstacle.Cos = std::cos(cYaw.GetValue());
+      m_sObstacle.Sin = std::sin(cYaw.GetValue());
+      m_sObstacle.Box = m_bBox;
+      m_sObstacle.HalfX = m_cHalfSize.GetX();
+      m_sObstacle.HalfY = m_cHalfSize.GetY();
+      Real fExtentX = m_cHalfSize.GetX();
+      Real fExtentY = m_cHalfSize.GetY();
+      if(m_bBox) {
+         fExtentX = Abs(m_sObstacle.Cos) * m_cHalfSize.GetX() + Abs(m_sObstacle.Sin) * m_cHalfSize.GetY();
+         fExtentY = Abs(m_sObstacle.Sin) * m_cHalfSize.GetX() + Abs(m_sObstacle.Cos) * m_cHalfSize.GetY();
+      }
+      m_sObstacle.MinX = m_sObstacle.X - fExtentX;
+      m_sObstacle.MaxX = m_sObstacle.X + fExtentX;
+      m_sObstacle.MinY = m_sObstacle.Y - fExtentY;
+      m_sObstacle.MaxY = m_sObstacle.Y + fExtentY;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   REGISTER_STANDARD_KINEMATICS2D_OPERATIONS_ON_ENTITY(CBoxEntity, CKinematics2DObstacleModel);
+   REGISTER_STANDARD_KINEMATICS2D_OPERATIONS_ON_ENTITY(CCylinderEntity, CKinematics2DObstacleModel);
+
+   /****************************************/
+   /****************************************/
+
+}
@@ -0,0 +1,84 @@
+/**
+ * @file <argos3/plugins/robots/kilobot/simulator/kinematics2d_obstacle_model.h>
+ *
+ * @brief This file provides the box and cylinder model of the kinematics2d engine.
+ * Boxes and cylinders are obstacles for the kilobots: they only move through MoveTo(),
+ * and their footprint on the floor is taken from their rotation around the Z axis.
+ */
+
+#ifndef KINEMATICS2D_OBSTACLE_MODEL_H
+#define KINEMATICS2D_OBSTACLE_MODEL_H
+
+namespace argos {
+   class CKinematics2DObstacleModel;
+   class CBoxEntity;
+   class CCylinderEntity;
+}
+
+#include <argos3/plugins/robots/kilobot/simulator/kinematics2d_engine.h>
+
+namespace argos {
+
+   class CKinematics2DObstacleModel : public CKinematics2DModel {
+
+   public:
+
+      CKinematics2DObstacleModel(CKinematics2DEngine& c_engine,
+                                 CBoxEntity& c_box);
+
+      CKinematics2DObstacleModel(CKinematics2DEngine& c_engine,
+                                 CCylinderEntity& c_cylinder);
+
+      virtual ~CKinematics2DObstacleModel();
+
+      virtual bool MoveTo(const CVector3& c_position,
+                          const CQuaternion& c_orientation);
+
+      virtual void Reset();
+
+      virtual void CalculateBoundingBox();
+
+      virtual void UpdateFromEntityStatus() {}
+
+      virtual bool IsPointContained(const CVector3& c_point) const;
+
+      virtual bool IsCollidingWithSomething() const;
+
+      virtual bool CheckIntersectionWithRay(Real& f_t_on_ray,
+                                            const CRay3& c_ray) const;
+
+      /**
+       * Sets the index of the obstacle in the engine.
+       */
+      inline void SetIndex(UInt32 un_index) {
+         m_unIndex = un_index;
+      }
+
+      void UpdateOriginAnchor(SAnchor& s_anchor);
+
+   private:
+
+      void SetPose(const CVector3& c_position,
+                   const CQuaternion& c_orientation);
+
+   private:
+
+      /** The index of the obstacle in the engine */
+      UInt32 m_unIndex;
+
+      bool m_bBox;
+
+      /** Half the size of a box on X and Y, or the radius of a cylinder on X, then the height */
+      CVector3 m_cHalfSize;
+
+      /** The origin of the body, at the center of its base */
+      CVector3 m_cPosition;
+      CQuaternion m_cOrientation;
+
+      /** The footprint of the body, as seen by the engine */
+      CKinematics2DEngine::SObstacle m_sObstacle;
+   };
+
+}
+
+#endif
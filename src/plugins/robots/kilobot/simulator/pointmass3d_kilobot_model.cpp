@@ -5,8 +5,14 @@
  */
 
 #include "pointmass3d_kilobot_model.h"
+#include "kilobot_collisions.h"
 #include "kilobot_measures.h"
-#include <argos3/core/utility/math/cylinder.h>
+#include <argos3/core/simulator/simulator.h>
+#include <argos3/core/simulator/space/space.h>
+#include <argos3/plugins/simulator/entities/box_entity.h>
+
+#include <algorithm>
+#include <map>
 
 namespace argos {
 
@@ -18,9 +24,37 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   struct CPointMass3DKilobotModel::SCrowd {
+      std::vector<CPointMass3DKilobotModel*> Models;
+      /** How many kilobots made the current physics step */
+      UInt32 Steps;
+      /** The centers of the kilobots */
+      std::vector<Real> X;
+      std::vector<Real> Y;
+      CKilobotDiscGrid Grid;
+      /** A box of the space, seen from above */
+      struct SBox {
+         Real X;
+         Real Y;
+         Real Cos;
+         Real Sin;
+         Real HalfX;
+         Real HalfY;
+         /** Distance from the center to the farthest corner */
+         Real Reach;
+      };
+      std::vector<SBox> Boxes;
+
+      SCrowd() : Steps(0) {}
+   };
+
+   /****************************************/
+   /****************************************/
+
    CPointMass3DKilobotModel::CPointMass3DKilobotModel(CPointMass3DEngine& c_engine,
                                                       CKilobotEntity& c_kilobot) :
       CPointMass3DModel(c_engine, c_kilobot.GetEmbodiedEntity()),
+      m_psCrowd(&GetCrowd(c_engine)),
       m_cWheeledEntity(c_kilobot.GetWheeledEntity()),
       m_fCurrentWheelVelocity(m_cWheeledEntity.GetWheelVelocities()) {
       /* Register the origin anchor update method */
@@ -29,6 +63,19 @@ namespace argos {
       /* Get initial rotation */
       CRadians cTmp1, cTmp2;
       GetEmbodiedEntity().GetOriginAnchor().Orientation.ToEulerAngles(m_cYaw, cTmp1, cTmp2);
+      /* Join the other kilobots of the engine */
+      m_psCrowd->Models.push_back(this);
+      m_psCrowd->Steps = 0;
+   }
+
+   /****************************************/
+   /****************************************/
+
+   CPointMass3DKilobotModel::~CPointMass3DKilobotModel() {
+      m_psCrowd->Models.erase(std::find(m_psCrowd->Models.begin(),
+                                        m_psCrowd->Models.end(),
+                                        this));
+      m_psCrowd->Steps = 0;
    }
 
    /****************************************/
@@ -39,6 +86,7 @@ namespace argos {
       CRadians cTmp1, cTmp2;
       GetEmbodiedEntity().GetOriginAnchor().Orientation.ToEulerAngles(m_cYaw, cTmp1, cTmp2);
       m_fAngularVelocity = 0.0;
+      m_psCrowd->Steps = 0;
    }
 
    /****************************************/
@@ -57,6 +105,14 @@ namespace argos {
    void CPointMass3DKilobotModel::Step() {
       m_cPosition += m_cVelocity * m_cPM3DEngine.GetPhysicsClockTick();
       m_cYaw += CRadians(m_fAngularVelocity * m_cPM3DEngine.GetPhysicsClockTick());
+      /*
+       * The engine steps every model once per physics step, so the last kilobot to
+       * step resolves the overlaps for all of them
+       */
+      if(++m_psCrowd->Steps == m_psCrowd->Models.size()) {
+         m_psCrowd->Steps = 0;
+         ResolveCollisions(*m_psCrowd);
+      }
    }
 
    /****************************************/
@@ -78,12 +134,12 @@ namespace argos {
 
    bool CPointMass3DKilobotModel::CheckIntersectionWithRay(Real& f_t_on_ray,
                                                            const CRay3& c_ray) const {
-      CCylinder m_cShape(KILOBOT_RADIUS,
-                         KILOBOT_HEIGHT,
-                         m_cPosition,
-                         CVector3::Z);
-      bool bIntersects = m_cShape.Intersects(f_t_on_ray, c_ray);
-      return bIntersects;
+      return IntersectSegmentWithCylinder(c_ray.GetStart() - m_cPosition,
+                                          c_ray.GetEnd() - c_ray.GetStart(),
+                                          KILOBOT_RADIUS,
+                                          0.0,
+                                          KILOBOT_HEIGHT,
+                                          f_t_on_ray);
    }
 
    /****************************************/
@@ -97,6 +153,78 @@ namespace argos {
    /****************************************/
    /****************************************/
 
+   CPointMass3DKilobotModel::SCrowd& CPointMass3DKilobotModel::GetCrowd(const CPointMass3DEngine& c_engine) {
+      static std::map<const CPointMass3DEngine*, SCrowd> mapCrowds;
+      return mapCrowds[&c_engine];
+   }
+
+   /****************************************/
+   /****************************************/
+
+   void CPointMass3DKilobotModel::ResolveCollisions(SCrowd& s_crowd) {
+      UInt32 unNum = s_crowd.Models.size();
+      s_crowd.X.resize(unNum);
+      s_crowd.Y.resize(unNum);
+      for(UInt32 i = 0; i < unNum; ++i) {
+         s_crowd.X[i] = s_crowd.Models[i]->m_cPosition.GetX();
+         s_crowd.Y[i] = s_crowd.Models[i]->m_cPosition.GetY();
+      }
+      s_crowd.Grid.Sort(s_crowd.X.data(), s_crowd.Y.data(), unNum);
+      s_crowd.Grid.Separate();
+      /* Push the kilobots out of the boxes, which may have been moved since the last step */
+      s_crowd.Boxes.clear();
+      CSpace::TMapPerTypePerId& mapEntities = CSimulator::GetInstance().GetSpace().GetEntityMapPerTypePerId();
+      CSpace::TMapPerTypePerId::iterator itBoxes = mapEntities.find("box");
+      if(itBoxes != mapEntities.end()) {
+         for(CSpace::TMapPerType::iterator it = itBoxes->second.begin(); it != itBoxes->second.end(); ++it) {
+            CBoxEntity& cBox = *any_cast<CBoxEntity*>(it->second);
+            const SAnchor& sAnchor = cBox.GetEmbodiedEntity().GetOriginAnchor();
+            CRadians cYaw, cTmp1, cTmp2;
+            sAnchor.Orientation.ToEulerAngles(cYaw, cTmp1, cTmp2);
+            SCrowd::SBox sBox;
+            sBox.X = sAnchor.Position.GetX();
+            sBox.Y = sAnchor.Position.GetY();
+            sBox.Cos = Cos(cYaw);
+            sBox.Sin = Sin(cYaw);
+            sBox.HalfX = cBox.GetSize().GetX() * 0.5;
+            sBox.HalfY = cBox.GetSize().GetY() * 0.5;
+            sBox.Reach = Sqrt(sBox.HalfX * sBox.HalfX + sBox.HalfY * sBox.HalfY);
+            s_crowd.Boxes.push_back(sBox);
+         }
+      }
+      Real* pfBodyX = s_crowd.Grid.GetX();
+      Real* pfBodyY = s_crowd.Grid.GetY();
+      Real fMoveX, fMoveY;
+      for(UInt32 k = 0; k < unNum; ++k) {
+         for(size_t b = 0; b < s_crowd.Boxes.size(); ++b) {
+            const SCrowd::SBox& sBox = s_crowd.Boxes[b];
+            Real fX = pfBodyX[k] - sBox.X;
+            Real fY = pfBodyY[k] - sBox.Y;
+            if(Abs(fX) >= sBox.Reach + KILOBOT_RADIUS || Abs(fY) >= sBox.Reach + KILOBOT_RADIUS) continue;
+            if(PenetrateBox(fX, fY, sBox.Cos, sBox.Sin, sBox.HalfX, sBox.HalfY, fMoveX, fMoveY)) {
+               pfBodyX[k] += fMoveX;
+               pfBodyY[k] += fMoveY;
+            }
+         }
+      }
+      /* Clamp the kilobots to the walls of the arena */
+      const CSpace& cSpace = CSimulator::GetInstance().GetSpace();
+      Real fMinX = cSpace.GetArenaCenter().GetX() - cSpace.GetArenaSize().GetX() * 0.5 + KILOBOT_RADIUS;
+      Real fMaxX = cSpace.GetArenaCenter().GetX() + cSpace.GetArenaSize().GetX() * 0.5 - KILOBOT_RADIUS;
+      Real fMinY = cSpace.GetArenaCenter().GetY() - cSpace.GetArenaSize().GetY() * 0.5 + KILOBOT_RADIUS;
+      Real fMaxY = cSpace.GetArenaCenter().GetY() + cSpace.GetArenaSize().GetY() * 0.5 - KILOBOT_RADIUS;
+      const Real* pfX = s_crowd.Grid.GetX();
+      const Real* pfY = s_crowd.Grid.GetY();
+      for(UInt32 k = 0; k < unNum; ++k) {
+         CVector3& cPosition = s_crowd.Models[s_crowd.Grid.GetIndex(k)]->m_cPosition;
+         cPosition.SetX(Min(Max(pfX[k], fMinX), fMaxX));
+         cPosition.SetY(Min(Max(pfY[k], fMinY), fMaxY));
+      }
+   }
+
+   /****************************************/
+   /****************************************/
+
    REGISTER_STANDARD_POINTMASS3D_OPERATIONS_ON_ENTITY(CKilobotEntity, CPointMass3DKilobotModel);
 
    /****************************************/
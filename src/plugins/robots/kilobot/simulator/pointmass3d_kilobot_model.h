@@ -26,7 +26,7 @@ namespace argos {
       CPointMass3DKilobotModel(CPointMass3DEngine& c_engine,
                                CKilobotEntity& c_kilobot);
 
-      virtual ~CPointMass3DKilobotModel() {}
+      virtual ~CPointMass3DKilobotModel();
 
       virtual void Reset();
 
@@ -42,6 +42,23 @@ namespace argos {
 
    private:
 
+      /** The kilobots of an engine, whose overlaps are resolved together */
+      struct SCrowd;
+
+      /** Returns the kilobots of an engine */
+      static SCrowd& GetCrowd(const CPointMass3DEngine& c_engine);
+
+      /**
+       * Moves apart the kilobots that overlap, pushes them out of the boxes, and keeps them in the arena.
+       * Boxes are seen from above, whatever their height; cylinders are not obstacles.
+       */
+      static void ResolveCollisions(SCrowd& s_crowd);
+
+   private:
+
+      /** The kilobots of the engine */
+      SCrowd* m_psCrowd;
+
       /** Reference to the wheeled entity */
       CWheeledEntity& m_cWheeledEntity;
 